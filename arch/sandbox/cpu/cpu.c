@@ -94,6 +94,23 @@ void flush_dcache_range(unsigned long start, unsigned long stop)
 {
 }
 
+/* Run gzip workers on host threads, one per host CPU */
+int gzip_parallel_workers(void)
+{
+	return os_get_cpu_count();
+}
+
+void gzip_parallel_run(void (*func)(void *arg, int worker), void *arg,
+		       int count)
+{
+	int i;
+
+	if (!os_run_parallel(func, arg, count))
+		return;
+	for (i = 0; i < count; i++)
+		func(arg, i);
+}
+
 int sandbox_read_fdt_from_file(void)
 {
 	struct sandbox_state *state = state_get_current();
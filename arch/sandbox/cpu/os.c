@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -206,6 +207,59 @@ uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 #endif
 }
 
+int os_get_cpu_count(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? count : 1;
+}
+
+/* The largest number of threads started by os_run_parallel() */
+#define OS_MAX_THREADS	64
+
+struct os_thread {
+	pthread_t id;
+	void (*func)(void *arg, int thread);
+	void *arg;
+	int num;
+};
+
+static void *os_thread_start(void *ptr)
+{
+	struct os_thread *thread = ptr;
+
+	thread->func(thread->arg, thread->num);
+
+	return NULL;
+}
+
+int os_run_parallel(void (*func)(void *arg, int thread), void *arg,
+		    int count)
+{
+	struct os_thread thread[OS_MAX_THREADS];
+	int i, started;
+
+	if (count < 1 || count > OS_MAX_THREADS)
+		return -1;
+
+	/* Start the others and run thread 0 here */
+	for (started = 1; started < count; started++) {
+		thread[started].func = func;
+		thread[started].arg = arg;
+		thread[started].num = started;
+		if (pthread_create(&thread[started].id, NULL, os_thread_start,
+				   &thread[started]))
+			break;
+	}
+	if (started == count)
+		func(arg, 0);
+
+	for (i = 1; i < started; i++)
+		pthread_join(thread[i].id, NULL);
+
+	return started == count ? 0 : -1;
+}
+
 static char *short_opts;
 static struct option *long_opts;
 
@@ -19,6 +19,11 @@
 
 #define SANDBOX_CLK_RATE		32768
 
+/* Sampling points of the sandbox MMC host, of which only the eye works */
+#define SANDBOX_MMC_PHASES		16
+#define SANDBOX_MMC_EYE_FIRST		5
+#define SANDBOX_MMC_EYE_LAST		10
+
 enum {
 	PERIPH_ID_FIRST = 0,
 	PERIPH_ID_SPI = PERIPH_ID_FIRST,
@@ -86,4 +91,21 @@ long sandbox_i2c_rtc_set_offset(struct udevice *dev, bool use_system_time,
  */
 long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
+/**
+ * sandbox_mmc_get_phase() - get the sampling point chosen by tuning
+ *
+ * @dev:		sandbox MMC host
+ * @return sampling point, from 0 to SANDBOX_MMC_PHASES - 1
+ */
+uint sandbox_mmc_get_phase(struct udevice *dev);
+
+/**
+ * sandbox_mmc_set_power_switch() - say whether the card power can be cycled
+ *
+ * @dev:		sandbox MMC host
+ * @present:		true to let power_cycle() work, false to make it
+ *			return -ENOSYS
+ */
+void sandbox_mmc_set_power_switch(struct udevice *dev, bool present);
+
 #endif
@@ -40,36 +40,139 @@
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
+#include <errno.h>
 
-void write_sparse_image(block_dev_desc_t *dev_desc,
-		disk_partition_t *info, const char *part_name,
-		void *data, unsigned sz)
+enum {
+	SPARSE_STREAM_FILE_HDR,		/* gathering the sparse header */
+	SPARSE_STREAM_CHUNK_HDR,	/* gathering a chunk header */
+	SPARSE_STREAM_CHUNK_RAW,	/* writing the data of a raw chunk */
+	SPARSE_STREAM_CHUNK_FILL,	/* gathering the value of a fill chunk */
+	SPARSE_STREAM_RAW_IMAGE,	/* writing an image which is not sparse */
+	SPARSE_STREAM_DONE,		/* all chunks processed */
+};
+
+/* Number of blocks written at once for fill chunks */
+#define SPARSE_FILL_BLKS	64
+
+/*
+ * Copy up to @want bytes of a header which may be split across several
+ * writes into @dst. Returns true once the header is complete.
+ */
+static bool sparse_stream_gather(struct sparse_stream *s, void *dst,
+				 unsigned int want, const char **data,
+				 unsigned int *len)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
+	unsigned int n = min(want - s->hdr_bytes, *len);
+
+	memcpy(dst + s->hdr_bytes, *data, n);
+	s->hdr_bytes += n;
+	*data += n;
+	*len -= n;
+	if (s->hdr_bytes < want)
+		return false;
+
+	s->hdr_bytes = 0;
+	return true;
+}
+
+static int sparse_stream_write_blks(struct sparse_stream *s, lbaint_t blkcnt,
+				    const void *buf)
+{
+	block_dev_desc_t *dev_desc = s->dev_desc;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int i;
-
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *) data;
-
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t))
-	{
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+
+	if (s->blk + blkcnt > s->info->start + s->info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		fastboot_fail("Request would exceed partition size!");
+		return -ENOSPC;
+	}
+
+	blks = dev_desc->block_write(dev_desc->dev, s->blk, blkcnt, buf);
+	if (blks != blkcnt) {
+		printf("%s: Write failed " LBAFU "\n", __func__, blks);
+		fastboot_fail("flash write failure");
+		return -EIO;
 	}
+	s->blk += blkcnt;
+	s->bytes_written += blkcnt * s->info->blksz;
+
+	return 0;
+}
+
+/*
+ * Write image data which does not necessarily end on a block boundary.
+ * The trailing partial block is kept in blk_buf until the next call.
+ */
+static int sparse_stream_write_data(struct sparse_stream *s,
+				    const char *data, unsigned int len)
+{
+	unsigned long blksz = s->info->blksz;
+	lbaint_t blkcnt;
+	unsigned int n;
+	int ret;
+
+	if (s->blk_buf_len) {
+		n = min(blksz - s->blk_buf_len, (unsigned long)len);
+		memcpy(s->blk_buf + s->blk_buf_len, data, n);
+		s->blk_buf_len += n;
+		data += n;
+		len -= n;
+		if (s->blk_buf_len < blksz)
+			return 0;
+
+		ret = sparse_stream_write_blks(s, 1, s->blk_buf);
+		if (ret)
+			return ret;
+		s->blk_buf_len = 0;
+	}
+
+	blkcnt = len / blksz;
+	if (blkcnt) {
+		ret = sparse_stream_write_blks(s, blkcnt, data);
+		if (ret)
+			return ret;
+		data += blkcnt * blksz;
+		len -= blkcnt * blksz;
+	}
+
+	memcpy(s->blk_buf, data, len);
+	s->blk_buf_len = len;
+
+	return 0;
+}
+
+static int sparse_stream_fill(struct sparse_stream *s, lbaint_t blkcnt)
+{
+	uint32_t *fill_buf = s->fill_buf;
+	lbaint_t n;
+	int i, ret;
+
+	for (i = 0; i < s->fill_blks * s->info->blksz / sizeof(uint32_t); i++)
+		fill_buf[i] = s->fill_val;
+
+	while (blkcnt) {
+		n = min(blkcnt, (lbaint_t)s->fill_blks);
+		ret = sparse_stream_write_blks(s, n, fill_buf);
+		if (ret)
+			return ret;
+		blkcnt -= n;
+	}
+
+	return 0;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *s)
+{
+	s->chunk++;
+	if (s->chunk < s->sparse_header.total_chunks)
+		s->state = SPARSE_STREAM_CHUNK_HDR;
+	else
+		s->state = SPARSE_STREAM_DONE;
+}
+
+static int sparse_stream_start(struct sparse_stream *s)
+{
+	sparse_header_t *sparse_header = &s->sparse_header;
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -83,162 +186,268 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 
 	/* verify sparse_header->blk_sz is an exact multiple of info->blksz */
 	if (sparse_header->blk_sz !=
-	    (sparse_header->blk_sz & ~(info->blksz - 1))) {
+	    (sparse_header->blk_sz & ~(s->info->blksz - 1))) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
 		fastboot_fail("sparse image block size issue");
-		return;
+		return -EINVAL;
+	}
+
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t)) {
+		fastboot_fail("sparse image header size issue");
+		return -EINVAL;
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk=0; chunk<sparse_header->total_chunks; chunk++)
-	{
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *) data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
+	/*
+	 * Skip the remaining bytes in a header that is longer than we
+	 * expected.
+	 */
+	s->skip_bytes = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	s->chunk = 0;
+	if (sparse_header->total_chunks)
+		s->state = SPARSE_STREAM_CHUNK_HDR;
+	else
+		s->state = SPARSE_STREAM_DONE;
+
+	return 0;
+}
+
+static int sparse_stream_chunk(struct sparse_stream *s)
+{
+	sparse_header_t *sparse_header = &s->sparse_header;
+	chunk_header_t *chunk_header = &s->chunk_header;
+	unsigned int chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/*
+	 * Skip the remaining bytes in a header that is longer than we
+	 * expected.
+	 */
+	s->skip_bytes = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = (lbaint_t)chunk_header->chunk_sz *
+		 (sparse_header->blk_sz / s->info->blksz);
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
+			fastboot_fail("Bogus chunk size for chunk type Raw");
+			return -EINVAL;
 		}
+		s->chunk_bytes = chunk_data_sz;
+		s->total_blocks += chunk_header->chunk_sz;
+		if (chunk_data_sz)
+			s->state = SPARSE_STREAM_CHUNK_RAW;
+		else
+			sparse_stream_next_chunk(s);
+		break;
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t))
-		{
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
+			fastboot_fail("Bogus chunk size for chunk type FILL");
+			return -EINVAL;
 		}
+		s->total_blocks += chunk_header->chunk_sz;
+		s->state = SPARSE_STREAM_CHUNK_FILL;
+		break;
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type)
-		{
-			case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz))
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Raw");
-				return;
-			}
+	case CHUNK_TYPE_DONT_CARE:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
+			fastboot_fail("Bogus chunk size for chunk type Dont Care");
+			return -EINVAL;
+		}
+		s->blk += blkcnt;
+		s->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(s);
+		break;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
+			fastboot_fail("Bogus chunk size for chunk type CRC32");
+			return -EINVAL;
+		}
+		s->total_blocks += chunk_header->chunk_sz;
+		s->skip_bytes += sizeof(uint32_t);
+		sparse_stream_next_chunk(s);
+		break;
 
-			blks = dev_desc->block_write(dev_desc->dev, blk, blkcnt,
-						     data);
-			if (blks != blkcnt) {
-				printf("%s: Write failed " LBAFU "\n",
-				       __func__, blks);
-				fastboot_fail("flash write failure");
-				return;
-			}
-			blk += blkcnt;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		fastboot_fail("Unknown chunk type");
+		return -EINVAL;
+	}
 
-			case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type FILL");
-				return;
-			}
+	return 0;
+}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(info->blksz,
-						    ARCH_DMA_MINALIGN));
-			if (!fill_buf)
-			{
-				fastboot_fail(
-					"Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
+int sparse_stream_init(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+		       disk_partition_t *info, const char *part_name)
+{
+	memset(s, 0, sizeof(*s));
+	s->dev_desc = dev_desc;
+	s->info = info;
+	s->part_name = part_name;
+	s->blk = info->start;
+	s->state = SPARSE_STREAM_FILE_HDR;
+
+	s->fill_blks = SPARSE_FILL_BLKS;
+	s->fill_buf = memalign(ARCH_DMA_MINALIGN,
+			       ROUNDUP(s->fill_blks * info->blksz,
+				       ARCH_DMA_MINALIGN));
+	s->blk_buf = memalign(ARCH_DMA_MINALIGN,
+			      ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!s->fill_buf || !s->blk_buf) {
+		free(s->fill_buf);
+		free(s->blk_buf);
+		fastboot_fail("Malloc failed for sparse image buffers");
+		return -ENOMEM;
+	}
 
-			fill_val = *(uint32_t *)data;
-			data = (char *) data + sizeof(uint32_t);
+	return 0;
+}
 
-			for (i = 0; i < (info->blksz / sizeof(fill_val)); i++)
-				fill_buf[i] = fill_val;
+int sparse_stream_write(struct sparse_stream *s, const void *data,
+			unsigned int len)
+{
+	const char *p = data;
+	unsigned int n;
+	int ret = s->err;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	while (len && !ret) {
+		if (s->skip_bytes) {
+			n = min(s->skip_bytes, len);
+			s->skip_bytes -= n;
+			p += n;
+			len -= n;
+			continue;
+		}
 
-			for (i = 0; i < blkcnt; i++) {
-				blks = dev_desc->block_write(dev_desc->dev,
-							     blk, 1, fill_buf);
-				if (blks != 1) {
-					printf(
-					    "%s: Write failed, block # " LBAFU "\n",
-					    __func__, blkcnt);
-					fastboot_fail("flash write failure");
-					free(fill_buf);
-					return;
-				}
-				blk++;
+		switch (s->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (!sparse_stream_gather(s, &s->sparse_header,
+						  sizeof(sparse_header_t),
+						  &p, &len))
+				break;
+			if (is_sparse_image(&s->sparse_header)) {
+				ret = sparse_stream_start(s);
+				break;
 			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
+			puts("Flashing Raw Image\n");
+			s->state = SPARSE_STREAM_RAW_IMAGE;
+			ret = sparse_stream_write_data(s,
+					(const char *)&s->sparse_header,
+					sizeof(sparse_header_t));
+			break;
 
-			free(fill_buf);
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (sparse_stream_gather(s, &s->chunk_header,
+						 sizeof(chunk_header_t),
+						 &p, &len))
+				ret = sparse_stream_chunk(s);
 			break;
 
-			case CHUNK_TYPE_DONT_CARE:
-			blk += blkcnt;
-			total_blocks += chunk_header->chunk_sz;
+		case SPARSE_STREAM_CHUNK_RAW:
+			n = min(s->chunk_bytes, len);
+			ret = sparse_stream_write_data(s, p, n);
+			s->chunk_bytes -= n;
+			p += n;
+			len -= n;
+			if (!s->chunk_bytes)
+				sparse_stream_next_chunk(s);
 			break;
 
-			case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz)
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Dont Care");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+		case SPARSE_STREAM_CHUNK_FILL:
+			if (!sparse_stream_gather(s, &s->fill_val,
+						  sizeof(uint32_t), &p, &len))
+				break;
+			ret = sparse_stream_fill(s,
+					(lbaint_t)s->chunk_header.chunk_sz *
+					(s->sparse_header.blk_sz /
+					 s->info->blksz));
+			sparse_stream_next_chunk(s);
 			break;
 
-			default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
+		case SPARSE_STREAM_RAW_IMAGE:
+			ret = sparse_stream_write_data(s, p, len);
+			len = 0;
+			break;
+
+		default:
+			/* Ignore anything following the last chunk */
+			len = 0;
+			break;
 		}
 	}
+	s->err = ret;
+
+	return ret;
+}
+
+int sparse_stream_finish(struct sparse_stream *s)
+{
+	int ret = s->err;
+
+	if (!ret && s->state == SPARSE_STREAM_FILE_HDR && s->hdr_bytes) {
+		/* Too short to be a sparse image */
+		puts("Flashing Raw Image\n");
+		s->state = SPARSE_STREAM_RAW_IMAGE;
+		ret = sparse_stream_write_data(s,
+				(const char *)&s->sparse_header,
+				s->hdr_bytes);
+	}
 
-	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	if (!ret && s->state == SPARSE_STREAM_RAW_IMAGE && s->blk_buf_len) {
+		/* Pad the last block of a raw image */
+		memset(s->blk_buf + s->blk_buf_len, 0,
+		       s->info->blksz - s->blk_buf_len);
+		ret = sparse_stream_write_blks(s, 1, s->blk_buf);
+	} else if (!ret && s->state != SPARSE_STREAM_RAW_IMAGE) {
+		debug("Wrote %d blocks, expected to write %d blocks\n",
+		      s->total_blocks, s->sparse_header.total_blks);
+		if (s->state != SPARSE_STREAM_DONE ||
+		    s->total_blocks != s->sparse_header.total_blks) {
+			fastboot_fail("sparse image write failure");
+			ret = -EINVAL;
+		}
+	}
 
-	if (total_blocks != sparse_header->total_blks)
-		fastboot_fail("sparse image write failure");
+	free(s->fill_buf);
+	free(s->blk_buf);
+	s->fill_buf = NULL;
+	s->blk_buf = NULL;
+	if (ret)
+		return ret;
 
+	printf("........ wrote %llu bytes to '%s'\n", s->bytes_written,
+	       s->part_name);
 	fastboot_okay("");
-	return;
+
+	return 0;
+}
+
+void write_sparse_image(block_dev_desc_t *dev_desc,
+		disk_partition_t *info, const char *part_name,
+		void *data, unsigned sz)
+{
+	struct sparse_stream s;
+
+	if (sparse_stream_init(&s, dev_desc, info, part_name))
+		return;
+
+	sparse_stream_write(&s, data, sz);
+	sparse_stream_finish(&s);
 }
@@ -734,6 +734,11 @@ static int jump_to_copy(void)
 /* Record the board_init_f() bootstage (after arch_cpu_init()) */
 static int mark_bootstage(void)
 {
+#ifdef CONFIG_SPL_BOOTSTAGE
+	/* Add the records stashed by SPL; it is fine if there are none */
+	bootstage_unstash((void *)CONFIG_BOOTSTAGE_STASH_ADDR,
+			  CONFIG_BOOTSTAGE_STASH_SIZE);
+#endif
 	bootstage_mark_name(BOOTSTAGE_ID_START_UBOOT_F, "board_init_f");
 
 	return 0;
@@ -7,7 +7,8 @@
 
 /*
  * This module records the progress of boot and arbitrary commands, and
- * permits accurate timestamping of each.
+ * permits accurate timestamping of each. With CONFIG_SPL_BOOTSTAGE it is
+ * also built into SPL, which stashes its records for U-Boot to pick up.
  *
  * TBD: Pass timings to kernel in the FDT
  */
@@ -171,6 +172,8 @@ static const char *get_record_name(char *buf, int len,
 	return buf;
 }
 
+/* SPL only stashes its records for U-Boot to report */
+#ifndef CONFIG_SPL_BUILD
 static uint32_t print_time_record(enum bootstage_id id,
 			struct bootstage_record *rec, uint32_t prev)
 {
@@ -291,6 +294,7 @@ void bootstage_report(void)
 			prev = print_time_record(id, rec, -1);
 	}
 }
+#endif /* !CONFIG_SPL_BUILD */
 
 ulong __timer_get_boot_us(void)
 {
@@ -128,7 +128,11 @@ int do_run(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			return 1;
 		}
 
+#if defined(CONFIG_SYS_HUSH_PARSER) && defined(CONFIG_HUSH_SCRIPT_CACHE)
+		if (run_env_script(argv[i], arg) != 0)
+#else
 		if (run_command(arg, flag | CMD_FLAG_ENV) != 0)
+#endif
 			return 1;
 	}
 	return 0;
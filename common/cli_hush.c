@@ -83,6 +83,7 @@
 #include <cli.h>
 #include <cli_hush.h>
 #include <command.h>        /* find_cmd */
+#include <environment.h>
 #ifndef CONFIG_SYS_PROMPT_HUSH_PS2
 #define CONFIG_SYS_PROMPT_HUSH_PS2	"> "
 #endif
@@ -1510,6 +1511,86 @@ shell_terminal_error:
  * now has its stdout directed to the input of the appropriate pipe,
  * so this routine is noticeably simpler.
  */
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/*
+ * Check whether parsing a value from a variable again would give just that
+ * value back as a single word
+ */
+static int is_plain_word(const char *p, int quoted, const char *ifs_chars)
+{
+	/* An empty unquoted value gives no word at all */
+	if (!*p && !quoted)
+		return 0;
+	for (; *p; p++) {
+		if (*p == '\\' || *p == '\'' || *p == SPECIAL_VAR_SYMBOL ||
+		    *p == SUBSTED_VAR_SYMBOL)
+			return 0;
+		if (!quoted && (*p == '"' || *p == '#' || strchr(ifs_chars, *p)))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Substitute the variables in the arguments of a command, if that can be
+ * done without parsing the command again as make_string() does.
+ *
+ * @return new argument list, or NULL if the command must be parsed again
+ */
+static char **expand_argv(char **inp, int *nonnull, int *argcp)
+{
+	const char *ifs_chars = getenv("IFS");
+	char **argv;
+	int argc, i;
+
+	if (!ifs_chars)
+		ifs_chars = " \t\n";
+	for (argc = 0; inp[argc]; argc++)
+		;
+	argv = xmalloc((argc + 1) * sizeof(*argv));
+	for (i = 0; i < argc; i++) {
+		argv[i] = insert_var_value(inp[i]);
+		if (argv[i] == inp[i])
+			argv[i] = xstrdup(inp[i]);
+		if (!is_plain_word(argv[i], nonnull[i], ifs_chars) ||
+		    (!i && is_assignment(argv[i]))) {
+			while (i >= 0)
+				free(argv[i--]);
+			free(argv);
+			return NULL;
+		}
+	}
+	argv[argc] = NULL;
+	*argcp = argc;
+
+	return argv;
+}
+
+/* Run a command from expand_argv(), with the results of parsing it again */
+static int run_expanded(int argc, char **argv, int flag)
+{
+	int rcode;
+
+	if (strchr(argv[0], ';')) {
+		printf("Unknown command '%s' - try 'help' or use "
+				"'run' command\n", argv[0]);
+		flag_repeat = 0;
+		last_return_code = 1;
+		return 1;
+	}
+	rcode = cmd_process(flag, argc, argv, &flag_repeat, NULL);
+	if (rcode == -1)
+		flag_repeat = 0;
+	if (rcode < -1)
+		last_return_code = -rcode - 2;
+	else
+		last_return_code = rcode == 0 ? 0 : 1;
+
+	return last_return_code;
+}
+#endif
+
 static int run_pipe_real(struct pipe *pi)
 {
 	int i;
@@ -1519,6 +1600,7 @@ static int run_pipe_real(struct pipe *pi)
 	struct child_prog *child;
 	struct built_in_command *x;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1531,6 +1613,7 @@ static int run_pipe_real(struct pipe *pi)
 	int flag = do_repeat ? CMD_FLAG_REPEAT : 0;
 	struct child_prog *child;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1597,6 +1680,8 @@ static int run_pipe_real(struct pipe *pi)
 			}
 			return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 		}
+		/* Count locally, the pipe may be run again */
+		sp = child->sp;
 		for (i = 0; is_assignment(child->argv[i]); i++) {
 			p = insert_var_value(child->argv[i]);
 #ifndef __U_BOOT__
@@ -1605,12 +1690,26 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
-				child->sp--;
+				sp--;
 				free(p);
 			}
 		}
-		if (child->sp) {
+		if (sp) {
 			char * str = NULL;
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+			char **argv;
+			int argc, rcode;
+
+			argv = expand_argv(child->argv + i,
+					   child->argv_nonnull + i, &argc);
+			if (argv) {
+				rcode = run_expanded(argc, argv, flag);
+				for (i = 0; i < argc; i++)
+					free(argv[i]);
+				free(argv);
+				return rcode;
+			}
+#endif
 
 			str = make_string(child->argv + i,
 					  child->argv_nonnull + i);
@@ -1737,11 +1836,29 @@ static int run_pipe_real(struct pipe *pi)
 	return -1;
 }
 
+/*
+ * Free the values left in the list of a "for" loop and put its variable name
+ * back, so that the pipe can be run again
+ */
+static void end_for_list(struct pipe *pi, char **list, char **save_list,
+			 char *save_name)
+{
+	while (*list)
+		free(*list++);
+	free(pi->progs->argv[0]);
+	free(save_list);
+	pi->progs->argv[0] = save_name;
+#ifndef __U_BOOT__
+	pi->progs->glob_result.gl_pathv[0] = pi->progs->argv[0];
+#endif
+}
+
 static int run_list_real(struct pipe *pi)
 {
 	char *save_name = NULL;
 	char **list = NULL;
 	char **save_list = NULL;
+	struct pipe *for_pipe = NULL;
 	struct pipe *rpipe;
 	int flag_rep = 0;
 #ifndef __U_BOOT__
@@ -1781,7 +1898,8 @@ static int run_list_real(struct pipe *pi)
 				/* check Ctrl-C */
 				ctrlc();
 				if ((had_ctrlc())) {
-					return 1;
+					rcode = 1;
+					goto out;
 				}
 #endif
 				flag_restore = 0;
@@ -1812,18 +1930,13 @@ static int run_list_real(struct pipe *pi)
 				save_list = list;
 				save_name = pi->progs->argv[0];
 				pi->progs->argv[0] = NULL;
+				for_pipe = pi;
 				flag_rep = 1;
 			}
 			if (!(*list)) {
-				free(pi->progs->argv[0]);
-				free(save_list);
+				end_for_list(pi, list, save_list, save_name);
 				list = NULL;
 				flag_rep = 0;
-				pi->progs->argv[0] = save_name;
-#ifndef __U_BOOT__
-				pi->progs->glob_result.gl_pathv[0] =
-					pi->progs->argv[0];
-#endif
 				continue;
 			} else {
 				/* insert new value from list for variable */
@@ -1881,7 +1994,8 @@ static int run_list_real(struct pipe *pi)
 #else
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
-			return -2;	/* exit */
+			rcode = -2;	/* exit */
+			goto out;
 		}
 		last_return_code=(rcode == 0) ? 0 : 1;
 #endif
@@ -1901,6 +2015,9 @@ static int run_list_real(struct pipe *pi)
 		checkjobs(NULL);
 #endif
 	}
+out:
+	if (list)
+		end_for_list(for_pipe, list, save_list, save_name);
 	return rcode;
 }
 
@@ -3274,6 +3391,172 @@ int parse_file_outer(void)
 	return rcode;
 }
 
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/*
+ * Parsed scripts from environment variables, kept until the variable is
+ * changed. An env callback is bound to each cached variable to notice this.
+ */
+struct script_cache {
+	char *name;			/* environment variable */
+	struct pipe *list;		/* parsed script */
+	int busy;			/* number of runs using the list */
+	int stale;			/* variable changed while busy */
+	struct script_cache *next;
+};
+
+static struct script_cache *script_cache_head;
+
+static void script_cache_free(struct script_cache *sc)
+{
+	struct script_cache **pp;
+
+	for (pp = &script_cache_head; *pp; pp = &(*pp)->next) {
+		if (*pp == sc) {
+			*pp = sc->next;
+			break;
+		}
+	}
+	free_pipe_list(sc->list, 0);
+	free(sc->name);
+	free(sc);
+}
+
+static struct script_cache *script_cache_find(const char *name)
+{
+	struct script_cache *sc;
+
+	for (sc = script_cache_head; sc; sc = sc->next) {
+		if (!strcmp(sc->name, name))
+			return sc;
+	}
+
+	return NULL;
+}
+
+/* Drop the cached script of a variable, or mark it stale if it is running */
+static void script_cache_drop(struct script_cache *sc)
+{
+	if (sc->busy)
+		sc->stale = 1;
+	else
+		script_cache_free(sc);
+}
+
+static int on_hush_script(const char *name, const char *value, enum env_op op,
+			  int flags)
+{
+	struct script_cache *sc = script_cache_find(name);
+
+	if (sc)
+		script_cache_drop(sc);
+
+	return 0;
+}
+
+/* Parse a whole script into a list of pipes, without running it */
+static struct pipe *parse_script(const char *s)
+{
+	struct p_context ctx;
+	struct in_str input;
+	o_string temp = NULL_O_STRING;
+	char *p;
+	int rcode;
+
+	p = xmalloc(strlen(s) + 2);
+	strcpy(p, s);
+	strcat(p, "\n");
+	setup_string_in_str(&input, p);
+
+	ctx.type = FLAG_PARSE_SEMICOLON | FLAG_EXIT_FROM_LOOP |
+		   FLAG_CONT_ON_NEWLINE;
+	initialize_context(&ctx);
+	update_ifs_map();
+	input.promptmode = 1;
+	rcode = parse_stream(&temp, &ctx, &input, -1);
+	if (rcode != 1 && ctx.old_flag != 0)
+		syntax();
+	if (rcode != 1 && ctx.old_flag == 0) {
+		done_word(&temp, &ctx);
+		done_pipe(&ctx, PIPE_SEQ);
+	} else {
+		if (ctx.old_flag != 0)
+			free(ctx.stack);
+		free_pipe_list(ctx.list_head, 0);
+		ctx.list_head = NULL;
+	}
+	b_free(&temp);
+	free(p);
+
+	return ctx.list_head;
+}
+
+int run_env_script(const char *name, const char *script)
+{
+	const int flag = FLAG_PARSE_SEMICOLON | FLAG_EXIT_FROM_LOOP |
+			 FLAG_CONT_ON_NEWLINE;
+	struct script_cache *sc = script_cache_find(name);
+	ENTRY e, *ep;
+	int code;
+
+	if (!*script)
+		return 0;
+	e.key = name;
+	e.data = NULL;
+	hsearch_r(e, FIND, &ep, &env_htab, 0);
+	if (!ep)
+		return 1;
+
+	/* The callback is lost when the whole environment is imported */
+	if (sc && ep->callback != on_hush_script) {
+		script_cache_drop(sc);
+		sc = NULL;
+	}
+
+	if (!sc) {
+		/* Leave variables with a callback of their own alone */
+		if (ep->callback && ep->callback != on_hush_script)
+			return parse_string_outer(script, flag);
+
+		sc = xmalloc(sizeof(*sc));
+		sc->list = parse_script(script);
+		if (!sc->list) {
+			free(sc);
+			flag_repeat = 0;
+			return 1;
+		}
+		sc->name = xstrdup(name);
+		sc->busy = 0;
+		sc->stale = 0;
+		sc->next = script_cache_head;
+		script_cache_head = sc;
+		ep->callback = on_hush_script;
+	} else if (sc->busy || sc->stale) {
+		/* A "for" loop changes the list while it runs */
+		return parse_string_outer(script, flag);
+	}
+
+	sc->busy++;
+	code = run_list_real(sc->list);
+	if (!--sc->busy && sc->stale)
+		script_cache_free(sc);
+
+	/* Same results as parse_stream_outer() */
+	if (code == -2)
+		code = 0;
+	if (code == -1)
+		flag_repeat = 0;
+
+	return code != 0 ? 1 : 0;
+}
+
+int hush_script_cached(const char *name)
+{
+	struct script_cache *sc = script_cache_find(name);
+
+	return sc && !sc->stale;
+}
+#endif /* CONFIG_HUSH_SCRIPT_CACHE */
+
 #ifdef __U_BOOT__
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 static void u_boot_hush_reloc(void)
@@ -80,6 +80,7 @@ static int do_dfu(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 		WATCHDOG_RESET();
 		usb_gadget_handle_interrupts(controller_index);
+		dfu_write_poll();
 	}
 exit:
 	g_dnl_unregister();
@@ -20,6 +20,7 @@
  */
 
 #include <common.h>
+#include <div64.h>
 #include <linux/mtd/mtd.h>
 #include <command.h>
 #include <watchdog.h>
@@ -643,6 +644,64 @@ static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return ret == 0 ? 0 : 1;
 	}
 
+#ifdef CONFIG_CMD_NAND_BENCH
+	if (strncmp(cmd, "bench", 5) == 0) {
+		struct nand_chip *chip;
+		size_t rwsize;
+		ulong start, delta;
+		u64 speed;	/* KiB/s */
+		unsigned int cacherd;
+		int nocache;
+
+		if (argc < 5)
+			goto usage;
+
+		s = strchr(cmd, '.');
+		nocache = s && !strcmp(s, ".nocache");
+		if (s && !nocache) {
+			printf("Unknown nand command suffix '%s'.\n", s);
+			return 1;
+		}
+
+		addr = (ulong)simple_strtoul(argv[2], NULL, 16);
+
+		if (mtd_arg_off_size(argc - 3, argv + 3, &dev, &off, &size,
+				     &maxsize, MTD_DEV_TYPE_NAND,
+				     nand_info[dev].size) != 0)
+			return 1;
+
+		if (set_dev(dev))
+			return 1;
+
+		nand = &nand_info[dev];
+		chip = nand->priv;
+		rwsize = size;
+
+		cacherd = chip->options & NAND_CACHERD;
+		if (nocache)
+			chip->options &= ~NAND_CACHERD;
+
+		printf("\nNAND bench: device %d offset 0x%llx, size 0x%zx, "
+		       "cache read %s\n", dev, off, rwsize,
+		       NAND_HAS_CACHERD(chip) ? "on" : "off");
+
+		start = get_timer(0);
+		ret = nand_read_skip_bad(nand, off, &rwsize, NULL, maxsize,
+					 (u_char *)addr);
+		delta = max(get_timer(start), 1UL);
+
+		chip->options |= cacherd;
+
+		speed = (u64)rwsize * 1000;
+		do_div(speed, delta * 1024);
+		printf(" %zu bytes read in %lu ms: %s, %lu KiB/s (%lu.%02lu MiB/s)\n",
+		       rwsize, delta, ret ? "ERROR" : "OK", (ulong)speed,
+		       (ulong)speed / 1024, ((ulong)speed % 1024) * 100 / 1024);
+
+		return ret == 0 ? 0 : 1;
+	}
+#endif
+
 #ifdef CONFIG_CMD_NAND_TORTURE
 	if (strcmp(cmd, "torture") == 0) {
 		if (argc < 3)
@@ -772,6 +831,11 @@ static char nand_help_text[] =
 	"nand erase.chip [clean] - erase entire chip'\n"
 	"nand bad - show bad blocks\n"
 	"nand dump[.oob] off - dump page\n"
+#ifdef CONFIG_CMD_NAND_BENCH
+	"nand bench[.nocache] addr off|partition size\n"
+	"    read 'size' bytes like 'nand read' and report the throughput,\n"
+	"    with '.nocache' cache reads are not used.\n"
+#endif
 #ifdef CONFIG_CMD_NAND_TORTURE
 	"nand torture off - torture block at offset\n"
 #endif
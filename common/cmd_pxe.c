@@ -14,6 +14,8 @@
 #include <errno.h>
 #include <linux/list.h>
 #include <fs.h>
+#include <net.h>
+#include <net/tftp.h>
 #include <asm/io.h>
 
 #include "menu.h"
@@ -266,6 +268,69 @@ static int get_pxe_file(cmd_tbl_t *cmdtp, const char *file_path,
 
 #define PXELINUX_DIR "pxelinux.cfg/"
 
+/* Time to wait for the server when looking for a config file, in ms */
+#define PXE_PROBE_TIMEOUT	1000
+/* Number of times a lookup is sent again before giving up on it */
+#define PXE_PROBE_RETRIES	2
+/* Number of config file names whose lookup result is remembered */
+#define PXE_CACHE_SIZE		16
+
+struct pxe_cache_entry {
+	char name[48];
+	bool found;
+};
+
+/*
+ * Results of earlier config file lookups, kept as long as the server and
+ * bootfile stay the same. A repeated 'pxe get' then skips the files which
+ * were missing and goes straight to the one found before.
+ */
+static struct pxe_cache {
+	struct in_addr server;
+	char bootfile[MAX_TFTP_PATH_LEN + 1];
+	int count;
+	struct pxe_cache_entry entry[PXE_CACHE_SIZE];
+} pxe_cache;
+
+/* TFTP settings saved while looking for config files */
+static struct {
+	bool active;
+	ulong timeout_ms;
+	int timeout_count;
+	char *netretry;
+} pxe_saved;
+
+/*
+ * Most of the paths are expected to be missing, so do not wait long for a
+ * server which does not answer, and do not retry.
+ */
+static void pxe_probe_start(void)
+{
+	if (pxe_saved.active)
+		return;
+
+	pxe_saved.active = true;
+	pxe_saved.timeout_ms = tftp_timeout_ms;
+	pxe_saved.timeout_count = tftp_timeout_count_max;
+	pxe_saved.netretry = strdup(getenv("netretry"));
+	tftp_timeout_ms = getenv_ulong("pxetimeout", 10, PXE_PROBE_TIMEOUT);
+	tftp_timeout_count_max = PXE_PROBE_RETRIES;
+	setenv("netretry", "no");
+}
+
+/* Go back to the usual TFTP settings for fetching a file which is there */
+static void pxe_probe_end(void)
+{
+	if (!pxe_saved.active)
+		return;
+
+	tftp_timeout_ms = pxe_saved.timeout_ms;
+	tftp_timeout_count_max = pxe_saved.timeout_count;
+	setenv("netretry", pxe_saved.netretry);
+	free(pxe_saved.netretry);
+	pxe_saved.active = false;
+}
+
 /*
  * Retrieves a file in the 'pxelinux.cfg' folder. Since this uses get_pxe_file
  * to do the hard work, the location of the 'pxelinux.cfg' folder is generated
@@ -290,6 +355,70 @@ static int get_pxelinux_path(cmd_tbl_t *cmdtp, const char *file,
 	return get_pxe_file(cmdtp, path, pxefile_addr_r);
 }
 
+/* Forget the lookup results if the server or bootfile have changed */
+static void pxe_cache_check(void)
+{
+	const char *bootfile = getenv("bootfile") ?: "";
+
+	if (pxe_cache.server.s_addr == net_server_ip.s_addr &&
+	    !strncmp(pxe_cache.bootfile, bootfile, sizeof(pxe_cache.bootfile)))
+		return;
+
+	pxe_cache.server = net_server_ip;
+	strlcpy(pxe_cache.bootfile, bootfile, sizeof(pxe_cache.bootfile));
+	pxe_cache.count = 0;
+}
+
+/*
+ * Looks for a config file in the 'pxelinux.cfg' folder, unless an earlier
+ * lookup found that it is missing, and remembers the result.
+ *
+ * Returns 1 on success or < 0 on error.
+ */
+static int pxe_probe(cmd_tbl_t *cmdtp, const char *file,
+	unsigned long pxefile_addr_r)
+{
+	struct pxe_cache_entry *entry = NULL;
+	int err, i;
+
+	for (i = 0; i < pxe_cache.count; i++) {
+		if (!strcmp(pxe_cache.entry[i].name, file)) {
+			entry = &pxe_cache.entry[i];
+			break;
+		}
+	}
+
+	if (entry && !entry->found) {
+		printf("Skipping %s%s, not found before\n", PXELINUX_DIR, file);
+		return -ENOENT;
+	}
+
+	/* A file found before is fetched like any other file */
+	if (entry)
+		pxe_probe_end();
+	tftp_error = -1;
+	err = get_pxelinux_path(cmdtp, file, pxefile_addr_r);
+	if (entry && err <= 0)
+		pxe_probe_start();
+
+	/*
+	 * Only the server saying that the file does not exist is remembered
+	 * as a miss. A timeout or any other error may go away next time.
+	 */
+	if (err <= 0 && tftp_error != TFTP_ERR_FILE_NOT_FOUND)
+		return err;
+
+	if (!entry && pxe_cache.count < PXE_CACHE_SIZE &&
+	    strlen(file) < sizeof(entry->name)) {
+		entry = &pxe_cache.entry[pxe_cache.count++];
+		strcpy(entry->name, file);
+	}
+	if (entry)
+		entry->found = err > 0;
+
+	return err;
+}
+
 /*
  * Looks for a pxe file with a name based on the pxeuuid environment variable.
  *
@@ -304,7 +433,7 @@ static int pxe_uuid_path(cmd_tbl_t *cmdtp, unsigned long pxefile_addr_r)
 	if (!uuid_str)
 		return -ENOENT;
 
-	return get_pxelinux_path(cmdtp, uuid_str, pxefile_addr_r);
+	return pxe_probe(cmdtp, uuid_str, pxefile_addr_r);
 }
 
 /*
@@ -323,7 +452,7 @@ static int pxe_mac_path(cmd_tbl_t *cmdtp, unsigned long pxefile_addr_r)
 	if (err < 0)
 		return err;
 
-	return get_pxelinux_path(cmdtp, mac_str, pxefile_addr_r);
+	return pxe_probe(cmdtp, mac_str, pxefile_addr_r);
 }
 
 /*
@@ -341,7 +470,7 @@ static int pxe_ipaddr_paths(cmd_tbl_t *cmdtp, unsigned long pxefile_addr_r)
 	sprintf(ip_addr, "%08X", ntohl(net_ip.s_addr));
 
 	for (mask_pos = 7; mask_pos >= 0;  mask_pos--) {
-		err = get_pxelinux_path(cmdtp, ip_addr, pxefile_addr_r);
+		err = pxe_probe(cmdtp, ip_addr, pxefile_addr_r);
 
 		if (err > 0)
 			return err;
@@ -371,7 +500,7 @@ do_pxe_get(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	char *pxefile_addr_str;
 	unsigned long pxefile_addr_r;
-	int err, i = 0;
+	int err, i;
 
 	do_getfile = do_get_tftp;
 
@@ -388,30 +517,30 @@ do_pxe_get(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	if (err < 0)
 		return 1;
 
+	pxe_probe_start();
+	pxe_cache_check();
+
 	/*
 	 * Keep trying paths until we successfully get a file we're looking
 	 * for.
 	 */
+	err = 1;
 	if (pxe_uuid_path(cmdtp, pxefile_addr_r) > 0 ||
 	    pxe_mac_path(cmdtp, pxefile_addr_r) > 0 ||
-	    pxe_ipaddr_paths(cmdtp, pxefile_addr_r) > 0) {
-		printf("Config file found\n");
+	    pxe_ipaddr_paths(cmdtp, pxefile_addr_r) > 0)
+		err = 0;
 
-		return 0;
+	for (i = 0; err && pxe_default_paths[i]; i++) {
+		if (pxe_probe(cmdtp, pxe_default_paths[i],
+			      pxefile_addr_r) > 0)
+			err = 0;
 	}
 
-	while (pxe_default_paths[i]) {
-		if (get_pxelinux_path(cmdtp, pxe_default_paths[i],
-				      pxefile_addr_r) > 0) {
-			printf("Config file found\n");
-			return 0;
-		}
-		i++;
-	}
+	pxe_probe_end();
 
-	printf("Config file not found\n");
+	printf("Config file %sfound\n", err ? "not " : "");
 
-	return 1;
+	return err;
 }
 #endif
 
@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <mmc.h>
 
 static int do_unzip(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -40,6 +41,39 @@ U_BOOT_CMD(
 	"srcaddr dstaddr [dstsize]"
 );
 
+/* Largest default write buffer, when rounding it up to the erase size */
+#define GZWRITE_WBUF_MAX	(4 << 20)
+
+/* Return the erase size of a device in bytes, or 0 if not known */
+static unsigned long gzwrite_erase_size(block_dev_desc_t *bdev)
+{
+#ifdef CONFIG_GENERIC_MMC
+	struct mmc *mmc;
+
+	if (bdev->if_type == IF_TYPE_MMC) {
+		mmc = find_mmc_device(bdev->dev);
+		if (mmc)
+			return mmc->erase_grp_size * 512;
+	}
+#endif
+	return 0;
+}
+
+/* Return 0 if erased blocks of the device are known not to read as zero */
+static int gzwrite_erase_zeroes(block_dev_desc_t *bdev)
+{
+#ifdef CONFIG_GENERIC_MMC
+	struct mmc *mmc;
+
+	if (bdev->if_type == IF_TYPE_MMC) {
+		mmc = find_mmc_device(bdev->dev);
+		if (mmc)
+			return mmc->erase_zeroes;
+	}
+#endif
+	return 1;
+}
+
 static int do_gzwrite(cmd_tbl_t *cmdtp, int flag,
 		      int argc, char * const argv[])
 {
@@ -48,9 +82,16 @@ static int do_gzwrite(cmd_tbl_t *cmdtp, int flag,
 	unsigned char *addr;
 	unsigned long length;
 	unsigned long writebuf = 1<<20;
+	unsigned long erase_size;
 	u64 startoffs = 0;
 	u64 szexpected = 0;
+	uint flags = 0;
 
+	if (argc > 1 && !strcmp(argv[1], "-z")) {
+		flags |= GZWRITE_ERASE_ZERO;
+		argc--;
+		argv++;
+	}
 	if (argc < 5)
 		return CMD_RET_USAGE;
 	ret = get_device(argv[1], argv[2], &bdev);
@@ -60,6 +101,14 @@ static int do_gzwrite(cmd_tbl_t *cmdtp, int flag,
 	addr = (unsigned char *)simple_strtoul(argv[3], NULL, 16);
 	length = simple_strtoul(argv[4], NULL, 16);
 
+	/*
+	 * Write whole erase groups, so that the device need not merge, as
+	 * long as the buffer does not get too big for the malloc() area
+	 */
+	erase_size = gzwrite_erase_size(bdev);
+	if (erase_size && roundup(writebuf, erase_size) <= GZWRITE_WBUF_MAX)
+		writebuf = roundup(writebuf, erase_size);
+
 	if (5 < argc) {
 		writebuf = simple_strtoul(argv[5], NULL, 16);
 		if (6 < argc) {
@@ -70,17 +119,34 @@ static int do_gzwrite(cmd_tbl_t *cmdtp, int flag,
 		}
 	}
 
-	ret = gzwrite(addr, length, bdev, writebuf, startoffs, szexpected);
+	if ((flags & GZWRITE_ERASE_ZERO) && !gzwrite_erase_zeroes(bdev)) {
+		puts("-z needs a device which reads erased blocks as zero\n");
+		return CMD_RET_FAILURE;
+	}
+
+	if ((flags & GZWRITE_ERASE_ZERO) && erase_size &&
+	    writebuf % erase_size) {
+		printf("wbuf must be a multiple of the erase size %lx for -z\n",
+		       erase_size);
+		return CMD_RET_FAILURE;
+	}
+
+	ret = gzwrite(addr, length, bdev, writebuf, startoffs, szexpected,
+		      flags);
 
 	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
 }
 
 U_BOOT_CMD(
-	gzwrite, 8, 0, do_gzwrite,
+	gzwrite, 9, 0, do_gzwrite,
 	"unzip and write memory to block device",
-	"<interface> <dev> <addr> length [wbuf=1M [offs=0 [outsize=0]]]\n"
+	"[-z] <interface> <dev> <addr> length [wbuf=1M [offs=0 [outsize=0]]]\n"
+	"\t-z erases buffers of zeroes instead of writing them; only\n"
+	"\t\tuse it if the device reads erased blocks as zero\n"
+	"\t\t(checked for MMC)\n"
 	"\twbuf is the size in bytes (hex) of write buffer\n"
 	"\t\tand should be padded to erase size for SSDs\n"
+	"\t\t(the default is rounded up to it for MMC, up to 4M)\n"
 	"\toffs is the output start offset in bytes (hex)\n"
 	"\toutsize is the size of the expected output (hex bytes)\n"
 	"\t\tand is required for files with uncompressed lengths\n"
@@ -9,12 +9,34 @@
 #include <common.h>
 #include <command.h>
 #include <g_dnl.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <usb_mass_storage.h>
 
-static int ums_read_sector(struct ums *ums_dev,
-			   ulong start, lbaint_t blkcnt, void *buf)
+#ifndef CONFIG_UMS_CACHE_SIZE
+#define CONFIG_UMS_CACHE_SIZE	(1 << 20)
+#endif
+
+/*
+ * The gadget hands us at most FSG_BUFLEN at a time. Small transfers are
+ * slow on eMMC, so one buffer holds either blocks read ahead of a
+ * sequential read or sequential writes which have not reached the device
+ * yet. Blocks are counted from the start of the UMS area.
+ */
+struct ums_cache {
+	void *buf;
+	lbaint_t size;		/* Size of buf in blocks, 0 if disabled */
+	lbaint_t start;		/* First block held in buf */
+	lbaint_t count;		/* Number of blocks held in buf */
+	bool dirty;		/* The blocks held must be written back */
+	lbaint_t next_read;	/* Block following the last read */
+};
+
+static struct ums_cache ums_cache;
+
+static lbaint_t ums_blk_read(struct ums *ums_dev, lbaint_t start,
+			     lbaint_t blkcnt, void *buf)
 {
 	block_dev_desc_t *block_dev = ums_dev->block_dev;
 	lbaint_t blkstart = start + ums_dev->start_sector;
@@ -23,8 +45,8 @@ static int ums_read_sector(struct ums *ums_dev,
 	return block_dev->block_read(dev_num, blkstart, blkcnt, buf);
 }
 
-static int ums_write_sector(struct ums *ums_dev,
-			    ulong start, lbaint_t blkcnt, const void *buf)
+static lbaint_t ums_blk_write(struct ums *ums_dev, lbaint_t start,
+			      lbaint_t blkcnt, const void *buf)
 {
 	block_dev_desc_t *block_dev = ums_dev->block_dev;
 	lbaint_t blkstart = start + ums_dev->start_sector;
@@ -33,9 +55,101 @@ static int ums_write_sector(struct ums *ums_dev,
 	return block_dev->block_write(dev_num, blkstart, blkcnt, buf);
 }
 
+static int ums_flush(struct ums *ums_dev)
+{
+	struct ums_cache *c = &ums_cache;
+	lbaint_t count = c->count;
+
+	if (!c->dirty)
+		return 0;
+
+	/* The data is dropped on error, the host is told about it */
+	c->dirty = false;
+	c->count = 0;
+	if (ums_blk_write(ums_dev, c->start, count, c->buf) != count) {
+		printf("UMS: write of %lu blocks at %#lx failed\n",
+		       (ulong)count, (ulong)c->start);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int ums_read_sector(struct ums *ums_dev,
+			   ulong start, lbaint_t blkcnt, void *buf)
+{
+	struct ums_cache *c = &ums_cache;
+	bool sequential = start == c->next_read;
+	lbaint_t count;
+
+	c->next_read = start + blkcnt;
+	if (!c->size)
+		return ums_blk_read(ums_dev, start, blkcnt, buf);
+
+	/* Written blocks must reach the device before they are read back */
+	if (ums_flush(ums_dev))
+		return 0;
+
+	if (c->count && start >= c->start &&
+	    start + blkcnt <= c->start + c->count) {
+		memcpy(buf, c->buf + (start - c->start) * SECTOR_SIZE,
+		       blkcnt * SECTOR_SIZE);
+		return blkcnt;
+	}
+
+	/* Only read ahead for a sequential read which the buffer can hold */
+	count = min(c->size, (lbaint_t)ums_dev->num_sectors - start);
+	if (!sequential || blkcnt > count)
+		return ums_blk_read(ums_dev, start, blkcnt, buf);
+
+	c->count = 0;
+	if (ums_blk_read(ums_dev, start, count, c->buf) != count)
+		return ums_blk_read(ums_dev, start, blkcnt, buf);
+	c->start = start;
+	c->count = count;
+	memcpy(buf, c->buf, blkcnt * SECTOR_SIZE);
+
+	return blkcnt;
+}
+
+static int ums_write_sector(struct ums *ums_dev,
+			    ulong start, lbaint_t blkcnt, const void *buf)
+{
+	struct ums_cache *c = &ums_cache;
+	lbaint_t done, count;
+
+	if (!c->size)
+		return ums_blk_write(ums_dev, start, blkcnt, buf);
+
+	/* Drop blocks read ahead, or write back unless this continues them */
+	if (!c->dirty)
+		c->count = 0;
+	else if (start != c->start + c->count && ums_flush(ums_dev))
+		return 0;
+
+	if (!c->count && blkcnt >= c->size)
+		return ums_blk_write(ums_dev, start, blkcnt, buf);
+
+	for (done = 0; done < blkcnt; done += count) {
+		if (!c->count) {
+			c->start = start + done;
+			c->dirty = true;
+		}
+		count = min(blkcnt - done, c->size - c->count);
+		memcpy(c->buf + c->count * SECTOR_SIZE,
+		       buf + done * SECTOR_SIZE, count * SECTOR_SIZE);
+		c->count += count;
+		if (c->count == c->size && ums_flush(ums_dev))
+			return 0;
+	}
+
+	return blkcnt;
+}
+
 static struct ums ums_dev = {
 	.read_sector = ums_read_sector,
 	.write_sector = ums_write_sector,
+	.flush = ums_flush,
 	.name = "UMS disk",
 };
 
@@ -56,6 +170,17 @@ struct ums *ums_init(const char *devtype, const char *devnum)
 	ums_dev.start_sector = 0;
 	ums_dev.num_sectors = block_dev->lba;
 
+	/* Without a buffer, reads and writes go straight to the device */
+	if (!ums_cache.buf && CONFIG_UMS_CACHE_SIZE) {
+		ums_cache.buf = memalign(ARCH_DMA_MINALIGN,
+					 CONFIG_UMS_CACHE_SIZE);
+		if (ums_cache.buf)
+			ums_cache.size = CONFIG_UMS_CACHE_SIZE / SECTOR_SIZE;
+	}
+	ums_cache.count = 0;
+	ums_cache.dirty = false;
+	ums_cache.next_read = -1;
+
 	printf("UMS: disk start sector: %#x, count: %#x\n",
 	       ums_dev.start_sector, ums_dev.num_sectors);
 
@@ -153,6 +278,8 @@ int do_usb_mass_storage(cmd_tbl_t *cmdtp, int flag,
 		}
 	}
 exit:
+	if (ums_flush(ums))
+		error("UMS: data written by the host has been lost");
 	g_dnl_unregister();
 	board_usb_cleanup(controller_index, USB_INIT_DEVICE);
 	return CMD_RET_SUCCESS;
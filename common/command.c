@@ -11,8 +11,55 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <linux/ctype.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Pointers to the linker-list commands sorted by name, built on first use */
+static cmd_tbl_t **cmd_index;
+
+static int cmd_index_cmp(const void *a, const void *b)
+{
+	cmd_tbl_t *const *x = a, *const *y = b;
+	int ret = strcmp((*x)->name, (*y)->name);
+
+	/* Keep the table order for duplicate names */
+	if (!ret)
+		ret = *x < *y ? -1 : *x > *y;
+
+	return ret;
+}
+
+/**
+ * get_cmd_index() - Get the sorted index of the command table
+ *
+ * The index is only built after relocation, since the table moves and
+ * there is little malloc() space before then.
+ *
+ * @return pointer to the index, or NULL if it is not available
+ */
+static cmd_tbl_t **get_cmd_index(void)
+{
+	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	int i;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return NULL;
+	if (cmd_index)
+		return cmd_index;
+
+	cmd_index = malloc(count * sizeof(*cmd_index));
+	if (!cmd_index)
+		return NULL;
+	for (i = 0; i < count; i++)
+		cmd_index[i] = start + i;
+	qsort(cmd_index, count, sizeof(*cmd_index), cmd_index_cmp);
+
+	return cmd_index;
+}
+
 /*
  * Use puts() instead of printf() to avoid printf buffer overflow
  * for long help messages
@@ -25,30 +72,21 @@ int _do_help(cmd_tbl_t *cmd_start, int cmd_items, cmd_tbl_t *cmdtp, int flag,
 	int rcode = 0;
 
 	if (argc == 1) {	/* show list of commands */
-		cmd_tbl_t *cmd_array[cmd_items];
-		int i, j, swaps;
+		cmd_tbl_t *local_array[cmd_items];
+		cmd_tbl_t **cmd_array = local_array;
+		int i;
 
-		/* Make array of commands from .uboot_cmd section */
-		cmdtp = cmd_start;
-		for (i = 0; i < cmd_items; i++) {
-			cmd_array[i] = cmdtp++;
-		}
+		if (cmd_start == ll_entry_start(cmd_tbl_t, cmd) &&
+		    get_cmd_index()) {
+			cmd_array = cmd_index;
+		} else {
+			/* Make array of commands from .uboot_cmd section */
+			cmdtp = cmd_start;
+			for (i = 0; i < cmd_items; i++)
+				cmd_array[i] = cmdtp++;
 
-		/* Sort command list (trivial bubble sort) */
-		for (i = cmd_items - 1; i > 0; --i) {
-			swaps = 0;
-			for (j = 0; j < i; ++j) {
-				if (strcmp(cmd_array[j]->name,
-					   cmd_array[j + 1]->name) > 0) {
-					cmd_tbl_t *tmp;
-					tmp = cmd_array[j];
-					cmd_array[j] = cmd_array[j + 1];
-					cmd_array[j + 1] = tmp;
-					++swaps;
-				}
-			}
-			if (!swaps)
-				break;
+			qsort(cmd_array, cmd_items, sizeof(*cmd_array),
+			      cmd_index_cmp);
 		}
 
 		/* print short help (usage) */
@@ -117,8 +155,39 @@ cmd_tbl_t *find_cmd_tbl(const char *cmd, cmd_tbl_t *table, int table_len)
 cmd_tbl_t *find_cmd(const char *cmd)
 {
 	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
-	const int len = ll_entry_count(cmd_tbl_t, cmd);
-	return find_cmd_tbl(cmd, start, len);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	cmd_tbl_t **index = get_cmd_index();
+	const char *p;
+	int len, lo, hi, mid;
+
+	if (!index)
+		return find_cmd_tbl(cmd, start, count);
+	if (!cmd)
+		return NULL;
+	len = ((p = strchr(cmd, '.')) == NULL) ? strlen(cmd) : (p - cmd);
+
+	/*
+	 * Commands starting with the given name are next to each other in
+	 * the index, with a full match first. Find the first of them.
+	 */
+	lo = 0;
+	hi = count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strncmp(index[mid]->name, cmd, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == count || strncmp(index[lo]->name, cmd, len))
+		return NULL;	/* not found */
+	if (index[lo]->name[len] == '\0')
+		return index[lo];	/* full match */
+	if (lo + 1 < count && !strncmp(index[lo + 1]->name, cmd, len))
+		return NULL;	/* ambiguous command */
+
+	return index[lo];	/* abbreviated command */
 }
 
 int cmd_usage(const cmd_tbl_t *cmdtp)
@@ -432,8 +501,6 @@ int cmd_get_data_size(char* arg, int default_size)
 #endif
 
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
-DECLARE_GLOBAL_DATA_PTR;
-
 void fixup_cmdtable(cmd_tbl_t *cmdtp, int size)
 {
 	int	i;
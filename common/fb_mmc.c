@@ -6,6 +6,7 @@
 
 #include <config.h>
 #include <common.h>
+#include <errno.h>
 #include <fb_mmc.h>
 #include <part.h>
 #include <aboot.h>
@@ -134,6 +135,49 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 				download_bytes);
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static struct sparse_stream fb_stream;
+static disk_partition_t fb_stream_info;
+
+int fb_mmc_stream_start(const char *cmd, char *response)
+{
+	block_dev_desc_t *dev_desc;
+
+	/* initialize the response buffer */
+	response_str = response;
+
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		error("invalid mmc device\n");
+		fastboot_fail("invalid mmc device");
+		return -ENODEV;
+	}
+
+	if (get_partition_info_efi_by_name_or_alias(dev_desc, cmd,
+						    &fb_stream_info)) {
+		error("cannot find partition: '%s'\n", cmd);
+		fastboot_fail("cannot find partition");
+		return -ENOENT;
+	}
+
+	return sparse_stream_init(&fb_stream, dev_desc, &fb_stream_info, cmd);
+}
+
+int fb_mmc_stream_write(const void *buf, unsigned int len, char *response)
+{
+	response_str = response;
+
+	return sparse_stream_write(&fb_stream, buf, len);
+}
+
+int fb_mmc_stream_finish(char *response)
+{
+	response_str = response;
+
+	return sparse_stream_finish(&fb_stream);
+}
+#endif
+
 void fb_mmc_erase(const char *cmd, char *response)
 {
 	int ret;
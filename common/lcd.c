@@ -58,8 +58,8 @@ char lcd_is_enabled = 0;
 static void *lcd_base;			/* Start of framebuffer memory	*/
 static char lcd_flush_dcache;	/* 1 to flush dcache after each lcd update */
 
-/* Flush LCD activity to the caches */
-void lcd_sync(void)
+/* Flush LCD activity between start and end to the caches */
+void lcd_sync_range(void *start, void *end)
 {
 	/*
 	 * flush_dcache_range() is declared in common.h but it seems that some
@@ -67,11 +67,9 @@ void lcd_sync(void)
 	 * out whether it exists? For now, ARM is safe.
 	 */
 #if defined(CONFIG_ARM) && !defined(CONFIG_SYS_DCACHE_OFF)
-	int line_length;
-
 	if (lcd_flush_dcache)
-		flush_dcache_range((u32)lcd_base,
-			(u32)(lcd_base + lcd_get_size(&line_length)));
+		flush_dcache_range((ulong)start & ~(ARCH_DMA_MINALIGN - 1),
+				   ALIGN((ulong)end, ARCH_DMA_MINALIGN));
 #elif defined(CONFIG_SANDBOX) && defined(CONFIG_VIDEO_SANDBOX_SDL)
 	static ulong last_sync;
 
@@ -82,6 +80,14 @@ void lcd_sync(void)
 #endif
 }
 
+/* Flush LCD activity to the caches */
+void lcd_sync(void)
+{
+	int line_length;
+
+	lcd_sync_range(lcd_base, lcd_base + lcd_get_size(&line_length));
+}
+
 void lcd_set_flush_dcache(int flush)
 {
 	lcd_flush_dcache = (flush != 0);
@@ -351,6 +357,8 @@ void lcd_logo_plot(int x, int y)
 	debug("Logo: width %d  height %d  colors %d\n",
 	      BMP_LOGO_WIDTH, BMP_LOGO_HEIGHT, BMP_LOGO_COLORS);
 
+	lcd_console_unscroll();
+
 	if (bpix < 12) {
 		WATCHDOG_RESET();
 		lcd_logo_set_cmap();
@@ -636,6 +644,7 @@ int lcd_display_bitmap(ulong bmp_image, int x, int y)
 		height = panel_info.vl_row - y;
 
 	bmap = (uchar *)bmp + get_unaligned_le32(&bmp->header.data_offset);
+	lcd_console_unscroll();
 	fb   = (uchar *)(lcd_base +
 		(y + height - 1) * lcd_line_length + x * bpix / 8);
 
@@ -16,6 +16,63 @@
 
 static struct console_t cons;
 
+/* Hardware scrolling as set up by the driver */
+static int hw_scroll_lines;
+static void (*hw_scroll_set)(int line);
+
+void lcd_set_hw_scroll(int spare_lines, void (*set_offset)(int line))
+{
+	hw_scroll_lines = set_offset ? spare_lines : 0;
+	hw_scroll_set = set_offset;
+}
+
+void lcd_get_hw_scroll(int *spare_lines, void (**set_offset)(int line))
+{
+	*spare_lines = hw_scroll_lines;
+	*set_offset = hw_scroll_set;
+}
+
+void lcd_console_save(struct console_t *pcons)
+{
+	*pcons = cons;
+}
+
+void lcd_console_restore(const struct console_t *pcons)
+{
+	cons = *pcons;
+}
+
+/* Bytes in one line of pixels */
+static inline ulong console_line_size(struct console_t *pcons)
+{
+	return pcons->lcdsizex * sizeof(fbptr_t);
+}
+
+/* Record that the text rows first to last need flushing */
+static void console_mark_dirty(struct console_t *pcons, u32 first, u32 last)
+{
+	ulong row_size = VIDEO_FONT_HEIGHT * console_line_size(pcons);
+	void *start = pcons->fbbase + first * row_size;
+	void *end = pcons->fbbase + (last + 1) * row_size;
+
+	if (!pcons->dirty_start || start < pcons->dirty_start)
+		pcons->dirty_start = start;
+	if (end > pcons->dirty_end)
+		pcons->dirty_end = end;
+}
+
+/* Flush the text rows changed since the last time */
+static void console_sync(struct console_t *pcons)
+{
+	/* A rotated text row is spread over the whole frame buffer */
+	if (pcons->lcdrot)
+		lcd_sync();
+	else if (pcons->dirty_start)
+		lcd_sync_range(pcons->dirty_start, pcons->dirty_end);
+	pcons->dirty_start = NULL;
+	pcons->dirty_end = NULL;
+}
+
 void lcd_set_col(short col)
 {
 	cons.curr_col = col;
@@ -75,7 +132,6 @@ static inline void console_setrow0(struct console_t *pcons, u32 row, int clr)
 static inline void console_moverow0(struct console_t *pcons,
 				    u32 rowdst, u32 rowsrc)
 {
-	int i;
 	fbptr_t *dst = (fbptr_t *)pcons->fbbase +
 				  rowdst * VIDEO_FONT_HEIGHT *
 				  pcons->lcdsizex;
@@ -84,8 +140,7 @@ static inline void console_moverow0(struct console_t *pcons,
 				  rowsrc * VIDEO_FONT_HEIGHT *
 				  pcons->lcdsizex;
 
-	for (i = 0; i < (VIDEO_FONT_HEIGHT * pcons->lcdsizex); i++)
-		*dst++ = *src++;
+	memcpy(dst, src, VIDEO_FONT_HEIGHT * console_line_size(pcons));
 }
 
 static inline void console_back(void)
@@ -99,6 +154,39 @@ static inline void console_back(void)
 	cons.fp_putc_xy(&cons,
 			cons.curr_col * VIDEO_FONT_WIDTH,
 			cons.curr_row * VIDEO_FONT_HEIGHT, ' ');
+	console_mark_dirty(&cons, cons.curr_row, cons.curr_row);
+}
+
+/* Move the displayed area down by the given number of text rows */
+static void console_scroll_hw(int rows)
+{
+	ulong line_size = console_line_size(&cons);
+	u32 lines = rows * VIDEO_FONT_HEIGHT;
+	u32 text_lines = cons.rows * VIDEO_FONT_HEIGHT;
+	fbptr_t *dst;
+	int bg_color, i;
+
+	if (cons.scroll_pos + lines > cons.scroll_lines) {
+		/* Out of spare lines, so move the kept rows back to the top */
+		memmove(cons.fbstart, cons.fbbase + lines * line_size,
+			(text_lines - lines) * line_size);
+		cons.scroll_pos = 0;
+	} else {
+		cons.scroll_pos += lines;
+	}
+	cons.fbbase = cons.fbstart + cons.scroll_pos * line_size;
+
+	/* Clear the lines below the last text row, which may be stale */
+	if (cons.lcdsizey > text_lines) {
+		bg_color = lcd_getbgcolor();
+		dst = cons.fbbase + text_lines * line_size;
+		for (i = 0; i < (cons.lcdsizey - text_lines) * cons.lcdsizex;
+		     i++)
+			*dst++ = bg_color;
+		lcd_sync_range(cons.fbbase + text_lines * line_size,
+			       cons.fbbase + cons.lcdsizey * line_size);
+	}
+	hw_scroll_set(cons.scroll_pos);
 }
 
 static inline void console_newline(void)
@@ -111,13 +199,35 @@ static inline void console_newline(void)
 
 	/* Check if we need to scroll the terminal */
 	if (++cons.curr_row >= cons.rows) {
-		for (i = 0; i < cons.rows-rows; i++)
-			cons.fp_console_moverow(&cons, i, i+rows);
+		if (cons.scroll_lines) {
+			console_scroll_hw(rows);
+			if (!cons.scroll_pos)
+				console_mark_dirty(&cons, 0, cons.rows - 1);
+		} else {
+			for (i = 0; i < cons.rows-rows; i++)
+				cons.fp_console_moverow(&cons, i, i+rows);
+			console_mark_dirty(&cons, 0, cons.rows - 1);
+		}
 		for (i = 0; i < rows; i++)
 			cons.fp_console_setrow(&cons, cons.rows-i-1, bg_color);
+		console_mark_dirty(&cons, cons.rows - rows, cons.rows - 1);
 		cons.curr_row -= rows;
 	}
-	lcd_sync();
+	console_sync(&cons);
+}
+
+void lcd_console_unscroll(void)
+{
+	if (!cons.scroll_pos)
+		return;
+
+	memmove(cons.fbstart, cons.fbbase,
+		cons.lcdsizey * console_line_size(&cons));
+	cons.scroll_pos = 0;
+	cons.fbbase = cons.fbstart;
+	console_mark_dirty(&cons, 0, cons.rows - 1);
+	console_sync(&cons);
+	hw_scroll_set(0);
 }
 
 void console_calc_rowcol(struct console_t *pcons, u32 sizex, u32 sizey)
@@ -140,6 +250,7 @@ void lcd_init_console(void *address, int vl_cols, int vl_rows, int vl_rot)
 {
 	memset(&cons, 0, sizeof(cons));
 	cons.fbbase = address;
+	cons.fbstart = address;
 
 	cons.lcdsizex = vl_cols;
 	cons.lcdsizey = vl_rows;
@@ -152,6 +263,14 @@ void lcd_init_console(void *address, int vl_cols, int vl_rows, int vl_rot)
 
 	lcd_init_console_rot(&cons);
 
+#if !defined(CONFIG_LCD_LOGO) || defined(CONFIG_LCD_INFO_BELOW_LOGO)
+	/* Scrolling the screen would otherwise move the logo */
+	if (hw_scroll_lines && !vl_rot) {
+		cons.scroll_lines = hw_scroll_lines;
+		hw_scroll_set(0);
+	}
+#endif
+
 	debug("lcd_console: have %d/%d col/rws on scr %dx%d (%d deg rotated)\n",
 	      cons.cols, cons.rows, cons.lcdsizex, cons.lcdsizey, vl_rot);
 }
@@ -188,6 +307,7 @@ void lcd_putc(const char c)
 		cons.fp_putc_xy(&cons,
 				cons.curr_col * VIDEO_FONT_WIDTH,
 				cons.curr_row * VIDEO_FONT_HEIGHT, c);
+		console_mark_dirty(&cons, cons.curr_row, cons.curr_row);
 		if (++cons.curr_col >= cons.cols)
 			console_newline();
 	}
@@ -204,7 +324,7 @@ void lcd_puts(const char *s)
 	while (*s)
 		lcd_putc(*s++);
 
-	lcd_sync();
+	console_sync(&cons);
 }
 
 void lcd_printf(const char *fmt, ...)
@@ -198,10 +198,13 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 	 */
 	timer_init();
 #endif
+	/* The time up to here includes getting SDRAM going */
+	bootstage_mark_name(BOOTSTAGE_ID_START_SPL, "spl_board_init_r");
 
 #ifdef CONFIG_SPL_BOARD_INIT
 	spl_board_init();
 #endif
+	bootstage_mark_name(BOOTSTAGE_ID_SPL_INIT_DONE, "spl_board_init");
 
 	boot_device = spl_boot_device();
 	debug("boot device - %d\n", boot_device);
@@ -278,6 +281,7 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 #endif
 		hang();
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_SPL_LOAD_DONE, "spl_load_image");
 
 	switch (spl_image.os) {
 	case IH_OS_U_BOOT:
@@ -298,6 +302,13 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 #endif
 
 	debug("loaded - jumping to U-Boot...");
+	bootstage_mark_name(BOOTSTAGE_ID_END_SPL, "end_spl");
+#ifdef CONFIG_SPL_BOOTSTAGE
+	/* U-Boot picks these up in board_init_f() */
+	if (bootstage_stash((void *)CONFIG_BOOTSTAGE_STASH_ADDR,
+			    CONFIG_BOOTSTAGE_STASH_SIZE))
+		puts("SPL: failed to stash bootstage data\n");
+#endif
 	jump_to_image_no_args(&spl_image);
 }
 
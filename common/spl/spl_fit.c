@@ -0,0 +1,581 @@
+/*
+ * Load a FIT image from a block device, one sub-image at a time
+ *
+ * Only the parts of the FIT which are needed are read: the device tree
+ * structure is walked in place, a block at a time, and the data of the
+ * selected images is read straight to its load address. Images which are
+ * compressed with gzip are inflated while they are read.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <spl.h>
+#include <libfdt_env.h>
+#include <fdt.h>
+#include <u-boot/zlib.h>
+
+#ifndef CONFIG_SPL_FIT_MAX_IMAGES
+#define CONFIG_SPL_FIT_MAX_IMAGES	8
+#endif
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/* Longest node name and property string which is looked at */
+#define FIT_NAME_LEN		32
+/* Size of the list of loadables in a configuration */
+#define FIT_LOADABLES_LEN	128
+/* Number of blocks read at a time while inflating */
+#define FIT_GZIP_BLOCKS		64
+
+#define FIT_HAS_LOAD		(1 << 0)
+#define FIT_HAS_ENTRY		(1 << 1)
+
+/* Where a sub-image is in the FIT and where it goes */
+struct fit_image {
+	char name[FIT_NAME_LEN];
+	ulong data;		/* offset of the data from the start of the FIT */
+	ulong size;		/* size of the data in the FIT */
+	ulong load;
+	ulong entry;
+	u8 comp;		/* IH_COMP_..., or IH_COMP_NONE - 1 if unknown */
+	u8 flags;		/* FIT_HAS_... */
+};
+
+/* What is collected from the FIT while walking its structure */
+struct fit_info {
+	struct fit_image image[CONFIG_SPL_FIT_MAX_IMAGES];
+	int count;
+	char conf_default[FIT_NAME_LEN];
+	char firmware[FIT_NAME_LEN];
+	char fdt[FIT_NAME_LEN];
+	char loadables[FIT_LOADABLES_LEN];
+	int loadables_len;
+};
+
+/* Block cache for reading the device tree part of the FIT */
+struct fit_reader {
+	struct spl_load_info *info;
+	ulong sector;		/* first sector of the FIT */
+	u8 *buf;
+	long buf_block;		/* block in buf, relative to sector */
+	char *strings;
+	ulong strings_size;
+};
+
+enum {
+	FIT_SECTION_NONE,
+	FIT_SECTION_IMAGES,
+	FIT_SECTION_CONFIGS,
+};
+
+static int fit_read_bytes(struct fit_reader *r, ulong offset, void *dst,
+			  ulong len)
+{
+	const int bl_len = r->info->bl_len;
+
+	while (len) {
+		long block = offset / bl_len;
+		ulong skip = offset % bl_len;
+		ulong n = min(len, bl_len - skip);
+
+		if (block != r->buf_block) {
+			if (r->info->read(r->info, r->sector + block, 1,
+					  r->buf) != 1)
+				return -EIO;
+			r->buf_block = block;
+		}
+		memcpy(dst, r->buf + skip, n);
+		dst += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int fit_read_u32(struct fit_reader *r, ulong offset, u32 *valp)
+{
+	fdt32_t val;
+	int ret;
+
+	ret = fit_read_bytes(r, offset, &val, sizeof(val));
+	*valp = fdt32_to_cpu(val);
+
+	return ret;
+}
+
+/* Read an address, which is one or two cells; the high cell must be 0 */
+static int fit_read_addr(struct fit_reader *r, ulong offset, ulong len,
+			 ulong *addrp)
+{
+	u32 val;
+	int ret;
+
+	if (len != 4 && len != 8)
+		return -EINVAL;
+	if (len == 8) {
+		ret = fit_read_u32(r, offset, &val);
+		if (ret)
+			return ret;
+		if (val)
+			return -ERANGE;
+	}
+	ret = fit_read_u32(r, offset + len - 4, &val);
+	*addrp = val;
+
+	return ret;
+}
+
+/* Read a string property, or the first string of a list, into @buf */
+static int fit_read_str(struct fit_reader *r, ulong offset, ulong len,
+			char *buf, int size)
+{
+	int ret;
+
+	if (len > size - 1)
+		len = size - 1;
+	ret = fit_read_bytes(r, offset, buf, len);
+	buf[len] = '\0';
+
+	return ret;
+}
+
+static int fit_image_prop(struct fit_reader *r, struct fit_image *img,
+			  const char *name, ulong offset, ulong len)
+{
+	char comp[8];
+	int ret = 0;
+
+	if (!strcmp(name, FIT_DATA_PROP)) {
+		img->data = offset;
+		img->size = len;
+	} else if (!strcmp(name, FIT_LOAD_PROP)) {
+		ret = fit_read_addr(r, offset, len, &img->load);
+		img->flags |= FIT_HAS_LOAD;
+	} else if (!strcmp(name, FIT_ENTRY_PROP)) {
+		ret = fit_read_addr(r, offset, len, &img->entry);
+		img->flags |= FIT_HAS_ENTRY;
+	} else if (!strcmp(name, FIT_COMP_PROP)) {
+		ret = fit_read_str(r, offset, len, comp, sizeof(comp));
+		if (!strcmp(comp, "none"))
+			img->comp = IH_COMP_NONE;
+		else if (!strcmp(comp, "gzip"))
+			img->comp = IH_COMP_GZIP;
+		else if (!strcmp(comp, "lz4"))
+			img->comp = IH_COMP_LZ4;
+		else
+			img->comp = IH_COMP_NONE - 1;
+	}
+
+	return ret;
+}
+
+static int fit_config_prop(struct fit_reader *r, struct fit_info *fit,
+			   const char *name, ulong offset, ulong len)
+{
+	if (!strcmp(name, FIT_FIRMWARE_PROP))
+		return fit_read_str(r, offset, len, fit->firmware,
+				    sizeof(fit->firmware));
+	if (!strcmp(name, FIT_FDT_PROP))
+		return fit_read_str(r, offset, len, fit->fdt,
+				    sizeof(fit->fdt));
+	if (!strcmp(name, FIT_LOADABLE_PROP)) {
+		fit->loadables_len = min_t(ulong, len,
+					    sizeof(fit->loadables) - 1);
+		fit->loadables[fit->loadables_len] = '\0';
+		return fit_read_bytes(r, offset, fit->loadables,
+				      fit->loadables_len);
+	}
+
+	return 0;
+}
+
+/*
+ * Walk the structure block of the FIT and note the images and the
+ * selected configuration. Property values are only read when they are
+ * of interest, so the image data is skipped without reading it.
+ */
+static int fit_walk(struct fit_reader *r, struct fit_info *fit)
+{
+	struct fit_image *img = NULL;
+	struct fdt_header hdr;
+	ulong offset, end;
+	int section = FIT_SECTION_NONE;
+	int conf_found = 0;
+	int in_conf = 0;
+	int depth = 0;
+	int ret;
+
+	ret = fit_read_bytes(r, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (fdt32_to_cpu(hdr.magic) != FDT_MAGIC ||
+	    fdt32_to_cpu(hdr.version) < 17)
+		return -EINVAL;
+
+	r->strings_size = fdt32_to_cpu(hdr.size_dt_strings);
+	r->strings = malloc(r->strings_size + 1);
+	if (!r->strings)
+		return -ENOMEM;
+	ret = fit_read_bytes(r, fdt32_to_cpu(hdr.off_dt_strings), r->strings,
+			     r->strings_size);
+	if (ret)
+		return ret;
+	r->strings[r->strings_size] = '\0';
+
+	offset = fdt32_to_cpu(hdr.off_dt_struct);
+	end = offset + fdt32_to_cpu(hdr.size_dt_struct);
+	while (offset < end) {
+		char name[FIT_NAME_LEN];
+		u32 tag, len, nameoff;
+		ulong n;
+
+		ret = fit_read_u32(r, offset, &tag);
+		if (ret)
+			return ret;
+		offset += FDT_TAGSIZE;
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			len = min(end - offset, (ulong)FIT_NAME_LEN);
+			ret = fit_read_bytes(r, offset, name, len);
+			if (ret)
+				return ret;
+			n = strnlen(name, len);
+			if (n == len) {
+				/* Too long to be of interest; find the end */
+				while (offset + n < end) {
+					ret = fit_read_bytes(r, offset + n,
+							     name, 1);
+					if (ret)
+						return ret;
+					if (!name[0])
+						break;
+					n++;
+				}
+				name[0] = '\0';
+			}
+			offset += ALIGN(n + 1, FDT_TAGSIZE);
+			depth++;
+
+			if (depth == 2 && !strcmp(name, FIT_IMAGES_PATH + 1))
+				section = FIT_SECTION_IMAGES;
+			else if (depth == 2 &&
+				 !strcmp(name, FIT_CONFS_PATH + 1))
+				section = FIT_SECTION_CONFIGS;
+			else if (depth == 3 && section == FIT_SECTION_IMAGES &&
+				 fit->count < CONFIG_SPL_FIT_MAX_IMAGES &&
+				 name[0]) {
+				img = &fit->image[fit->count++];
+				strcpy(img->name, name);
+			} else if (depth == 3 &&
+				   section == FIT_SECTION_CONFIGS) {
+				/* Use the default, else the first one */
+				if (fit->conf_default[0])
+					in_conf = !strcmp(name,
+							  fit->conf_default);
+				else
+					in_conf = !conf_found;
+				conf_found |= in_conf;
+			}
+			break;
+		case FDT_END_NODE:
+			if (depth == 3) {
+				img = NULL;
+				in_conf = 0;
+			} else if (depth == 2) {
+				section = FIT_SECTION_NONE;
+			}
+			depth--;
+			break;
+		case FDT_PROP:
+			ret = fit_read_u32(r, offset, &len);
+			if (!ret)
+				ret = fit_read_u32(r, offset + 4, &nameoff);
+			if (ret)
+				return ret;
+			if (nameoff >= r->strings_size)
+				return -EINVAL;
+			offset += 8;
+
+			if (depth == 3 && img)
+				ret = fit_image_prop(r, img,
+						     r->strings + nameoff,
+						     offset, len);
+			else if (depth == 3 && in_conf)
+				ret = fit_config_prop(r, fit,
+						      r->strings + nameoff,
+						      offset, len);
+			else if (depth == 2 && section == FIT_SECTION_CONFIGS &&
+				 !strcmp(r->strings + nameoff,
+					 FIT_DEFAULT_PROP))
+				ret = fit_read_str(r, offset, len,
+						   fit->conf_default,
+						   sizeof(fit->conf_default));
+			if (ret)
+				return ret;
+			offset += ALIGN(len, FDT_TAGSIZE);
+			break;
+		case FDT_NOP:
+			break;
+		case FDT_END:
+			return conf_found ? 0 : -ENOENT;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static struct fit_image *fit_find_image(struct fit_info *fit,
+					const char *name)
+{
+	int i;
+
+	for (i = 0; i < fit->count; i++) {
+		if (!strcmp(fit->image[i].name, name))
+			return &fit->image[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Read data from the FIT to @dst. The whole blocks are read to the first
+ * cache-aligned address at or above @dst and the data is then moved down,
+ * so up to two blocks plus ARCH_DMA_MINALIGN bytes beyond the end of the
+ * data are overwritten.
+ */
+static int fit_read_data(struct fit_reader *r, ulong offset, ulong size,
+			 void *dst)
+{
+	const int bl_len = r->info->bl_len;
+	ulong skip = offset % bl_len;
+	ulong count = DIV_ROUND_UP(skip + size, bl_len);
+	void *buf = (void *)ALIGN((ulong)dst, ARCH_DMA_MINALIGN);
+
+	if (r->info->read(r->info, r->sector + offset / bl_len, count,
+			  buf) != count)
+		return -EIO;
+	if (buf + skip != dst)
+		memmove(dst, buf + skip, size);
+
+	return 0;
+}
+
+#ifdef CONFIG_SPL_GZIP_SUPPORT
+static void *fit_zalloc(void *x, unsigned items, unsigned size)
+{
+	return malloc(items * size);
+}
+
+static void fit_zfree(void *x, void *addr, unsigned nb)
+{
+	free(addr);
+}
+
+/* Inflate gzip data while reading it, a few blocks at a time */
+static int fit_read_gzip(struct fit_reader *r, ulong offset, ulong size,
+			 void *dst, ulong *sizep)
+{
+	const int bl_len = r->info->bl_len;
+	ulong block = offset / bl_len;
+	ulong skip = offset % bl_len;
+	z_stream s;
+	u8 *buf;
+	int ret;
+
+	buf = memalign(ARCH_DMA_MINALIGN, FIT_GZIP_BLOCKS * bl_len);
+	if (!buf)
+		return -ENOMEM;
+
+	memset(&s, 0, sizeof(s));
+	s.zalloc = fit_zalloc;
+	s.zfree = fit_zfree;
+	if (inflateInit2(&s, 16 + MAX_WBITS) != Z_OK) {
+		free(buf);
+		return -ENOMEM;
+	}
+	s.next_out = dst;
+	s.avail_out = CONFIG_SYS_BOOTM_LEN;
+
+	ret = Z_OK;
+	while (size && ret == Z_OK) {
+		ulong count = min(DIV_ROUND_UP(skip + size, bl_len),
+				  (ulong)FIT_GZIP_BLOCKS);
+
+		if (r->info->read(r->info, r->sector + block, count,
+				  buf) != count) {
+			ret = Z_ERRNO;
+			break;
+		}
+		s.next_in = buf + skip;
+		s.avail_in = min(count * bl_len - skip, size);
+		size -= s.avail_in;
+		block += count;
+		skip = 0;
+
+		ret = inflate(&s, Z_NO_FLUSH);
+	}
+	*sizep = s.total_out;
+	inflateEnd(&s);
+	free(buf);
+
+	return ret == Z_STREAM_END ? 0 : -EIO;
+}
+#endif
+
+#ifdef CONFIG_SPL_LZ4_SUPPORT
+static int fit_read_lz4(struct fit_reader *r, ulong offset, ulong size,
+			void *dst, ulong *sizep)
+{
+	size_t dst_size = CONFIG_SYS_BOOTM_LEN;
+	void *buf;
+	int ret;
+
+	/* The frame is decompressed as a whole, so read all of it first */
+	buf = memalign(ARCH_DMA_MINALIGN,
+		       size + 2 * r->info->bl_len + ARCH_DMA_MINALIGN);
+	if (!buf)
+		return -ENOMEM;
+	ret = fit_read_data(r, offset, size, buf);
+	if (!ret)
+		ret = ulz4fn(buf, size, dst, &dst_size) ? -EIO : 0;
+	*sizep = dst_size;
+	free(buf);
+
+	return ret;
+}
+#endif
+
+static int fit_load_image(struct fit_reader *r, struct fit_image *img,
+			  void *dst, ulong *sizep)
+{
+	int ret;
+
+	debug("%s: %s: %lx bytes at %lx to %p\n", __func__, img->name,
+	      img->size, img->data, dst);
+	switch (img->comp) {
+	case IH_COMP_NONE:
+		*sizep = img->size;
+		ret = fit_read_data(r, img->data, img->size, dst);
+		break;
+#ifdef CONFIG_SPL_GZIP_SUPPORT
+	case IH_COMP_GZIP:
+		ret = fit_read_gzip(r, img->data, img->size, dst, sizep);
+		break;
+#endif
+#ifdef CONFIG_SPL_LZ4_SUPPORT
+	case IH_COMP_LZ4:
+		ret = fit_read_lz4(r, img->data, img->size, dst, sizep);
+		break;
+#endif
+	default:
+		ret = -ENOSYS;
+		break;
+	}
+#ifdef CONFIG_SPL_LIBCOMMON_SUPPORT
+	if (ret)
+		printf("spl: cannot load image '%s', err - %d\n", img->name,
+		       ret);
+#endif
+
+	return ret;
+}
+
+int spl_load_simple_fit(struct spl_load_info *info, ulong sector, void *fit)
+{
+	struct fit_image *load[CONFIG_SPL_FIT_MAX_IMAGES];
+	struct fit_image *fw, *img;
+	struct fit_reader r;
+	struct fit_info *fi;
+	const char *name;
+	ulong size, fw_size = 0;
+	int count = 0;
+	int ret, i, j;
+
+	r.info = info;
+	r.sector = sector;
+	r.buf = fit;
+	r.buf_block = 0;
+	r.strings = NULL;
+
+	/* Kept on success, since spl_image.name points into it */
+	fi = calloc(1, sizeof(*fi));
+	if (!fi)
+		return -ENOMEM;
+	ret = fit_walk(&r, fi);
+	free(r.strings);
+	if (ret) {
+#ifdef CONFIG_SPL_LIBCOMMON_SUPPORT
+		printf("spl: bad FIT image, err - %d\n", ret);
+#endif
+		goto out;
+	}
+
+	fw = fit_find_image(fi, fi->firmware);
+	if (!fw || !(fw->flags & FIT_HAS_LOAD)) {
+#ifdef CONFIG_SPL_LIBCOMMON_SUPPORT
+		puts("spl: no firmware image in FIT\n");
+#endif
+		ret = -ENOENT;
+		goto out;
+	}
+	load[count++] = fw;
+	for (name = fi->loadables; name < fi->loadables + fi->loadables_len;
+	     name += strlen(name) + 1) {
+		img = fit_find_image(fi, name);
+		if (img && img != fw && (img->flags & FIT_HAS_LOAD) &&
+		    count < CONFIG_SPL_FIT_MAX_IMAGES)
+			load[count++] = img;
+	}
+
+	/*
+	 * Load in order of address, so that the blocks read beyond the end
+	 * of one image are overwritten by the next
+	 */
+	for (i = 1; i < count; i++) {
+		img = load[i];
+		for (j = i; j > 0 && load[j - 1]->load > img->load; j--)
+			load[j] = load[j - 1];
+		load[j] = img;
+	}
+	for (i = 0; i < count; i++) {
+		ret = fit_load_image(&r, load[i], (void *)load[i]->load,
+				     &size);
+		if (ret)
+			goto out;
+		if (load[i] == fw)
+			fw_size = size;
+	}
+
+	/* Without a load address the device tree goes after the firmware */
+	img = fi->fdt[0] ? fit_find_image(fi, fi->fdt) : NULL;
+	if (img) {
+		if (!(img->flags & FIT_HAS_LOAD))
+			img->load = fw->load + fw_size;
+		ret = fit_load_image(&r, img, (void *)img->load, &size);
+		if (ret)
+			goto out;
+	}
+
+	spl_image.os = IH_OS_U_BOOT;
+	spl_image.name = fw->name;
+	spl_image.load_addr = fw->load;
+	spl_image.entry_point = fw->flags & FIT_HAS_ENTRY ? fw->entry :
+				fw->load;
+	spl_image.size = fw_size;
+
+out:
+	if (ret)
+		free(fi);
+
+	return ret;
+}
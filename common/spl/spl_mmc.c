@@ -16,6 +16,16 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#ifdef CONFIG_SPL_LOAD_FIT
+static ulong h_spl_load_read(struct spl_load_info *load, ulong sector,
+			     ulong count, void *buf)
+{
+	struct mmc *mmc = load->dev;
+
+	return mmc->block_dev.block_read(0, sector, count, buf);
+}
+#endif
+
 static int mmc_load_image_raw_sector(struct mmc *mmc, unsigned long sector)
 {
 	unsigned long count;
@@ -31,6 +41,19 @@ static int mmc_load_image_raw_sector(struct mmc *mmc, unsigned long sector)
 	if (count == 0)
 		goto end;
 
+#ifdef CONFIG_SPL_LOAD_FIT
+	if (image_get_magic(header) == FDT_MAGIC) {
+		struct spl_load_info load;
+
+		debug("Found FIT\n");
+		load.dev = mmc;
+		load.bl_len = mmc->read_bl_len;
+		load.read = h_spl_load_read;
+
+		return spl_load_simple_fit(&load, sector, header);
+	}
+#endif
+
 	if (image_get_magic(header) != IH_MAGIC) {
 		puts("bad magic\n");
 		return -1;
@@ -173,36 +173,229 @@ static void prepare_backup_gpt_header(gpt_header *gpt_h)
 
 #ifdef CONFIG_EFI_PARTITION
 /*
- * Public Functions (include/part.h)
+ * Cache of validated GPTs
+ *
+ * Reading the whole entry array and checking its CRC for each partition
+ * lookup is slow, and looking a partition up by name used to do it once for
+ * each partition before it. So the table of the last few devices used is
+ * kept, along with the partition names and indexes sorted by name and by
+ * UUID.
+ *
+ * Each use reads the primary GPT header again and checks that it has not
+ * changed. The header holds the CRC of the entries, so this catches any
+ * change to a valid primary table, even when written with raw block
+ * commands. gpt_cache_invalidate() drops the table of a device when U-Boot
+ * writes a GPT to it, or when it is rescanned.
  */
+#define GPT_CACHE_DEVICES	4
+
+struct gpt_cache {
+	block_dev_desc_t *dev_desc;	/* Device, NULL if the slot is free */
+	lbaint_t lba;			/* Device size when the GPT was read */
+	unsigned long blksz;		/* Block size when the GPT was read */
+	void *primary;			/* Primary GPT header block as read */
+	gpt_header *head;		/* Header of the GPT in use */
+	gpt_entry *pte;			/* Partition entries */
+	int count;			/* Entries before the first unused one */
+	char (*names)[PARTNAME_SZ + 1];	/* Names of these entries */
+	int *by_name;			/* These entries sorted by name */
+	int *by_uuid;			/* These entries sorted by UUID */
+};
+
+static struct gpt_cache gpt_cache[GPT_CACHE_DEVICES];
+static int gpt_cache_next;
+
+static void gpt_cache_free(struct gpt_cache *c)
+{
+	free(c->primary);
+	free(c->head);
+	free(c->pte);
+	free(c->names);
+	free(c->by_name);
+	free(c->by_uuid);
+	memset(c, 0, sizeof(*c));
+}
 
-void print_part_efi(block_dev_desc_t * dev_desc)
+/* Compare entry @part with a name, or with a UUID if @uuid is not NULL */
+static int gpt_cache_cmp(struct gpt_cache *c, int part, const char *name,
+			 const efi_guid_t *uuid)
+{
+	if (uuid)
+		return memcmp(&c->pte[part].unique_partition_guid, uuid,
+			      sizeof(*uuid));
+
+	return strcmp(c->names[part], name);
+}
+
+/* Insertion sort, so that entries with the same key stay in order */
+static void gpt_cache_sort(struct gpt_cache *c, int *index, int by_uuid)
+{
+	const efi_guid_t *uuid;
+	int i, j;
+
+	for (i = 0; i < c->count; i++) {
+		uuid = by_uuid ? &c->pte[i].unique_partition_guid : NULL;
+		for (j = i; j > 0 &&
+		     gpt_cache_cmp(c, index[j - 1], c->names[i], uuid) > 0; j--)
+			index[j] = index[j - 1];
+		index[j] = i;
+	}
+}
+
+/* Return the first entry with the given name or UUID, or -1 if none */
+static int gpt_cache_search(struct gpt_cache *c, const int *index,
+			    const char *name, const efi_guid_t *uuid)
+{
+	int lo = 0, hi = c->count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (gpt_cache_cmp(c, index[mid], name, uuid) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < c->count && !gpt_cache_cmp(c, index[lo], name, uuid))
+		return index[lo];
+
+	return -1;
+}
+
+/**
+ * gpt_cache_get() - get the validated GPT of a device
+ *
+ * @dev_desc:	Block device
+ * @return the cached GPT, read again first if needed, or NULL if the device
+ * has no valid GPT or there is no memory
+ */
+static struct gpt_cache *gpt_cache_get(block_dev_desc_t *dev_desc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
-	gpt_entry *gpt_pte = NULL;
-	int i = 0;
-	char uuid[37];
-	unsigned char *uuid_bin;
+	struct gpt_cache *c = NULL;
+	int i, n;
+
+	if (dev_desc->block_read(dev_desc->dev, GPT_PRIMARY_PARTITION_TABLE_LBA,
+				 1, gpt_head) != 1)
+		memset(gpt_head, 0, dev_desc->blksz);
+
+	for (i = 0; i < GPT_CACHE_DEVICES; i++) {
+		if (gpt_cache[i].dev_desc == dev_desc) {
+			c = &gpt_cache[i];
+			if (c->lba == dev_desc->lba &&
+			    c->blksz == dev_desc->blksz &&
+			    !memcmp(c->primary, gpt_head, dev_desc->blksz))
+				return c;
+			break;
+		}
+	}
+	if (!c) {
+		c = &gpt_cache[gpt_cache_next];
+		gpt_cache_next = (gpt_cache_next + 1) % GPT_CACHE_DEVICES;
+	}
+	gpt_cache_free(c);
 
-	if (!dev_desc) {
-		printf("%s: Invalid Argument(s)\n", __func__);
-		return;
+	c->primary = malloc(dev_desc->blksz);
+	c->head = memalign(ARCH_DMA_MINALIGN, dev_desc->blksz);
+	if (!c->primary || !c->head) {
+		printf("%s: ERROR: Can't allocate GPT header\n", __func__);
+		goto err;
 	}
+	memcpy(c->primary, gpt_head, dev_desc->blksz);
+
 	/* This function validates AND fills in the GPT header and PTE */
 	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
-			 gpt_head, &gpt_pte) != 1) {
+			 c->head, &c->pte) != 1) {
 		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
+		c->pte = NULL;
 		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
-				 gpt_head, &gpt_pte) != 1) {
+				 c->head, &c->pte) != 1) {
 			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
 			       __func__);
-			return;
+			c->pte = NULL;
+			goto err;
 		} else {
 			printf("%s: ***        Using Backup GPT ***\n",
 			       __func__);
 		}
 	}
 
+	n = le32_to_cpu(c->head->num_partition_entries);
+	while (c->count < n && is_pte_valid(&c->pte[c->count]))
+		c->count++;
+
+	c->names = malloc((c->count + 1) * sizeof(*c->names));
+	c->by_name = malloc((c->count + 1) * sizeof(int));
+	c->by_uuid = malloc((c->count + 1) * sizeof(int));
+	if (!c->names || !c->by_name || !c->by_uuid) {
+		printf("%s: ERROR: Can't allocate GPT index\n", __func__);
+		goto err;
+	}
+	for (i = 0; i < c->count; i++)
+		strcpy(c->names[i], print_efiname(&c->pte[i]));
+	gpt_cache_sort(c, c->by_name, 0);
+	gpt_cache_sort(c, c->by_uuid, 1);
+
+	c->dev_desc = dev_desc;
+	c->lba = dev_desc->lba;
+	c->blksz = dev_desc->blksz;
+
+	return c;
+
+err:
+	gpt_cache_free(c);
+	return NULL;
+}
+
+/* Fill in @info from entry @part (counting from 1) of a cached GPT */
+static void gpt_cache_part_info(block_dev_desc_t *dev_desc,
+				struct gpt_cache *c, int part,
+				disk_partition_t *info)
+{
+	gpt_entry *gpt_pte = c->pte;
+
+	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
+	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
+	/* The ending LBA is inclusive, to calculate size, add 1 to it */
+	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
+		     - info->start;
+	info->blksz = dev_desc->blksz;
+
+	sprintf((char *)info->name, "%s",
+			print_efiname(&gpt_pte[part - 1]));
+	sprintf((char *)info->type, "U-Boot");
+	info->bootable = is_bootable(&gpt_pte[part - 1]);
+#ifdef CONFIG_PARTITION_UUIDS
+	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
+			UUID_STR_FORMAT_GUID);
+#endif
+
+	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
+	      info->start, info->size, info->name);
+}
+
+/*
+ * Public Functions (include/part.h)
+ */
+
+void print_part_efi(block_dev_desc_t * dev_desc)
+{
+	struct gpt_cache *c;
+	gpt_entry *gpt_pte;
+	int i = 0;
+	char uuid[37];
+	unsigned char *uuid_bin;
+
+	if (!dev_desc) {
+		printf("%s: Invalid Argument(s)\n", __func__);
+		return;
+	}
+
+	c = gpt_cache_get(dev_desc);
+	if (!c)
+		return;
+	gpt_pte = c->pte;
+
 	debug("%s: gpt-entry at %p\n", __func__, gpt_pte);
 
 	printf("Part\tStart LBA\tEnd LBA\t\tName\n");
@@ -210,15 +403,12 @@ void print_part_efi(block_dev_desc_t * dev_desc)
 	printf("\tType GUID\n");
 	printf("\tPartition GUID\n");
 
-	for (i = 0; i < le32_to_cpu(gpt_head->num_partition_entries); i++) {
-		/* Stop at the first non valid PTE */
-		if (!is_pte_valid(&gpt_pte[i]))
-			break;
-
+	/* Stop at the first non valid PTE */
+	for (i = 0; i < c->count; i++) {
 		printf("%3d\t0x%08llx\t0x%08llx\t\"%s\"\n", (i + 1),
 			le64_to_cpu(gpt_pte[i].starting_lba),
 			le64_to_cpu(gpt_pte[i].ending_lba),
-			print_efiname(&gpt_pte[i]));
+			c->names[i]);
 		printf("\tattrs:\t0x%016llx\n", gpt_pte[i].attributes.raw);
 		uuid_bin = (unsigned char *)gpt_pte[i].partition_type_guid.b;
 		uuid_bin_to_str(uuid_bin, uuid, UUID_STR_FORMAT_GUID);
@@ -227,17 +417,12 @@ void print_part_efi(block_dev_desc_t * dev_desc)
 		uuid_bin_to_str(uuid_bin, uuid, UUID_STR_FORMAT_GUID);
 		printf("\tguid:\t%s\n", uuid);
 	}
-
-	/* Remember to free pte */
-	free(gpt_pte);
-	return;
 }
 
 int get_partition_info_efi(block_dev_desc_t * dev_desc, int part,
 				disk_partition_t * info)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
-	gpt_entry *gpt_pte = NULL;
+	struct gpt_cache *c;
 
 	/* "part" argument must be at least 1 */
 	if (!dev_desc || !info || part < 1) {
@@ -245,70 +430,82 @@ int get_partition_info_efi(block_dev_desc_t * dev_desc, int part,
 		return -1;
 	}
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
-			gpt_head, &gpt_pte) != 1) {
-		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
-		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
-				 gpt_head, &gpt_pte) != 1) {
-			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
-			       __func__);
-			return -1;
-		} else {
-			printf("%s: ***        Using Backup GPT ***\n",
-			       __func__);
-		}
-	}
+	c = gpt_cache_get(dev_desc);
+	if (!c)
+		return -1;
 
-	if (part > le32_to_cpu(gpt_head->num_partition_entries) ||
-	    !is_pte_valid(&gpt_pte[part - 1])) {
+	if (part > le32_to_cpu(c->head->num_partition_entries) ||
+	    !is_pte_valid(&c->pte[part - 1])) {
 		debug("%s: *** ERROR: Invalid partition number %d ***\n",
 			__func__, part);
-		free(gpt_pte);
 		return -1;
 	}
 
-	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
-	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
-	/* The ending LBA is inclusive, to calculate size, add 1 to it */
-	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
-		     - info->start;
-	info->blksz = dev_desc->blksz;
-
-	sprintf((char *)info->name, "%s",
-			print_efiname(&gpt_pte[part - 1]));
-	sprintf((char *)info->type, "U-Boot");
-	info->bootable = is_bootable(&gpt_pte[part - 1]);
-#ifdef CONFIG_PARTITION_UUIDS
-	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
-			UUID_STR_FORMAT_GUID);
-#endif
+	gpt_cache_part_info(dev_desc, c, part, info);
 
-	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
-	      info->start, info->size, info->name);
-
-	/* Remember to free pte */
-	free(gpt_pte);
 	return 0;
 }
 
 int get_partition_info_efi_by_name(block_dev_desc_t *dev_desc,
 	const char *name, disk_partition_t *info)
 {
-	int ret;
+	struct gpt_cache *c;
+	int part;
+
+	if (!dev_desc || !name || !info) {
+		printf("%s: Invalid Argument(s)\n", __func__);
+		return -1;
+	}
+
+	c = gpt_cache_get(dev_desc);
+	if (!c)
+		return -1;
+
+	part = gpt_cache_search(c, c->by_name, name, NULL);
+	if (part < 0)
+		return -1;
+
+	gpt_cache_part_info(dev_desc, c, part + 1, info);
+
+	return 0;
+}
+
+int get_partition_info_efi_by_uuid(block_dev_desc_t *dev_desc,
+	const char *uuid, disk_partition_t *info)
+{
+	struct gpt_cache *c;
+	efi_guid_t guid;
+	int part;
+
+	if (!dev_desc || !uuid || !info) {
+		printf("%s: Invalid Argument(s)\n", __func__);
+		return -1;
+	}
+
+	if (uuid_str_to_bin((char *)uuid, guid.b, UUID_STR_FORMAT_GUID))
+		return -1;
+
+	c = gpt_cache_get(dev_desc);
+	if (!c)
+		return -1;
+
+	part = gpt_cache_search(c, c->by_uuid, NULL, &guid);
+	if (part < 0)
+		return -1;
+
+	gpt_cache_part_info(dev_desc, c, part + 1, info);
+
+	return 0;
+}
+
+void gpt_cache_invalidate(block_dev_desc_t *dev_desc)
+{
 	int i;
-	for (i = 1; i < GPT_ENTRY_NUMBERS; i++) {
-		ret = get_partition_info_efi(dev_desc, i, info);
-		if (ret != 0) {
-			/* no more entries in table */
-			return -1;
-		}
-		if (strcmp(name, (const char *)info->name) == 0) {
-			/* matched */
-			return 0;
-		}
+
+	for (i = 0; i < GPT_CACHE_DEVICES; i++) {
+		if (gpt_cache[i].dev_desc == dev_desc)
+			gpt_cache_free(&gpt_cache[i]);
 	}
-	return -2;
 }
 
 int test_part_efi(block_dev_desc_t * dev_desc)
@@ -362,6 +559,8 @@ int write_gpt_table(block_dev_desc_t *dev_desc,
 					   * sizeof(gpt_entry)), dev_desc);
 	u32 calc_crc32;
 
+	gpt_cache_invalidate(dev_desc);
+
 	debug("max lba: %x\n", (u32) dev_desc->lba);
 	/* Setup the Protective MBR */
 	if (set_protective_mbr(dev_desc) < 0)
@@ -581,6 +780,8 @@ int write_mbr_and_gpt_partitions(block_dev_desc_t *dev_desc, void *buf)
 	if (is_valid_gpt_buf(dev_desc, buf))
 		return -1;
 
+	gpt_cache_invalidate(dev_desc);
+
 	/* determine start of GPT Header in the buffer */
 	gpt_h = buf + (GPT_PRIMARY_PARTITION_TABLE_LBA *
 		       dev_desc->blksz);
@@ -14,6 +14,7 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <div64.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 
@@ -75,11 +76,22 @@ int dfu_init_env_entities(char *interface, char *devstr)
 	return 0;
 }
 
+#ifdef CONFIG_DFU_DOUBLE_BUF
+#define DFU_BUF_COUNT	2
+/* Entity whose previous buffer is still being written to the medium */
+static struct dfu_entity *dfu_pending;
+#else
+#define DFU_BUF_COUNT	1
+#endif
+
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size;
 
 unsigned char *dfu_free_buf(void)
 {
+#ifdef CONFIG_DFU_DOUBLE_BUF
+	dfu_pending = NULL;
+#endif
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -107,10 +119,11 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+			   DFU_BUF_COUNT * dfu_buf_size);
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
-		       __func__, dfu_buf_size);
+		       __func__, DFU_BUF_COUNT * dfu_buf_size);
 
 	return dfu_buf;
 }
@@ -132,35 +145,145 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
+static int dfu_write_chunk(struct dfu_entity *dfu, void *buf, long *len)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   buf, *len, 0);
+
+	ret = dfu->write_medium(dfu, dfu->offset, buf, len);
+	if (ret)
+		debug("%s: Write error!\n", __func__);
+
+	/* update offset */
+	dfu->offset += *len;
+	dfu->write_time += get_timer(start);
+
+	return ret;
+}
+
+#ifdef CONFIG_DFU_DOUBLE_BUF
+/*
+ * Write the next piece of the buffer queued by dfu_write_buffer_queue().
+ * Media which set write_step are written in pieces of that size, so that
+ * USB requests are handled in between.
+ */
+static int dfu_write_pending_step(struct dfu_entity *dfu)
+{
+	long w_size = dfu->w_left;
+	int ret;
+
+	if (dfu->write_step && w_size > dfu->write_step)
+		w_size = dfu->write_step;
+
+	ret = dfu_write_chunk(dfu, dfu->w_buf, &w_size);
+	if (ret || w_size >= dfu->w_left) {
+		dfu->w_left = 0;
+		puts("#");
+	} else {
+		dfu->w_buf += w_size;
+		dfu->w_left -= w_size;
+	}
+
+	return ret;
+}
+
+static int dfu_write_pending_wait(struct dfu_entity *dfu)
+{
+	while (dfu->w_left && !dfu->w_err)
+		dfu->w_err = dfu_write_pending_step(dfu);
+
+	return dfu->w_err;
+}
+
+void dfu_write_poll(void)
+{
+	struct dfu_entity *dfu = dfu_pending;
+
+	if (dfu && dfu->w_left && !dfu->w_err)
+		dfu->w_err = dfu_write_pending_step(dfu);
+}
+
+/*
+ * Hand the full buffer over to dfu_write_poll() and continue receiving
+ * in the other one.
+ */
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
+{
+	int ret;
+
+	ret = dfu_write_pending_wait(dfu);
+	if (ret)
+		return ret;
+
+	dfu->w_buf = dfu->i_buf_start;
+	dfu->w_left = dfu->i_buf - dfu->i_buf_start;
+	dfu_pending = dfu;
+
+	if (dfu->i_buf_start == dfu_buf)
+		dfu->i_buf_start = dfu_buf + dfu_buf_size;
+	else
+		dfu->i_buf_start = dfu_buf;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+
+	return 0;
+}
+#endif
+
 static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 {
 	long w_size;
 	int ret;
 
+#ifdef CONFIG_DFU_DOUBLE_BUF
+	ret = dfu_write_pending_wait(dfu);
+	if (ret)
+		return ret;
+#endif
+
 	/* flush size? */
 	w_size = dfu->i_buf - dfu->i_buf_start;
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
-
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
+	ret = dfu_write_chunk(dfu, dfu->i_buf_start, &w_size);
 
 	/* point back */
 	dfu->i_buf = dfu->i_buf_start;
 
-	/* update offset */
-	dfu->offset += w_size;
-
 	puts("#");
 
 	return ret;
 }
 
+/*
+ * Write out a full buffer. Callers like thor which receive straight into
+ * the DFU buffer need it to be written before they can reuse it.
+ */
+static int dfu_write_buffer_full(struct dfu_entity *dfu, void *buf)
+{
+#ifdef CONFIG_DFU_DOUBLE_BUF
+	if ((u8 *)buf < dfu_buf ||
+	    (u8 *)buf >= dfu_buf + DFU_BUF_COUNT * dfu_buf_size)
+		return dfu_write_buffer_queue(dfu);
+#endif
+	return dfu_write_buffer_drain(dfu);
+}
+
+static void dfu_write_stats(struct dfu_entity *dfu)
+{
+	ulong time = max(get_timer(dfu->start_time), 1UL);
+
+	printf("\nDFU: %llu bytes in %lu ms (%lu KiB/s), medium write %lu ms\n",
+	       dfu->offset, time,
+	       (ulong)lldiv(dfu->offset * 1000 / 1024, time),
+	       dfu->write_time);
+}
+
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
@@ -171,6 +294,11 @@ void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 	dfu->i_buf_end = dfu_buf;
 	dfu->i_buf = dfu->i_buf_start;
 	dfu->inited = 0;
+#ifdef CONFIG_DFU_DOUBLE_BUF
+	dfu->w_left = 0;
+	dfu->w_err = 0;
+	dfu_pending = NULL;
+#endif
 }
 
 int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
@@ -181,13 +309,20 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (ret)
 		return ret;
 
-	if (dfu->flush_medium)
+	if (dfu->flush_medium) {
+		ulong start = get_timer(0);
+
 		ret = dfu->flush_medium(dfu);
+		dfu->write_time += get_timer(start);
+	}
 
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
 
+	if (dfu->inited)
+		dfu_write_stats(dfu);
+
 	dfu_write_transaction_cleanup(dfu);
 
 	return ret;
@@ -212,6 +347,8 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 			return -ENOMEM;
 		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
 		dfu->i_buf = dfu->i_buf_start;
+		dfu->start_time = get_timer(0);
+		dfu->write_time = 0;
 
 		dfu->inited = 1;
 	}
@@ -241,7 +378,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_full(dfu, buf);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -261,7 +398,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_full(dfu, buf);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -400,6 +537,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_step = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
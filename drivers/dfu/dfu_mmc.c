@@ -390,6 +390,11 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 		return -ENODEV;
 	}
 
+	/* Raw data can be written back in pieces between USB requests */
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_step = ALIGN(CONFIG_SYS_DFU_WRITE_STEP,
+					dfu->data.mmc.lba_blk_size);
+
 	/* if it's NOT a raw write */
 	if (strcmp(entity_type, "raw")) {
 		dfu->data.mmc.dev = second_arg;
@@ -174,6 +174,98 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 	return mmc_send_cmd(mmc, &cmd, NULL);
 }
 
+/* Tuning blocks sent by the card for CMD19 (4-bit) and CMD21 (8-bit) */
+const u8 tuning_blk_pattern_4bit[64] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+const u8 tuning_blk_pattern_8bit[128] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+/*
+ * Read the tuning block once and check it, for use by a host's
+ * execute_tuning() at each sampling point it tries
+ */
+int mmc_send_tuning(struct mmc *mmc, uint opcode)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, buf, sizeof(tuning_blk_pattern_8bit));
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	const u8 *pattern;
+	int size, err;
+
+	if (mmc->bus_width == 8) {
+		pattern = tuning_blk_pattern_8bit;
+		size = sizeof(tuning_blk_pattern_8bit);
+	} else {
+		pattern = tuning_blk_pattern_4bit;
+		size = sizeof(tuning_blk_pattern_4bit);
+	}
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	data.dest = (char *)buf;
+	data.blocks = 1;
+	data.blocksize = size;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	return memcmp(buf, pattern, size) ? -EIO : 0;
+}
+
+static int mmc_execute_tuning(struct mmc *mmc)
+{
+	uint opcode = IS_SD(mmc) ? MMC_CMD_SEND_TUNING_BLOCK :
+		MMC_CMD_SEND_TUNING_BLOCK_HS200;
+
+	return mmc->cfg->ops->execute_tuning(mmc, opcode);
+}
+
+/* The host's modes, less those which need callbacks it does not provide */
+static uint mmc_host_caps(struct mmc *mmc)
+{
+	uint caps = mmc->cfg->host_caps;
+
+	if (!mmc->cfg->ops->set_signal_voltage)
+		caps &= ~(MMC_MODE_UHS_SDR50 | MMC_MODE_UHS_SDR104 |
+			  MMC_MODE_HS200);
+	if (!mmc->cfg->ops->execute_tuning)
+		caps &= ~(MMC_MODE_UHS_SDR104 | MMC_MODE_HS200);
+	/* HS400 is entered from HS200, after tuning there */
+	if (!(caps & MMC_MODE_HS200))
+		caps &= ~MMC_MODE_HS400;
+
+	return caps;
+}
+
 struct mmc *find_mmc_device(int dev_num)
 {
 	struct mmc *m;
@@ -294,6 +386,57 @@ static int mmc_go_idle(struct mmc *mmc)
 	return 0;
 }
 
+static int mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	int err;
+
+	err = mmc->cfg->ops->set_signal_voltage(mmc, voltage);
+	if (err)
+		return err;
+	mmc->signal_voltage = voltage;
+
+	return 0;
+}
+
+/*
+ * An SD card only goes back to 3.3V signalling when its power is cycled,
+ * and keeps 1.8V over CMD0. Unless the host can cycle the power, stay at
+ * 1.8V: the card then offers the UHS-I modes again without CMD11.
+ */
+static int mmc_reset_signal_voltage(struct mmc *mmc)
+{
+	int err;
+
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_330 ||
+	    !mmc->cfg->ops->power_cycle)
+		return 0;
+
+	err = mmc->cfg->ops->power_cycle(mmc);
+	if (err == -ENOSYS)
+		return 0;
+	if (err)
+		return err;
+
+	return mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_330);
+}
+
+/* Move an SD card which accepted OCR_S18R to 1.8V signalling */
+static int sd_switch_voltage(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
+
+	cmd.cmdidx = SD_CMD_SWITCH_UHS18V;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		return err;
+
+	return mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+}
+
 static int sd_send_op_cond(struct mmc *mmc)
 {
 	int timeout = 1000;
@@ -326,6 +469,12 @@ static int sd_send_op_cond(struct mmc *mmc)
 		if (mmc->version == SD_VERSION_2)
 			cmd.cmdarg |= OCR_HCS;
 
+		/* Ask for 1.8V signalling if we can use UHS-I modes */
+		if (mmc->version == SD_VERSION_2 &&
+		    (mmc_host_caps(mmc) &
+		     (MMC_MODE_UHS_SDR50 | MMC_MODE_UHS_SDR104)))
+			cmd.cmdarg |= OCR_S18R;
+
 		err = mmc_send_cmd(mmc, &cmd, NULL);
 
 		if (err)
@@ -359,6 +508,10 @@ static int sd_send_op_cond(struct mmc *mmc)
 	mmc->high_capacity = ((mmc->ocr & OCR_HCS) == OCR_HCS);
 	mmc->rca = 0;
 
+	if ((mmc->ocr & (OCR_HCS | OCR_S18R)) == (OCR_HCS | OCR_S18R) &&
+	    mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_330)
+		return sd_switch_voltage(mmc);
+
 	return 0;
 }
 
@@ -470,7 +623,8 @@ static int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 }
 
 
-static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+static int __mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value,
+			bool send_status)
 {
 	struct mmc_cmd cmd;
 	int timeout = 1000;
@@ -485,17 +639,22 @@ static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 	ret = mmc_send_cmd(mmc, &cmd, NULL);
 
 	/* Waiting for the ready status */
-	if (!ret)
+	if (!ret && send_status)
 		ret = mmc_send_status(mmc, timeout);
 
 	return ret;
 
 }
 
+static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+{
+	return __mmc_switch(mmc, set, index, value, true);
+}
+
 static int mmc_change_freq(struct mmc *mmc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(u8, ext_csd, MMC_MAX_BLOCK_LEN);
-	char cardtype;
+	u8 cardtype;
 	int err;
 
 	mmc->card_caps = 0;
@@ -507,14 +666,15 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (mmc->version < MMC_VERSION_4)
 		return 0;
 
-	mmc->card_caps |= MMC_MODE_4BIT | MMC_MODE_8BIT;
+	/* All version 4 cards accept SET_BLOCK_COUNT for writes */
+	mmc->card_caps |= MMC_MODE_4BIT | MMC_MODE_8BIT | MMC_MODE_CMD23;
 
 	err = mmc_send_ext_csd(mmc, ext_csd);
 
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE];
 
 	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
 
@@ -540,6 +700,12 @@ static int mmc_change_freq(struct mmc *mmc)
 		mmc->card_caps |= MMC_MODE_HS;
 	}
 
+	/* Only 1.8V I/O is supported for the 200MHz modes */
+	if (cardtype & EXT_CSD_CARD_TYPE_HS200_1_8V)
+		mmc->card_caps |= MMC_MODE_HS200;
+	if (cardtype & EXT_CSD_CARD_TYPE_HS400_1_8V)
+		mmc->card_caps |= MMC_MODE_HS400;
+
 	return 0;
 }
 
@@ -917,6 +1083,9 @@ retry_scr:
 
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
+	if (mmc->scr[0] & SD_CMD23_SUPPORT)
+		mmc->card_caps |= MMC_MODE_CMD23;
+	mmc->erase_zeroes = !(mmc->scr[0] & SD_DATA_STAT_AFTER_ERASE);
 
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
@@ -935,6 +1104,36 @@ retry_scr:
 			break;
 	}
 
+	/* A card which switched to 1.8V offers the UHS-I modes as well */
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180) {
+		uint support = __be32_to_cpu(switch_status[3]);
+		uint caps = mmc_host_caps(mmc);
+		int mode = 0;
+
+		if ((caps & MMC_MODE_UHS_SDR104) &&
+		    (support & SD_SDR104_SUPPORTED))
+			mode = SD_MODE_UHS_SDR104;
+		else if ((caps & MMC_MODE_UHS_SDR50) &&
+			 (support & SD_SDR50_SUPPORTED))
+			mode = SD_MODE_UHS_SDR50;
+
+		if (mode) {
+			err = sd_switch(mmc, SD_SWITCH_SWITCH, 0, mode,
+					(u8 *)switch_status);
+			if (err)
+				return err;
+
+			if (((__be32_to_cpu(switch_status[4]) >> 24) & 0xf) ==
+			    mode) {
+				mmc->card_caps |= MMC_MODE_HS;
+				mmc->card_caps |= mode == SD_MODE_UHS_SDR104 ?
+					MMC_MODE_UHS_SDR104 :
+					MMC_MODE_UHS_SDR50;
+				return 0;
+			}
+		}
+	}
+
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -1017,6 +1216,82 @@ static void mmc_set_bus_width(struct mmc *mmc, uint width)
 	mmc_set_ios(mmc);
 }
 
+/*
+ * Change HS_TIMING and move the host to the matching timing and clock
+ * before asking the card for its status, as JEDEC requires
+ */
+static int mmc_switch_timing(struct mmc *mmc, u8 value, uint timing,
+			     uint clock)
+{
+	int err;
+
+	err = __mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			   value, false);
+	if (err)
+		return err;
+
+	mmc->timing = timing;
+	mmc->tran_speed = clock;
+	mmc_set_clock(mmc, clock);
+
+	return mmc_send_status(mmc, 1000);
+}
+
+/* HS400 is reached from tuned HS200 through HS and an 8-bit DDR bus */
+static int mmc_select_hs400(struct mmc *mmc)
+{
+	int err;
+
+	err = mmc_switch_timing(mmc, EXT_CSD_TIMING_HS, MMC_TIMING_HS,
+				52000000);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 EXT_CSD_DDR_BUS_WIDTH_8);
+	if (err)
+		return err;
+	mmc->ddr_mode = 1;
+
+	return mmc_switch_timing(mmc, EXT_CSD_TIMING_HS400,
+				 MMC_TIMING_MMC_HS400, 200000000);
+}
+
+/* Move a card on a 4 or 8-bit SDR bus to HS200, or HS400 if possible */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	int err;
+
+	/* Only 1.8V I/O is supported for HS200 */
+	if (mmc->signal_voltage != MMC_SIGNAL_VOLTAGE_180) {
+		err = mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+		if (err) {
+			/* Carry on at 52MHz rather than fail */
+			debug("%s: no 1.8V I/O: %d\n", __func__, err);
+			return mmc_set_signal_voltage(mmc,
+						      MMC_SIGNAL_VOLTAGE_330);
+		}
+	}
+
+	err = mmc_switch_timing(mmc, EXT_CSD_TIMING_HS200,
+				MMC_TIMING_MMC_HS200, 200000000);
+	if (err)
+		return err;
+
+	err = mmc_execute_tuning(mmc);
+	if (err) {
+		/* Carry on at 52MHz rather than fail */
+		debug("%s: tuning failed: %d\n", __func__, err);
+		return mmc_switch_timing(mmc, EXT_CSD_TIMING_HS, MMC_TIMING_HS,
+					 52000000);
+	}
+
+	if ((mmc->card_caps & MMC_MODE_HS400) && mmc->bus_width == 8)
+		return mmc_select_hs400(mmc);
+
+	return 0;
+}
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -1176,6 +1451,8 @@ static int mmc_startup(struct mmc *mmc)
 	 * For SD, its erase group is always one sector
 	 */
 	mmc->erase_grp_size = 1;
+	mmc->can_trim = 0;
+	mmc->erase_zeroes = 0;
 	mmc->part_config = MMCPART_NOAVAILABLE;
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
@@ -1322,6 +1599,11 @@ static int mmc_startup(struct mmc *mmc)
 			* ext_csd[EXT_CSD_HC_WP_GRP_SIZE];
 
 		mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
+
+		/* TRIM erases single write blocks, not whole groups */
+		mmc->can_trim = !!(ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] &
+				   EXT_CSD_SEC_GB_CL_EN);
+		mmc->erase_zeroes = !ext_csd[EXT_CSD_ERASED_MEM_CONT];
 	}
 
 	err = mmc_set_capacity(mmc, mmc->part_num);
@@ -1337,7 +1619,7 @@ static int mmc_startup(struct mmc *mmc)
 		return err;
 
 	/* Restrict card's capabilities by what the host can do */
-	mmc->card_caps &= mmc->cfg->host_caps;
+	mmc->card_caps &= mmc_host_caps(mmc);
 
 	if (IS_SD(mmc)) {
 		if (mmc->card_caps & MMC_MODE_4BIT) {
@@ -1359,10 +1641,18 @@ static int mmc_startup(struct mmc *mmc)
 			mmc_set_bus_width(mmc, 4);
 		}
 
-		if (mmc->card_caps & MMC_MODE_HS)
+		if (mmc->card_caps & MMC_MODE_UHS_SDR104) {
+			mmc->timing = MMC_TIMING_UHS_SDR104;
+			mmc->tran_speed = 208000000;
+		} else if (mmc->card_caps & MMC_MODE_UHS_SDR50) {
+			mmc->timing = MMC_TIMING_UHS_SDR50;
+			mmc->tran_speed = 100000000;
+		} else if (mmc->card_caps & MMC_MODE_HS) {
+			mmc->timing = MMC_TIMING_HS;
 			mmc->tran_speed = 50000000;
-		else
+		} else {
 			mmc->tran_speed = 25000000;
+		}
 	} else if (mmc->version >= MMC_VERSION_4) {
 		/* Only version 4 of MMC supports wider bus widths */
 		int idx;
@@ -1414,6 +1704,11 @@ static int mmc_startup(struct mmc *mmc)
 			if ((mmc->card_caps & caps) != caps)
 				continue;
 
+			/* HS200 is tuned on a single data rate bus */
+			if ((mmc->card_caps & MMC_MODE_HS200) &&
+			    (caps & MMC_MODE_DDR_52MHz))
+				continue;
+
 			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
 					EXT_CSD_BUS_WIDTH, extw);
 
@@ -1448,15 +1743,31 @@ static int mmc_startup(struct mmc *mmc)
 			return err;
 
 		if (mmc->card_caps & MMC_MODE_HS) {
+			mmc->timing = MMC_TIMING_HS;
 			if (mmc->card_caps & MMC_MODE_HS_52MHz)
 				mmc->tran_speed = 52000000;
 			else
 				mmc->tran_speed = 26000000;
 		}
+
+		if ((mmc->card_caps & MMC_MODE_HS200) && mmc->bus_width > 1) {
+			err = mmc_select_hs200(mmc);
+			if (err)
+				return err;
+		}
 	}
 
 	mmc_set_clock(mmc, mmc->tran_speed);
 
+	/* SDR104 must be tuned, SDR50 is tuned if the host can */
+	if ((mmc->timing == MMC_TIMING_UHS_SDR104 ||
+	     mmc->timing == MMC_TIMING_UHS_SDR50) &&
+	    mmc->cfg->ops->execute_tuning) {
+		err = mmc_execute_tuning(mmc);
+		if (err)
+			return err;
+	}
+
 	/* Fix the block length for DDR mode */
 	if (mmc->ddr_mode) {
 		mmc->read_bl_len = MMC_MAX_BLOCK_LEN;
@@ -1564,7 +1875,7 @@ struct mmc *mmc_create(const struct mmc_config *cfg, void *priv)
 
 void mmc_destroy(struct mmc *mmc)
 {
-	/* only freeing memory for now */
+	list_del(&mmc->link);
 	free(mmc);
 }
 
@@ -1612,6 +1923,10 @@ int mmc_start_init(struct mmc *mmc)
 		return err;
 
 	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_LEGACY;
+	err = mmc_reset_signal_voltage(mmc);
+	if (err)
+		return err;
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -14,7 +14,11 @@
 #include <linux/math64.h>
 #include "mmc_private.h"
 
-static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
+/* Erase timeout for one group, in ms */
+#define MMC_ERASE_TIMEOUT	1000
+
+static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt,
+			 u32 arg)
 {
 	struct mmc_cmd cmd;
 	ulong end;
@@ -51,7 +55,7 @@ static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
 		goto err_out;
 
 	cmd.cmdidx = MMC_CMD_ERASE;
-	cmd.cmdarg = SECURE_ERASE;
+	cmd.cmdarg = arg;
 	cmd.resp_type = MMC_RSP_R1b;
 
 	err = mmc_send_cmd(mmc, &cmd, NULL);
@@ -65,13 +69,33 @@ err_out:
 	return err;
 }
 
+/* Erase a range one group at a time, returning the number of blocks done */
+static lbaint_t mmc_erase_range(struct mmc *mmc, lbaint_t start,
+				lbaint_t blkcnt, u32 arg)
+{
+	lbaint_t blk = 0, blk_r = 0;
+
+	while (blk < blkcnt) {
+		blk_r = ((blkcnt - blk) > mmc->erase_grp_size) ?
+			mmc->erase_grp_size : (blkcnt - blk);
+		if (mmc_erase_t(mmc, start + blk, blk_r, arg))
+			break;
+
+		blk += blk_r;
+
+		/* Waiting for the ready status */
+		if (mmc_send_status(mmc, MMC_ERASE_TIMEOUT))
+			return 0;
+	}
+
+	return blk;
+}
+
 unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 {
-	int err = 0;
-	u32 start_rem, blkcnt_rem;
+	u32 start_rem, blkcnt_rem, end_rem;
 	struct mmc *mmc = find_mmc_device(dev_num);
-	lbaint_t blk = 0, blk_r = 0;
-	int timeout = 1000;
+	lbaint_t head = 0, tail = 0, blk;
 
 	if (!mmc)
 		return -1;
@@ -81,31 +105,43 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	 * unaligned.  We discard the whole numbers and only care about the
 	 * remainder.
 	 */
-	err = div_u64_rem(start, mmc->erase_grp_size, &start_rem);
-	err = div_u64_rem(blkcnt, mmc->erase_grp_size, &blkcnt_rem);
-	if (start_rem || blkcnt_rem)
+	div_u64_rem(start, mmc->erase_grp_size, &start_rem);
+	div_u64_rem(blkcnt, mmc->erase_grp_size, &blkcnt_rem);
+	div_u64_rem(start + blkcnt, mmc->erase_grp_size, &end_rem);
+	if (mmc->can_trim) {
+		/* Trim the partial groups at each end instead of rounding */
+		if (start_rem)
+			head = min(blkcnt, (lbaint_t)(mmc->erase_grp_size -
+						      start_rem));
+		tail = min(blkcnt - head, (lbaint_t)end_rem);
+	} else if (start_rem || blkcnt_rem) {
 		printf("\n\nCaution! Your devices Erase group is 0x%x\n"
 		       "The erase range would be change to "
 		       "0x" LBAF "~0x" LBAF "\n\n",
 		       mmc->erase_grp_size, start & ~(mmc->erase_grp_size - 1),
 		       ((start + blkcnt + mmc->erase_grp_size)
 		       & ~(mmc->erase_grp_size - 1)) - 1);
+	}
 
-	while (blk < blkcnt) {
-		blk_r = ((blkcnt - blk) > mmc->erase_grp_size) ?
-			mmc->erase_grp_size : (blkcnt - blk);
-		err = mmc_erase_t(mmc, start + blk, blk_r);
-		if (err)
-			break;
+	blk = mmc_erase_range(mmc, start, head, MMC_TRIM_ARG);
+	if (blk == head)
+		blk += mmc_erase_range(mmc, start + blk, blkcnt - head - tail,
+				       MMC_ERASE_ARG);
+	if (blk == blkcnt - tail)
+		blk += mmc_erase_range(mmc, start + blk, tail, MMC_TRIM_ARG);
 
-		blk += blk_r;
+	return blk;
+}
 
-		/* Waiting for the ready status */
-		if (mmc_send_status(mmc, timeout))
-			return 0;
-	}
+static int mmc_set_block_count(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
 
-	return blk;
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blkcnt;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
 }
 
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
@@ -114,6 +150,7 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int timeout = 1000;
+	int sbc = 0;
 
 	if ((start + blkcnt) > mmc->block_dev.lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
@@ -128,6 +165,19 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	else
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
 
+	/*
+	 * Telling the card the length up front lets it plan the write and
+	 * saves the STOP_TRANSMISSION at the end.
+	 */
+	if (blkcnt > 1 && blkcnt <= 0xffff &&
+	    (mmc->card_caps & MMC_MODE_CMD23)) {
+		if (mmc_set_block_count(mmc, blkcnt)) {
+			printf("mmc fail to set block count\n");
+			return 0;
+		}
+		sbc = 1;
+	}
+
 	if (mmc->high_capacity)
 		cmd.cmdarg = start;
 	else
@@ -148,7 +198,7 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	/* SPI multiblock writes terminate using a special
 	 * token, not a STOP_TRANSMISSION request.
 	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
+	if (!mmc_host_is_spi(mmc) && blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -165,9 +215,70 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	return blkcnt;
 }
 
+#ifdef CONFIG_MMC_ERASE_ZERO
+/* Smallest run of zeroes which is erased instead of written, in blocks */
+#define MMC_ERASE_ZERO_MIN	8192
+
+static int mmc_is_zero(const void *src, lbaint_t blkcnt, uint bl_len)
+{
+	return !memchr_inv(src, 0, blkcnt * bl_len);
+}
+#endif
+
+/*
+ * Work out the next piece of a write starting at @start. A piece which is
+ * followed by more ends on an erase group boundary, so that the card sees
+ * whole groups. With CONFIG_MMC_ERASE_ZERO, aligned runs of zeroes are
+ * split off and *erase is set for them, since erasing is much quicker than
+ * writing when the card reads erased blocks back as zeroes.
+ */
+static lbaint_t mmc_write_piece(struct mmc *mmc, lbaint_t start,
+				lbaint_t blkcnt, const void *src, int *erase)
+{
+	lbaint_t cur = min(blkcnt, (lbaint_t)mmc->cfg->b_max);
+	u32 rem;
+#ifdef CONFIG_MMC_ERASE_ZERO
+	uint bl_len = mmc->write_bl_len;
+	lbaint_t unit, off, len = 0;
+#endif
+
+	*erase = 0;
+	if (cur < blkcnt && mmc->erase_grp_size <= cur) {
+		div_u64_rem(start + cur, mmc->erase_grp_size, &rem);
+		cur -= rem;
+	}
+
+#ifdef CONFIG_MMC_ERASE_ZERO
+	if (!mmc->erase_zeroes || ((ulong)src & (sizeof(ulong) - 1)))
+		return cur;
+
+	unit = DIV_ROUND_UP(MMC_ERASE_ZERO_MIN, mmc->erase_grp_size) *
+		mmc->erase_grp_size;
+	div_u64_rem(start, unit, &rem);
+	if (!rem) {
+		while (len + unit <= blkcnt &&
+		       mmc_is_zero(src + len * bl_len, unit, bl_len))
+			len += unit;
+		if (len) {
+			*erase = 1;
+			return len;
+		}
+	}
+
+	/* Stop the write where the next run of zeroes starts */
+	for (off = unit - rem; off < cur && off + unit <= blkcnt; off += unit) {
+		if (mmc_is_zero(src + off * bl_len, unit, bl_len))
+			return off;
+	}
+#endif
+
+	return cur;
+}
+
 ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
+	int erase;
 
 	struct mmc *mmc = find_mmc_device(dev_num);
 	if (!mmc)
@@ -177,10 +288,14 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 		return 0;
 
 	do {
-		cur = (blocks_todo > mmc->cfg->b_max) ?
-			mmc->cfg->b_max : blocks_todo;
-		if (mmc_write_blocks(mmc, start, cur, src) != cur)
+		cur = mmc_write_piece(mmc, start, blocks_todo, src, &erase);
+		if (erase) {
+			if (mmc_erase_range(mmc, start, cur, MMC_ERASE_ARG) !=
+			    cur)
+				return 0;
+		} else if (mmc_write_blocks(mmc, start, cur, src) != cur) {
 			return 0;
+		}
 		blocks_todo -= cur;
 		start += cur;
 		src += cur * mmc->write_bl_len;
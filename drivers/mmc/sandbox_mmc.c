@@ -8,11 +8,641 @@
 #include <common.h>
 #include <dm.h>
 #include <errno.h>
+#include <fdtdec.h>
 #include <mmc.h>
+#include <os.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/*
+ * The host has an eMMC, or an SD card with "sandbox,sd-card", held in
+ * memory. Enough of the card is emulated to run mmc_init() through the
+ * 1.8V switch of UHS-I and the tuning of SDR104, HS200 and HS400: data
+ * transfers fail with a CRC error unless the host's bus width, clock,
+ * signalling voltage and sampling point suit what the card was set to.
+ * An SD card keeps 1.8V signalling until its power is cycled, while the
+ * eMMC's I/O voltage follows the host's.
+ */
+
+#define SANDBOX_MMC_SIZE	(8 << 20)
+#define SANDBOX_MMC_BLOCKS	(SANDBOX_MMC_SIZE / MMC_MAX_BLOCK_LEN)
+#define SANDBOX_SD_RCA		0x1234
+
+/* Card states, as reported in the R1 status */
+enum {
+	CARD_IDLE,
+	CARD_READY,
+	CARD_IDENT,
+	CARD_STBY,
+	CARD_TRAN,
+};
+
+struct sandbox_mmc_card {
+	bool sd;
+	uint state;
+	uint rca;
+	bool app_cmd;		/* the previous command was CMD55 */
+	bool s18a;		/* 1.8V signalling was accepted by ACMD41 */
+	bool switch_error;	/* the last CMD6 was refused */
+	uint voltage;		/* MMC_SIGNAL_VOLTAGE_... */
+	uint timing;		/* MMC_TIMING_... */
+	uint bus_width;
+	bool ddr;
+	ulong erase_start;
+	ulong erase_end;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	u8 *data;
+};
+
+struct sandbox_mmc_priv {
+	struct mmc_config cfg;
+	struct mmc *mmc;
+	struct sandbox_mmc_card card;
+	/* Bus set-up of the host, as last set by the core */
+	uint bus_width;
+	uint clock;
+	bool ddr;
+	uint voltage;
+	uint phase;		/* sampling point, below SANDBOX_MMC_PHASES */
+	bool no_power_switch;	/* power_cycle() is not possible */
+};
+
+static void sandbox_mmc_go_idle(struct sandbox_mmc_card *card)
+{
+	card->state = CARD_IDLE;
+	card->app_cmd = false;
+	card->timing = MMC_TIMING_LEGACY;
+	card->bus_width = 1;
+	card->ddr = false;
+	card->ext_csd[EXT_CSD_HS_TIMING] = EXT_CSD_TIMING_LEGACY;
+	card->ext_csd[EXT_CSD_BUS_WIDTH] = EXT_CSD_BUS_WIDTH_1;
+}
+
+/* Power the card up; an SD card only goes back to 3.3V this way */
+static void sandbox_mmc_power_up(struct sandbox_mmc_card *card)
+{
+	sandbox_mmc_go_idle(card);
+	card->s18a = false;
+	card->voltage = MMC_SIGNAL_VOLTAGE_330;
+}
+
+static void sandbox_mmc_init_ext_csd(struct sandbox_mmc_card *card)
+{
+	u8 *ext_csd = card->ext_csd;
+
+	ext_csd[EXT_CSD_REV] = 7;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_1_8V |
+		EXT_CSD_CARD_TYPE_HS200_1_8V | EXT_CSD_CARD_TYPE_HS400_1_8V;
+	put_unaligned_le32(SANDBOX_MMC_BLOCKS, &ext_csd[EXT_CSD_SEC_CNT]);
+	ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_HC_WP_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] = EXT_CSD_SEC_GB_CL_EN;
+}
+
+static void sandbox_mmc_csd(struct sandbox_mmc_card *card, uint *csd)
+{
+	uint csize;
+
+	if (card->sd) {
+		/* Version 2.0, in units of 512KiB, 25MHz */
+		csize = SANDBOX_MMC_SIZE / (512 << 10) - 1;
+		csd[0] = 1 << 30 | 0x32;
+		csd[1] = 9 << 16 | csize >> 16;
+		csd[2] = (csize & 0xffff) << 16;
+		csd[3] = 0;
+	} else {
+		/* Spec version 4, C_SIZE_MULT 7, 1024-block erase groups */
+		csize = SANDBOX_MMC_BLOCKS / 512 - 1;
+		csd[0] = 3 << 30 | 4 << 26 | 0x32;
+		csd[1] = 9 << 16 | csize >> 2;
+		csd[2] = (csize & 3) << 30 | 7 << 15 | 31 << 10 | 31 << 5;
+		csd[3] = 9 << 22;
+	}
+}
+
+/* The R1 status, which also reports a refused CMD6 once */
+static uint sandbox_mmc_status(struct sandbox_mmc_card *card)
+{
+	uint status = card->state << 9 | MMC_STATUS_RDY_FOR_DATA;
+
+	if (card->switch_error)
+		status |= MMC_STATUS_SWITCH_ERROR;
+	card->switch_error = false;
+
+	return status;
+}
+
+/* Apply an EXT_CSD write, refusing what JEDEC does not allow */
+static void sandbox_mmc_switch(struct sandbox_mmc_card *card, uint arg)
+{
+	static const uint timings[] = {
+		[EXT_CSD_TIMING_LEGACY] = MMC_TIMING_LEGACY,
+		[EXT_CSD_TIMING_HS] = MMC_TIMING_HS,
+		[EXT_CSD_TIMING_HS200] = MMC_TIMING_MMC_HS200,
+		[EXT_CSD_TIMING_HS400] = MMC_TIMING_MMC_HS400,
+	};
+	uint index = (arg >> 16) & 0xff;
+	uint value = (arg >> 8) & 0xff;
+	u8 *ext_csd = card->ext_csd;
+
+	switch (index) {
+	case EXT_CSD_BUS_WIDTH:
+		/* The DDR widths are only allowed in HS timing */
+		if ((value & 3) == 3 || value > EXT_CSD_DDR_BUS_WIDTH_8 ||
+		    ((value & 4) &&
+		     ext_csd[EXT_CSD_HS_TIMING] != EXT_CSD_TIMING_HS))
+			goto err;
+		card->bus_width = (value & 3) == 0 ? 1 : (value & 3) * 4;
+		card->ddr = value & 4;
+		break;
+	case EXT_CSD_HS_TIMING:
+		/* HS200 needs a wide SDR bus, HS400 an 8-bit DDR one */
+		if (value >= ARRAY_SIZE(timings) ||
+		    (value == EXT_CSD_TIMING_HS200 &&
+		     (card->bus_width == 1 || card->ddr)) ||
+		    (value == EXT_CSD_TIMING_HS400 &&
+		     (card->bus_width != 8 || !card->ddr)))
+			goto err;
+		card->timing = timings[value];
+		break;
+	}
+	ext_csd[index] = value;
+
+	return;
+err:
+	card->switch_error = true;
+}
+
+/* Fill in the status of SD CMD6, switching access mode if asked */
+static void sandbox_sd_switch(struct sandbox_mmc_card *card, uint arg,
+			      u8 *status)
+{
+	static const uint timings[] = {
+		MMC_TIMING_LEGACY,
+		MMC_TIMING_HS,
+		MMC_TIMING_UHS_SDR50,
+		MMC_TIMING_UHS_SDR104,
+	};
+	uint supported = 1 << 0 | 1 << 1;
+	uint func = arg & 0xf;
+
+	/* The UHS-I modes need 1.8V signalling */
+	if (card->voltage == MMC_SIGNAL_VOLTAGE_180)
+		supported |= 1 << 2 | 1 << 3;
+
+	if (func == 0xf) {
+		for (func = 0; timings[func] != card->timing; func++)
+			;
+	}
+
+	memset(status, '\0', 64);
+	status[1] = 200;		/* maximum current in mA */
+	put_unaligned_be16(supported, &status[12]);
+	status[17] = 1;			/* version of the structure */
+	if (!(supported & (1 << func))) {
+		status[16] = 0xf;
+		return;
+	}
+	status[16] = func;
+	if (arg & (1 << 31))
+		card->timing = timings[func];
+}
+
+static int sandbox_mmc_rw(struct sandbox_mmc_card *card, uint arg,
+			  struct mmc_data *data)
+{
+	ulong start = card->sd ? arg : arg / MMC_MAX_BLOCK_LEN;
+	ulong size = data->blocks * data->blocksize;
+	u8 *ptr;
+
+	if (data->blocksize != MMC_MAX_BLOCK_LEN ||
+	    start + data->blocks > SANDBOX_MMC_BLOCKS)
+		return COMM_ERR;
+	ptr = card->data + start * MMC_MAX_BLOCK_LEN;
+
+	if (data->flags & MMC_DATA_READ)
+		memcpy(data->dest, ptr, size);
+	else
+		memcpy(ptr, data->src, size);
+
+	return 0;
+}
+
+static int sandbox_mmc_tuning(struct sandbox_mmc_card *card,
+			      struct mmc_data *data)
+{
+	const u8 *pattern = tuning_blk_pattern_4bit;
+	uint size = sizeof(tuning_blk_pattern_4bit);
+
+	if (card->bus_width == 8) {
+		pattern = tuning_blk_pattern_8bit;
+		size = sizeof(tuning_blk_pattern_8bit);
+	}
+	if (data->blocksize != size)
+		return COMM_ERR;
+	memcpy(data->dest, pattern, size);
+
+	return 0;
+}
+
+static int sandbox_mmc_erase(struct sandbox_mmc_card *card)
+{
+	ulong start = card->erase_start, end = card->erase_end;
+
+	if (!card->sd) {
+		start /= MMC_MAX_BLOCK_LEN;
+		end /= MMC_MAX_BLOCK_LEN;
+	}
+	if (start > end || end >= SANDBOX_MMC_BLOCKS)
+		return COMM_ERR;
+	memset(card->data + start * MMC_MAX_BLOCK_LEN, '\0',
+	       (end - start + 1) * MMC_MAX_BLOCK_LEN);
+
+	return 0;
+}
+
+/* Commands which only an SD card accepts after CMD55 */
+static int sandbox_sd_app_cmd(struct sandbox_mmc_card *card,
+			      struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	uint arg = cmd->cmdarg;
+
+	switch (cmd->cmdidx) {
+	case SD_CMD_APP_SEND_OP_COND:
+		if (card->state != CARD_IDLE && card->state != CARD_READY)
+			return TIMEOUT;
+		card->s18a = (arg & OCR_S18R) &&
+			card->voltage == MMC_SIGNAL_VOLTAGE_330;
+		card->state = CARD_READY;
+		cmd->response[0] = OCR_BUSY | OCR_HCS | 0xff8000 |
+			(card->s18a ? OCR_S18R : 0);
+		return 0;
+	case SD_CMD_APP_SET_BUS_WIDTH:
+		card->bus_width = arg == 2 ? 4 : 1;
+		break;
+	case SD_CMD_APP_SEND_SCR:
+		/* SD 3.0 with 1 and 4-bit buses and CMD23 */
+		put_unaligned_be32(0x02058002, data->dest);
+		put_unaligned_be32(0, data->dest + 4);
+		break;
+	default:
+		return TIMEOUT;
+	}
+	cmd->response[0] = sandbox_mmc_status(card);
+
+	return 0;
+}
+
+static int sandbox_mmc_card_cmd(struct sandbox_mmc_card *card,
+				struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	uint arg = cmd->cmdarg;
+	int ret = 0;
+
+	memset(cmd->response, '\0', sizeof(cmd->response));
+	if (card->app_cmd) {
+		card->app_cmd = false;
+		ret = sandbox_sd_app_cmd(card, cmd, data);
+		if (ret != TIMEOUT)
+			return ret;
+		ret = 0;
+	}
+
+	/* Only the initialisation commands work outside transfer state */
+	if (card->state != CARD_TRAN) {
+		switch (cmd->cmdidx) {
+		case MMC_CMD_GO_IDLE_STATE:
+		case MMC_CMD_SEND_OP_COND:
+		case MMC_CMD_ALL_SEND_CID:
+		case MMC_CMD_SET_RELATIVE_ADDR:
+		case MMC_CMD_SELECT_CARD:
+		case MMC_CMD_SEND_CSD:
+		case MMC_CMD_SEND_STATUS:
+		case MMC_CMD_APP_CMD:
+		case SD_CMD_SWITCH_UHS18V:
+			break;
+		case SD_CMD_SEND_IF_COND:
+			if (card->sd && card->state == CARD_IDLE)
+				break;
+			/* fall through */
+		default:
+			return TIMEOUT;
+		}
+	}
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		sandbox_mmc_go_idle(card);
+		return 0;
+	case MMC_CMD_SEND_OP_COND:
+		if (card->sd || card->state > CARD_READY)
+			return TIMEOUT;
+		card->state = CARD_READY;
+		/* Byte addressing, 1.8V and 2.7-3.6V */
+		cmd->response[0] = OCR_BUSY | 0xff8080;
+		return 0;
+	case MMC_CMD_ALL_SEND_CID:
+		if (card->state != CARD_READY)
+			return TIMEOUT;
+		card->state = CARD_IDENT;
+		cmd->response[0] = 0x15000053;	/* manufacturer, "S" */
+		cmd->response[1] = 0x414e4442;		/* "ANDB" */
+		cmd->response[2] = 0x10000000;
+		cmd->response[3] = 0x00000001;
+		return 0;
+	case MMC_CMD_SET_RELATIVE_ADDR:
+		if (card->state != CARD_IDENT && card->state != CARD_STBY)
+			return TIMEOUT;
+		if (card->sd) {
+			card->rca = SANDBOX_SD_RCA;
+			cmd->response[0] = card->rca << 16 |
+				card->state << 9 | MMC_STATUS_RDY_FOR_DATA;
+			card->state = CARD_STBY;
+			return 0;
+		}
+		card->rca = arg >> 16;
+		card->state = CARD_STBY;
+		break;
+	case MMC_CMD_SELECT_CARD:
+		if (arg >> 16 == card->rca)
+			card->state = CARD_TRAN;
+		else if (card->state == CARD_TRAN)
+			card->state = CARD_STBY;
+		break;
+	case SD_CMD_SEND_IF_COND:
+		if (card->sd) {
+			cmd->response[0] = arg & 0xfff;
+			return 0;
+		}
+		memcpy(data->dest, card->ext_csd, MMC_MAX_BLOCK_LEN);
+		break;
+	case MMC_CMD_SWITCH:
+		if (card->sd)
+			sandbox_sd_switch(card, arg, (u8 *)data->dest);
+		else
+			sandbox_mmc_switch(card, arg);
+		break;
+	case MMC_CMD_SEND_CSD:
+		if (card->state != CARD_STBY)
+			return TIMEOUT;
+		sandbox_mmc_csd(card, cmd->response);
+		return 0;
+	case SD_CMD_SWITCH_UHS18V:
+		if (!card->sd || !card->s18a ||
+		    card->voltage != MMC_SIGNAL_VOLTAGE_330)
+			return TIMEOUT;
+		card->voltage = MMC_SIGNAL_VOLTAGE_180;
+		break;
+	case MMC_CMD_STOP_TRANSMISSION:
+	case MMC_CMD_SEND_STATUS:
+	case MMC_CMD_SET_BLOCK_COUNT:
+		break;
+	case MMC_CMD_SET_BLOCKLEN:
+		if (arg != MMC_MAX_BLOCK_LEN || card->ddr)
+			ret = COMM_ERR;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		ret = sandbox_mmc_rw(card, arg, data);
+		break;
+	case MMC_CMD_SEND_TUNING_BLOCK:
+		if (!card->sd || (card->timing != MMC_TIMING_UHS_SDR50 &&
+				  card->timing != MMC_TIMING_UHS_SDR104))
+			return TIMEOUT;
+		ret = sandbox_mmc_tuning(card, data);
+		break;
+	case MMC_CMD_SEND_TUNING_BLOCK_HS200:
+		if (card->sd || card->timing != MMC_TIMING_MMC_HS200)
+			return TIMEOUT;
+		ret = sandbox_mmc_tuning(card, data);
+		break;
+	case SD_CMD_ERASE_WR_BLK_START:
+	case MMC_CMD_ERASE_GROUP_START:
+		if (card->sd != (cmd->cmdidx == SD_CMD_ERASE_WR_BLK_START))
+			return TIMEOUT;
+		card->erase_start = arg;
+		break;
+	case SD_CMD_ERASE_WR_BLK_END:
+	case MMC_CMD_ERASE_GROUP_END:
+		if (card->sd != (cmd->cmdidx == SD_CMD_ERASE_WR_BLK_END))
+			return TIMEOUT;
+		card->erase_end = arg;
+		break;
+	case MMC_CMD_ERASE:
+		ret = sandbox_mmc_erase(card);
+		break;
+	case MMC_CMD_APP_CMD:
+		if (!card->sd)
+			return TIMEOUT;
+		card->app_cmd = true;
+		break;
+	default:
+		return TIMEOUT;
+	}
+	cmd->response[0] = sandbox_mmc_status(card);
+
+	return ret;
+}
+
+/* Whether data gets across, which needs the host to suit the card */
+static bool sandbox_mmc_bus_ok(struct sandbox_mmc_priv *priv)
+{
+	struct sandbox_mmc_card *card = &priv->card;
+	uint max_clock;
+
+	if (priv->bus_width != card->bus_width || priv->ddr != card->ddr ||
+	    priv->voltage != card->voltage)
+		return false;
+
+	/* The eMMC only runs HS200 and HS400 with 1.8V I/O */
+	if ((card->timing == MMC_TIMING_MMC_HS200 ||
+	     card->timing == MMC_TIMING_MMC_HS400) &&
+	    card->voltage != MMC_SIGNAL_VOLTAGE_180)
+		return false;
+
+	switch (card->timing) {
+	case MMC_TIMING_LEGACY:
+		max_clock = card->sd ? 25000000 : 26000000;
+		break;
+	case MMC_TIMING_HS:
+		max_clock = card->sd ? 50000000 : 52000000;
+		break;
+	case MMC_TIMING_UHS_SDR50:
+		max_clock = 100000000;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+		max_clock = 208000000;
+		break;
+	default:
+		max_clock = 200000000;
+		break;
+	}
+	if (priv->clock > max_clock)
+		return false;
+
+	/* Above 100MHz only a tuned sampling point works */
+	return priv->clock <= 100000000 ||
+		(priv->phase >= SANDBOX_MMC_EYE_FIRST &&
+		 priv->phase <= SANDBOX_MMC_EYE_LAST);
+}
+
+static int sandbox_mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	int ret;
+
+	ret = sandbox_mmc_card_cmd(&priv->card, cmd, data);
+	if (!ret && data && !sandbox_mmc_bus_ok(priv))
+		ret = COMM_ERR;
+
+	return ret;
+}
+
+static void sandbox_mmc_set_ios(struct mmc *mmc)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	priv->bus_width = mmc->bus_width;
+	priv->clock = mmc->clock;
+	priv->ddr = mmc->ddr_mode;
+}
+
+static int sandbox_mmc_init(struct mmc *mmc)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	/* Forget the tuning, as a controller reset would */
+	priv->phase = 0;
+
+	return 0;
+}
+
+static int sandbox_mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	struct sandbox_mmc_card *card = &priv->card;
+
+	priv->voltage = voltage;
+	if (!card->sd)
+		card->voltage = voltage;
+	/* An SD card which did not take CMD11 does not drive DAT high */
+	else if (voltage == MMC_SIGNAL_VOLTAGE_180 && card->voltage != voltage)
+		return -EIO;
+
+	return 0;
+}
+
+static int sandbox_mmc_power_cycle(struct mmc *mmc)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	if (priv->no_power_switch)
+		return -ENOSYS;
+	sandbox_mmc_power_up(&priv->card);
+
+	return 0;
+}
+
+/* Use the middle of the longest run of working sampling points */
+static int sandbox_mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	uint phase, first = 0, best = 0, best_len = 0;
+
+	for (phase = 0; phase < SANDBOX_MMC_PHASES; phase++) {
+		priv->phase = phase;
+		if (mmc_send_tuning(mmc, opcode)) {
+			first = phase + 1;
+			continue;
+		}
+		if (phase + 1 - first > best_len) {
+			best = first;
+			best_len = phase + 1 - first;
+		}
+	}
+	if (!best_len)
+		return -EIO;
+	priv->phase = best + best_len / 2;
+
+	return 0;
+}
+
+uint sandbox_mmc_get_phase(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->phase;
+}
+
+void sandbox_mmc_set_power_switch(struct udevice *dev, bool present)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->no_power_switch = !present;
+}
+
+static const struct mmc_ops sandbox_mmc_ops = {
+	.send_cmd		= sandbox_mmc_send_cmd,
+	.set_ios		= sandbox_mmc_set_ios,
+	.init			= sandbox_mmc_init,
+	.set_signal_voltage	= sandbox_mmc_set_signal_voltage,
+	.execute_tuning		= sandbox_mmc_execute_tuning,
+	.power_cycle		= sandbox_mmc_power_cycle,
+};
+
+static int sandbox_mmc_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct sandbox_mmc_card *card = &priv->card;
+	struct mmc_config *cfg = &priv->cfg;
+
+	card->sd = fdtdec_get_bool(gd->fdt_blob, dev->of_offset,
+				   "sandbox,sd-card");
+	card->data = os_malloc(SANDBOX_MMC_SIZE);
+	if (!card->data)
+		return -ENOMEM;
+	if (!card->sd)
+		sandbox_mmc_init_ext_csd(card);
+	sandbox_mmc_power_up(card);
+
+	cfg->name = dev->name;
+	cfg->ops = &sandbox_mmc_ops;
+	cfg->host_caps = MMC_MODE_4BIT | MMC_MODE_8BIT | MMC_MODE_HS |
+		MMC_MODE_HS_52MHz | MMC_MODE_DDR_52MHz | MMC_MODE_CMD23 |
+		MMC_MODE_HS200 | MMC_MODE_HS400 | MMC_MODE_UHS_SDR50 |
+		MMC_MODE_UHS_SDR104;
+	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34 | MMC_VDD_165_195;
+	cfg->f_min = 400000;
+	cfg->f_max = 208000000;
+	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+
+	priv->mmc = mmc_create(cfg, priv);
+	if (!priv->mmc) {
+		os_free(card->data);
+		return -ENOMEM;
+	}
+	upriv->mmc = priv->mmc;
+
+	return 0;
+}
+
+static int sandbox_mmc_remove(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	mmc_destroy(priv->mmc);
+	os_free(priv->card.data);
+
+	return 0;
+}
+
 static const struct udevice_id sandbox_mmc_ids[] = {
 	{ .compatible = "sandbox,mmc" },
 	{ }
@@ -22,4 +652,7 @@ U_BOOT_DRIVER(warm_mmc_sandbox) = {
 	.name		= "mmc_sandbox",
 	.id		= UCLASS_MMC,
 	.of_match	= sandbox_mmc_ids,
+	.probe		= sandbox_mmc_probe,
+	.remove		= sandbox_mmc_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 };
@@ -9,10 +9,16 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <malloc.h>
 #include <mmc.h>
 #include <sdhci.h>
 
+/* A board asking for both gets ADMA2, which needs no restarts */
+#if defined(CONFIG_MMC_SDHCI_ADMA) && defined(CONFIG_MMC_SDMA)
+#undef CONFIG_MMC_SDMA
+#endif
+
 #if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
 void *aligned_buffer = (void *)CONFIG_FIXED_SDHCI_ALIGNED_BUFFER;
 #else
@@ -67,6 +73,63 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	}
 }
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+/*
+ * Describe the whole buffer to the ADMA2 engine, so that the transfer runs
+ * to the end without help. Buffers which are not aligned for it, and
+ * transfers which need more descriptors than the table has, are left to
+ * PIO rather than copied or split.
+ */
+static bool sdhci_prepare_adma(struct sdhci_host *host, struct mmc_data *data,
+			       unsigned int trans_bytes)
+{
+	ulong addr = data->flags == MMC_DATA_READ ? (ulong)data->dest :
+		(ulong)data->src;
+	ulong align = host->adma_64 ||
+		(host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) ? 7 : 3;
+	int desc_len = host->adma_64 ? sizeof(struct sdhci_adma_desc) : 8;
+	void *desc = host->adma_desc;
+	struct sdhci_adma_desc *d;
+	unsigned int left = trans_bytes, len;
+	u8 ctrl;
+
+	if (addr & align)
+		return false;
+	if (DIV_ROUND_UP(trans_bytes, SDHCI_ADMA_MAX_LEN) > SDHCI_ADMA_DESC_NUM)
+		return false;
+
+	flush_cache(addr, trans_bytes);
+	do {
+		len = min(left, (unsigned int)SDHCI_ADMA_MAX_LEN);
+		left -= len;
+		d = desc;
+		d->attr = cpu_to_le16(SDHCI_ADMA_VALID | SDHCI_ADMA_ACT_TRAN |
+				      (left ? 0 : SDHCI_ADMA_END));
+		d->len = cpu_to_le16(len);
+		d->addr_lo = cpu_to_le32(lower_32_bits(addr));
+		if (host->adma_64)
+			d->addr_hi = cpu_to_le32(upper_32_bits(addr));
+		addr += len;
+		desc += desc_len;
+	} while (left);
+	flush_cache((ulong)host->adma_desc,
+		    ALIGN(desc - (void *)host->adma_desc, ARCH_DMA_MINALIGN));
+
+	sdhci_writel(host, lower_32_bits((ulong)host->adma_desc),
+		     SDHCI_ADMA_ADDRESS);
+	if (host->adma_64)
+		sdhci_writel(host, upper_32_bits((ulong)host->adma_desc),
+			     SDHCI_ADMA_ADDRESS_HI);
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= host->adma_64 ? SDHCI_CTRL_ADMA64 : SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	return true;
+}
+#endif
+
 static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 				unsigned int start_addr)
 {
@@ -196,6 +259,10 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (sdhci_prepare_adma(host, data, trans_bytes))
+			mode |= SDHCI_TRNS_DMA;
+#endif
 #ifdef CONFIG_MMC_SDMA
 		if (data->flags == MMC_DATA_READ)
 			start_addr = (unsigned long)data->dest;
@@ -372,6 +439,44 @@ static void sdhci_set_power(struct sdhci_host *host, unsigned short power)
 	sdhci_writeb(host, pwr, SDHCI_POWER_CONTROL);
 }
 
+/* Select the UHS-I or HS200/HS400 bus mode for the core's timing */
+static void sdhci_set_uhs_timing(struct mmc *mmc)
+{
+	struct sdhci_host *host = mmc->priv;
+	u16 ctrl, mode;
+
+	switch (mmc->timing) {
+	case MMC_TIMING_HS:
+		mode = mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180 ?
+			SDHCI_CTRL_UHS_SDR25 : SDHCI_CTRL_UHS_SDR12;
+		break;
+	case MMC_TIMING_UHS_SDR50:
+		mode = SDHCI_CTRL_UHS_SDR50;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+	case MMC_TIMING_MMC_HS200:
+		mode = SDHCI_CTRL_UHS_SDR104;
+		break;
+	case MMC_TIMING_MMC_HS400:
+		mode = SDHCI_CTRL_HS400;
+		break;
+	default:
+		mode = SDHCI_CTRL_UHS_SDR12;
+		break;
+	}
+
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	if ((ctrl & SDHCI_CTRL_UHS_MASK) == mode)
+		return;
+
+	/* The card clock must be stopped while the mode changes */
+	sdhci_writew(host, sdhci_readw(host, SDHCI_CLOCK_CONTROL) &
+		     ~SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+	host->clock = 0;
+	ctrl = (ctrl & ~SDHCI_CTRL_UHS_MASK) | mode;
+	sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+}
+
 static void sdhci_set_ios(struct mmc *mmc)
 {
 	u32 ctrl;
@@ -380,6 +485,9 @@ static void sdhci_set_ios(struct mmc *mmc)
 	if (host->set_control_reg)
 		host->set_control_reg(host);
 
+	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300)
+		sdhci_set_uhs_timing(mmc);
+
 	if (mmc->clock != host->clock)
 		sdhci_set_clock(mmc, mmc->clock);
 
@@ -424,6 +532,20 @@ static int sdhci_init(struct mmc *mmc)
 		}
 	}
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (!host->adma_desc) {
+		host->adma_desc = memalign(ARCH_DMA_MINALIGN,
+				ALIGN(SDHCI_ADMA_DESC_NUM *
+				      sizeof(struct sdhci_adma_desc),
+				      ARCH_DMA_MINALIGN));
+		if (!host->adma_desc) {
+			printf("%s: ADMA descriptor alloc failed!!!\n",
+			       __func__);
+			return -1;
+		}
+	}
+#endif
+
 	sdhci_set_power(host, fls(mmc->cfg->voltages) - 1);
 
 	if (host->quirks & SDHCI_QUIRK_NO_CD) {
@@ -449,10 +571,126 @@ static int sdhci_init(struct mmc *mmc)
 }
 
 
+static int sdhci_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	struct sdhci_host *host = mmc->priv;
+	u16 clk, ctrl;
+	int err;
+
+	/* Stop the card clock while the I/O lines change level */
+	clk = sdhci_readw(host, SDHCI_CLOCK_CONTROL);
+	sdhci_writew(host, clk & ~SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	if (voltage == MMC_SIGNAL_VOLTAGE_180)
+		ctrl |= SDHCI_CTRL_VDD_180;
+	else
+		ctrl &= ~SDHCI_CTRL_VDD_180;
+	sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+
+	if (host->set_signal_voltage) {
+		err = host->set_signal_voltage(host, voltage);
+		if (err)
+			return err;
+	}
+
+	/* The regulator has 5ms to settle */
+	mdelay(5);
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	if (!!(ctrl & SDHCI_CTRL_VDD_180) !=
+	    (voltage == MMC_SIGNAL_VOLTAGE_180))
+		return -EIO;
+
+	sdhci_writew(host, clk | SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+	if (voltage != MMC_SIGNAL_VOLTAGE_180)
+		return 0;
+
+	/* A card which switched drives DAT[3:0] high within 1ms */
+	mdelay(1);
+	if ((sdhci_readl(host, SDHCI_PRESENT_STATE) & SDHCI_DATA_LVL_MASK) !=
+	    SDHCI_DATA_LVL_MASK)
+		return -EIO;
+
+	return 0;
+}
+
+/* Cut the card's power, which is what takes an SD card back to 3.3V */
+static int sdhci_power_cycle(struct mmc *mmc)
+{
+	struct sdhci_host *host = mmc->priv;
+
+	sdhci_set_power(host, (unsigned short)-1);
+	/* VDD must stay off for at least 1ms */
+	mdelay(1);
+	sdhci_set_power(host, fls(mmc->cfg->voltages) - 1);
+	/* and gets some time to ramp up again */
+	mdelay(10);
+
+	return 0;
+}
+
+/*
+ * Let the controller find the sampling point: it reads tuning blocks
+ * itself and clears EXEC_TUNING once it is done, setting TUNED_CLK if
+ * it succeeded. The blocks are never passed on to the driver.
+ */
+static int sdhci_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct sdhci_host *host = mmc->priv;
+	int blksz = mmc->bus_width == 8 ? 128 : 64;
+	int flags = SDHCI_CMD_RESP_SHORT | SDHCI_CMD_CRC | SDHCI_CMD_INDEX |
+		SDHCI_CMD_DATA;
+	unsigned start;
+	u16 ctrl;
+	int i;
+
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	ctrl |= SDHCI_CTRL_EXEC_TUNING;
+	sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+
+	for (i = 0; i < SDHCI_TUNING_LOOPS; i++) {
+		sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+				blksz), SDHCI_BLOCK_SIZE);
+		sdhci_writew(host, 1, SDHCI_BLOCK_COUNT);
+		sdhci_writew(host, SDHCI_TRNS_READ, SDHCI_TRANSFER_MODE);
+		sdhci_writel(host, 0, SDHCI_ARGUMENT);
+		sdhci_writew(host, SDHCI_MAKE_CMD(opcode, flags),
+			     SDHCI_COMMAND);
+
+		/* Buffer Read Ready says that a block was sampled */
+		start = get_timer(0);
+		while (!(sdhci_readl(host, SDHCI_INT_STATUS) &
+			 SDHCI_INT_DATA_AVAIL)) {
+			if (get_timer(start) > CONFIG_SDHCI_CMD_DEFAULT_TIMEOUT)
+				break;
+		}
+		sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+
+		ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+		if (!(ctrl & SDHCI_CTRL_EXEC_TUNING))
+			break;
+	}
+
+	sdhci_reset(host, SDHCI_RESET_CMD);
+	sdhci_reset(host, SDHCI_RESET_DATA);
+
+	if (ctrl & SDHCI_CTRL_EXEC_TUNING) {
+		ctrl &= ~(SDHCI_CTRL_EXEC_TUNING | SDHCI_CTRL_TUNED_CLK);
+		sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+		return TIMEOUT;
+	}
+
+	return ctrl & SDHCI_CTRL_TUNED_CLK ? 0 : COMM_ERR;
+}
+
 static const struct mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
 	.init		= sdhci_init,
+	.set_signal_voltage = sdhci_set_signal_voltage,
+	.execute_tuning	= sdhci_execute_tuning,
+	.power_cycle	= sdhci_power_cycle,
 };
 
 int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
@@ -470,6 +708,15 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 		return -1;
 	}
 #endif
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
+		printf("%s: Your controller doesn't support ADMA2!!\n",
+		       __func__);
+		return -1;
+	}
+	/* 64-bit addresses are only needed where buffers can be above 4GiB */
+	host->adma_64 = sizeof(ulong) > 4 && (caps & SDHCI_CAN_64BIT);
+#endif
 
 	if (max_clk)
 		host->cfg.f_max = max_clk;
@@ -509,7 +756,8 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 	if (host->quirks & SDHCI_QUIRK_BROKEN_VOLTAGE)
 		host->cfg.voltages |= host->voltages;
 
-	host->cfg.host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	host->cfg.host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT |
+			      MMC_MODE_CMD23;
 	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
 		if (caps & SDHCI_CAN_DO_8BIT)
 			host->cfg.host_caps |= MMC_MODE_8BIT;
@@ -517,6 +765,26 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 	if (host->host_caps)
 		host->cfg.host_caps |= host->host_caps;
 
+	/*
+	 * 1.8V signalling and tuning need a version 3.00 controller. The
+	 * board must still ask for these modes, since the I/O voltage and
+	 * the eMMC's VCCQ are its business.
+	 */
+	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
+		caps = sdhci_readl(host, SDHCI_CAPABILITIES_1);
+		if (!(caps & SDHCI_SUPPORT_SDR50))
+			host->cfg.host_caps &= ~MMC_MODE_UHS_SDR50;
+		if (!(caps & SDHCI_SUPPORT_SDR104))
+			host->cfg.host_caps &= ~MMC_MODE_UHS_SDR104;
+		/* There is no standard way to select HS400 */
+		if (!(host->quirks & SDHCI_QUIRK_HS400))
+			host->cfg.host_caps &= ~MMC_MODE_HS400;
+	} else {
+		host->cfg.host_caps &= ~(MMC_MODE_UHS_SDR50 |
+					 MMC_MODE_UHS_SDR104 |
+					 MMC_MODE_HS200 | MMC_MODE_HS400);
+	}
+
 	host->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
 	sdhci_reset(host, SDHCI_RESET_ALL);
@@ -1345,6 +1345,25 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_cache_read_next - [INTERN] Check if the next page can be cache-read
+ * @chip: nand chip info structure
+ * @realpage: page which is about to be transferred
+ * @readlen: number of bytes still to read after this page
+ *
+ * READ CACHE SEQUENTIAL makes the chip load the page following @realpage
+ * into its data register while @realpage is transferred from the cache
+ * register. Only use it if that page is wanted and lies in the same
+ * eraseblock.
+ */
+static int nand_cache_read_next(struct nand_chip *chip, int realpage,
+				uint32_t readlen)
+{
+	int ppb_mask = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
+
+	return NAND_HAS_CACHERD(chip) && readlen && ((realpage + 1) & ppb_mask);
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1369,6 +1388,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	int cache_rd = 0, cache_page;
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -1394,8 +1414,12 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		else
 			use_bufpoi = 0;
 
-		/* Is the current page in the buffer? */
-		if (realpage != chip->pagebuf || oob) {
+		/*
+		 * Is the current page in the buffer? In a cache read sequence
+		 * the page must still be read, or the chip would not move on
+		 * to the next one.
+		 */
+		if (realpage != chip->pagebuf || oob || cache_rd) {
 			bufpoi = use_bufpoi ? chip->buffers->databuf : buf;
 
 			if (use_bufpoi && aligned)
@@ -1403,7 +1427,25 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 						 __func__, buf);
 
 read_retry:
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			/*
+			 * In a cache read sequence the page has already been
+			 * loaded by the previous READ CACHE SEQUENTIAL.
+			 */
+			if (!cache_rd)
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+			cache_page = cache_rd;
+			if (nand_cache_read_next(chip, realpage,
+						 readlen - bytes)) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ,
+					      -1, -1);
+				cache_rd = 1;
+				cache_page = 1;
+			} else if (cache_rd) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHEEND,
+					      -1, -1);
+				cache_rd = 0;
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1414,7 +1456,7 @@ read_retry:
 							      oob_required,
 							      page);
 			else if (!aligned && NAND_HAS_SUBPAGE_READ(chip) &&
-				 !oob)
+				 !oob && !cache_page)
 				ret = chip->ecc.read_subpage(mtd, chip,
 							col, bytes, bufpoi,
 							page);
@@ -1472,6 +1514,13 @@ read_retry:
 
 					/* Reset failures; retry */
 					mtd->ecc_stats.failed = ecc_failures;
+					/* Restart any cache read from here */
+					if (cache_rd) {
+						chip->cmdfunc(mtd,
+							NAND_CMD_READCACHEEND,
+							-1, -1);
+						cache_rd = 0;
+					}
 					goto read_retry;
 				} else {
 					/* No more retry modes; real failure */
@@ -1513,6 +1562,11 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+
+	/* Terminate a cache read sequence aborted on error */
+	if (cache_rd)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -3028,6 +3082,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 		pr_warn("Could not retrieve ONFI ECC requirements\n");
 	}
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHERD;
+
 	if (p->jedec_id == NAND_MFR_MICRON)
 		nand_onfi_detect_micron(chip, p);
 
@@ -3947,6 +4004,16 @@ int nand_scan_tail(struct mtd_info *mtd)
 	/* Invalidate the pagebuffer reference */
 	chip->pagebuf = -1;
 
+	/*
+	 * Cache reads are only issued through the generic large page command
+	 * function, controllers with their own cmdfunc may not pass them on.
+	 * HW_OOB_FIRST reads the OOB with its own commands inside read_page,
+	 * which would end the cache read sequence.
+	 */
+	if (chip->cmdfunc != nand_command_lp ||
+	    ecc->mode == NAND_ECC_HW_OOB_FIRST)
+		chip->options &= ~NAND_CACHERD;
+
 	/* Large page NAND with SOFT_ECC should support subpage reads */
 	switch (ecc->mode) {
 	case NAND_ECC_SOFT:
@@ -20,6 +20,7 @@
 #include <asm/getopt.h>
 #include <asm/spi.h>
 #include <asm/state.h>
+#include <asm/unaligned.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -41,13 +42,14 @@ enum sandbox_sf_state {
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
 	SF_WRITE_STATUS, /* write the flash's status register */
+	SF_READ_SFDP, /* read the flash's SFDP tables */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
-		"READ_STATUS1", "WRITE_STATUS",
+		"READ_STATUS1", "WRITE_STATUS", "READ_SFDP",
 	};
 	return states[state];
 }
@@ -61,6 +63,11 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 
 #define IDCODE_LEN 3
 
+/* SFDP header, one parameter header and a JESD216B basic parameter table */
+#define SFDP_BFPT_OFF		0x10
+#define SFDP_BFPT_DWORDS	16
+#define SFDP_LEN		(SFDP_BFPT_OFF + SFDP_BFPT_DWORDS * 4)
+
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
@@ -260,6 +267,7 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->cmd = SF_ID;
 		break;
 	case CMD_READ_ARRAY_FAST:
+	case CMD_READ_SFDP:
 		sbsf->pad_addr_bytes = 1;
 	case CMD_READ_ARRAY_SLOW:
 	case CMD_PAGE_PROGRAM:
@@ -293,9 +301,8 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 			sbsf->erase_size = 4 << 10;
 		} else if (sbsf->cmd == CMD_ERASE_32K && (flags & SECT_32K)) {
 			sbsf->erase_size = 32 << 10;
-		} else if (sbsf->cmd == CMD_ERASE_64K &&
-			   !(flags & (SECT_4K | SECT_32K))) {
-			sbsf->erase_size = 64 << 10;
+		} else if (sbsf->cmd == CMD_ERASE_64K) {
+			sbsf->erase_size = sbsf->data->sector_size;
 		} else {
 			debug(" cmd unknown: %#x\n", sbsf->cmd);
 			return -EIO;
@@ -312,6 +319,59 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	return 0;
 }
 
+/* Describe the emulated flash through SFDP, as a real one would */
+static void sandbox_sf_sfdp(const struct spi_flash_params *data, u8 *sfdp)
+{
+	u32 bfpt[SFDP_BFPT_DWORDS];
+	u32 size = data->sector_size * data->nr_sectors;
+	int i;
+
+	memset(sfdp, '\0', SFDP_LEN);
+	memcpy(sfdp, "SFDP", 4);
+	sfdp[4] = 6;			/* minor revision (JESD216B) */
+	sfdp[5] = 1;			/* major revision */
+	sfdp[6] = 0;			/* one parameter header */
+	sfdp[7] = 0xff;
+	sfdp[8] = 0x00;			/* basic flash parameter table */
+	sfdp[9] = 6;
+	sfdp[10] = 1;
+	sfdp[11] = SFDP_BFPT_DWORDS;
+	sfdp[12] = SFDP_BFPT_OFF;
+	sfdp[15] = 0xff;
+
+	memset(bfpt, '\0', sizeof(bfpt));
+	if (data->flags & SECT_4K)
+		bfpt[0] = 0x01 | CMD_ERASE_4K << 8;
+	else
+		bfpt[0] = 0x03 | 0xff << 8;
+	if (data->e_rd_cmd & DUAL_OUTPUT_FAST)
+		bfpt[0] |= 1 << 16;
+	if (data->e_rd_cmd & DUAL_IO_FAST)
+		bfpt[0] |= 1 << 20;
+	if (data->e_rd_cmd & QUAD_IO_FAST)
+		bfpt[0] |= 1 << 21;
+	if (data->e_rd_cmd & QUAD_OUTPUT_FAST)
+		bfpt[0] |= 1 << 22;
+	bfpt[1] = size * 8 - 1;
+	/* 1-4-4: 2 mode + 4 dummy cycles, 1-1-4: 8 dummy cycles */
+	bfpt[2] = 4 | 2 << 5 | CMD_READ_QUAD_IO_FAST << 8 |
+		(8 | CMD_READ_QUAD_OUTPUT_FAST << 8) << 16;
+	/* 1-1-2: 8 dummy cycles, 1-2-2: 4 mode cycles */
+	bfpt[3] = 8 | CMD_READ_DUAL_OUTPUT_FAST << 8 |
+		(4 << 5 | CMD_READ_DUAL_IO_FAST << 8) << 16;
+	/* Erase types: 4KiB, 32KiB and the CMD_ERASE_64K sector */
+	if (data->flags & SECT_4K)
+		bfpt[7] |= 12 | CMD_ERASE_4K << 8;
+	if (data->flags & SECT_32K)
+		bfpt[7] |= (15 | CMD_ERASE_32K << 8) << 16;
+	bfpt[8] = (ffs(data->sector_size) - 1) | CMD_ERASE_64K << 8;
+	/* 256-byte pages */
+	bfpt[10] = 8 << 4;
+
+	for (i = 0; i < SFDP_BFPT_DWORDS; i++)
+		put_unaligned_le32(bfpt[i], sfdp + SFDP_BFPT_OFF + i * 4);
+}
+
 int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
 {
 	int todo;
@@ -401,6 +461,9 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			case CMD_PAGE_PROGRAM:
 				sbsf->state = SF_WRITE;
 				break;
+			case CMD_READ_SFDP:
+				sbsf->state = SF_READ_SFDP;
+				break;
 			default:
 				/* assume erase state ... */
 				sbsf->state = SF_ERASE;
@@ -425,6 +488,15 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			}
 			pos += ret;
 			break;
+		case SF_READ_SFDP: {
+			u8 sfdp[SFDP_LEN];
+
+			sandbox_sf_sfdp(sbsf->data, sfdp);
+			for (; pos < bytes; pos++, sbsf->off++)
+				tx[pos] = sbsf->off < SFDP_LEN ?
+					sfdp[sbsf->off] : 0xff;
+			break;
+		}
 		case SF_READ_STATUS:
 			debug(" read status: %#x\n", sbsf->status);
 			cnt = bytes - pos;
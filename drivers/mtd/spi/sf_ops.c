@@ -18,12 +18,16 @@
 
 #include "sf_internal.h"
 
-static void spi_flash_addr(u32 addr, u8 *cmd)
+static void spi_flash_addr(struct spi_flash *flash, u32 addr, u8 *cmd)
 {
+	int i = 1;
+
 	/* cmd[0] is actual command */
-	cmd[1] = addr >> 16;
-	cmd[2] = addr >> 8;
-	cmd[3] = addr >> 0;
+	if (flash->addr_width == SPI_FLASH_4B_ADDR_LEN)
+		cmd[i++] = addr >> 24;
+	cmd[i++] = addr >> 16;
+	cmd[i++] = addr >> 8;
+	cmd[i] = addr >> 0;
 }
 
 int spi_flash_cmd_read_status(struct spi_flash *flash, u8 *rs)
@@ -121,6 +125,10 @@ static int spi_flash_bank(struct spi_flash *flash, u32 offset)
 	u8 bank_sel;
 	int ret;
 
+	/* 4-byte addresses reach the whole flash without bank switching */
+	if (flash->addr_width == SPI_FLASH_4B_ADDR_LEN)
+		return 0;
+
 	bank_sel = offset / (SPI_FLASH_16MB_BOUN << flash->shift);
 
 	ret = spi_flash_cmd_bankaddr_write(flash, bank_sel);
@@ -264,10 +272,31 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+/*
+ * Pick the largest erase command which fits the remaining range, so that
+ * e.g. a 4KiB-sector flash is still erased in 64KiB blocks where possible.
+ */
+static u8 spi_flash_erase_cmd(struct spi_flash *flash, u32 offset,
+			      size_t len, u32 *erase_size)
+{
+#ifdef CONFIG_SPI_FLASH_SFDP
+	int i;
+
+	for (i = flash->erase_types - 1; i >= 0; i--) {
+		*erase_size = flash->erase_type_size[i];
+		if (!(offset % *erase_size) && len >= *erase_size)
+			return flash->erase_type_cmd[i];
+	}
+#endif
+	*erase_size = flash->erase_size;
+
+	return flash->erase_cmd;
+}
+
 int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 {
 	u32 erase_size, erase_addr;
-	u8 cmd[SPI_FLASH_CMD_LEN];
+	u8 cmd[SPI_FLASH_CMD_MAX_LEN];
 	int ret = -1;
 
 	erase_size = flash->erase_size;
@@ -276,9 +305,9 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		return -1;
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
 		erase_addr = offset;
+		cmd[0] = spi_flash_erase_cmd(flash, offset, len, &erase_size);
 
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
@@ -289,12 +318,13 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		if (ret < 0)
 			return ret;
 #endif
-		spi_flash_addr(erase_addr, cmd);
+		spi_flash_addr(flash, erase_addr, cmd);
 
 		debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0], cmd[1],
 		      cmd[2], cmd[3], erase_addr);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd), NULL, 0);
+		ret = spi_flash_write_common(flash, cmd, 1 + flash->addr_width,
+					     NULL, 0);
 		if (ret < 0) {
 			debug("SF: erase failed\n");
 			break;
@@ -313,7 +343,7 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 	unsigned long byte_addr, page_size;
 	u32 write_addr;
 	size_t chunk_len, actual;
-	u8 cmd[SPI_FLASH_CMD_LEN];
+	u8 cmd[SPI_FLASH_CMD_MAX_LEN];
 	int ret = -1;
 
 	page_size = flash->page_size;
@@ -338,12 +368,12 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 			chunk_len = min(chunk_len,
 					(size_t)flash->spi->max_write_size);
 
-		spi_flash_addr(write_addr, cmd);
+		spi_flash_addr(flash, write_addr, cmd);
 
 		debug("SF: 0x%p => cmd = { 0x%02x 0x%02x%02x%02x } chunk_len = %zu\n",
 		      buf + actual, cmd[0], cmd[1], cmd[2], cmd[3], chunk_len);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd),
+		ret = spi_flash_write_common(flash, cmd, 1 + flash->addr_width,
 					buf + actual, chunk_len);
 		if (ret < 0) {
 			debug("SF: write failed\n");
@@ -384,6 +414,65 @@ void __weak spi_flash_copy_mmap(void *data, void *offset, size_t len)
 	memcpy(data, offset, len);
 }
 
+#ifdef CONFIG_DM_SPI
+/*
+ * Hand a whole read over to the SPI controller. Returns -ENOSYS if the
+ * controller cannot do it, in which case the read goes through spi_xfer().
+ */
+static int spi_flash_mem_read(struct spi_flash *flash, u32 addr,
+			      size_t len, void *data)
+{
+	struct spi_mem_read op = {
+		.opcode = flash->read_cmd,
+		.addr = addr,
+		.addr_len = flash->addr_width,
+		.addr_lanes = 1,
+		.data_lanes = 1,
+		.buf = data,
+		.len = len,
+	};
+	int ret;
+
+	switch (flash->read_cmd) {
+	case CMD_READ_DUAL_IO_FAST:
+	case CMD_READ_DUAL_IO_FAST_4B:
+		op.addr_lanes = 2;
+		/* fall through */
+	case CMD_READ_DUAL_OUTPUT_FAST:
+	case CMD_READ_DUAL_OUTPUT_FAST_4B:
+		op.data_lanes = 2;
+		break;
+	case CMD_READ_QUAD_IO_FAST:
+	case CMD_READ_QUAD_IO_FAST_4B:
+		op.addr_lanes = 4;
+		/* fall through */
+	case CMD_READ_QUAD_OUTPUT_FAST:
+	case CMD_READ_QUAD_OUTPUT_FAST_4B:
+		op.data_lanes = 4;
+		break;
+	}
+	op.dummy_cycles = flash->dummy_byte * 8 / op.addr_lanes;
+
+	ret = spi_claim_bus(flash->spi);
+	if (ret) {
+		debug("SF: unable to claim SPI bus\n");
+		return ret;
+	}
+
+	ret = spi_mem_read(flash->spi, &op);
+
+	spi_release_bus(flash->spi);
+
+	return ret;
+}
+#else
+static inline int spi_flash_mem_read(struct spi_flash *flash, u32 addr,
+				     size_t len, void *data)
+{
+	return -ENOSYS;
+}
+#endif
+
 int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		size_t len, void *data)
 {
@@ -406,7 +495,7 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		return 0;
 	}
 
-	cmdsz = SPI_FLASH_CMD_LEN + flash->dummy_byte;
+	cmdsz = 1 + flash->addr_width + flash->dummy_byte;
 	cmd = calloc(1, cmdsz);
 	if (!cmd) {
 		debug("SF: Failed to allocate cmd\n");
@@ -433,9 +522,12 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		else
 			read_len = remain_len;
 
-		spi_flash_addr(read_addr, cmd);
-
-		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
+		ret = spi_flash_mem_read(flash, read_addr, read_len, data);
+		if (ret == -ENOSYS) {
+			spi_flash_addr(flash, read_addr, cmd);
+			ret = spi_flash_read_common(flash, cmd, cmdsz, data,
+						    read_len);
+		}
 		if (ret < 0) {
 			debug("SF: read failed\n");
 			break;
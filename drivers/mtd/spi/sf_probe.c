@@ -32,6 +32,18 @@ static u8 spi_read_cmds_array[] = {
 	CMD_READ_QUAD_IO_FAST,
 };
 
+#ifdef CONFIG_SPI_FLASH_SFDP
+/* 4-byte address variants of spi_read_cmds_array[] */
+static u8 spi_read_cmds_4b_array[] = {
+	CMD_READ_ARRAY_SLOW_4B,
+	CMD_READ_ARRAY_FAST_4B,
+	CMD_READ_DUAL_OUTPUT_FAST_4B,
+	CMD_READ_DUAL_IO_FAST_4B,
+	CMD_READ_QUAD_OUTPUT_FAST_4B,
+	CMD_READ_QUAD_IO_FAST_4B,
+};
+#endif
+
 #ifdef CONFIG_SPI_FLASH_MACRONIX
 static int spi_flash_set_qeb_mxic(struct spi_flash *flash)
 {
@@ -99,10 +111,385 @@ static int spi_flash_set_qeb(struct spi_flash *flash, u8 idcode0)
 	}
 }
 
+#ifdef CONFIG_SPI_FLASH_SFDP
+/* Serial Flash Discoverable Parameters, see JEDEC JESD216 */
+#define SFDP_SIGNATURE			0x50444653	/* "SFDP" */
+#define SFDP_PARAM_BFPT			0xff00	/* Basic Flash Parameters */
+#define SFDP_PARAM_4BAIT		0xff84	/* 4-byte Address Instructions */
+#define SFDP_BFPT_MIN_DWORDS		9
+#define SFDP_BFPT_MAX_DWORDS		16
+
+/* BFPT DWORD1 */
+#define BFPT_DW1_ERASE_4K_MASK		(3 << 0)
+#define BFPT_DW1_ERASE_4K		(1 << 0)
+#define BFPT_DW1_FAST_READ_1_1_2	(1 << 16)
+#define BFPT_DW1_ADDR_BYTES_MASK	(3 << 17)
+#define BFPT_DW1_ADDR_BYTES_3_OR_4	(1 << 17)
+#define BFPT_DW1_ADDR_BYTES_4_ONLY	(2 << 17)
+#define BFPT_DW1_FAST_READ_1_2_2	(1 << 20)
+#define BFPT_DW1_FAST_READ_1_4_4	(1 << 21)
+#define BFPT_DW1_FAST_READ_1_1_4	(1 << 22)
+
+/* 4BAIT DWORD1 */
+#define BAIT_PAGE_PROGRAM		(1 << 6)
+#define BAIT_QUAD_PAGE_PROGRAM		(1 << 7)
+#define BAIT_ERASE_TYPE(i)		(1 << (9 + (i)))
+
+struct sfdp_header {
+	__le32 signature;
+	u8 minor;
+	u8 major;
+	u8 nph;		/* number of parameter headers - 1 */
+	u8 reserved;
+};
+
+struct sfdp_param_header {
+	u8 id_lsb;
+	u8 minor;
+	u8 major;
+	u8 length;	/* in dwords */
+	u8 ptr[3];
+	u8 id_msb;
+};
+
+/* Where the BFPT describes each dual/quad fast read command */
+static const struct {
+	u8 rd_idx;	/* index into spi_read_cmds_array[] */
+	u32 support;	/* support bit in DWORD1 */
+	u8 dword;	/* BFPT DWORD holding opcode and wait states */
+	u8 shift;
+	u8 addr_lanes;
+} sfdp_read_modes[] = {
+	{ 2, BFPT_DW1_FAST_READ_1_1_2, 4, 0, 1 },
+	{ 3, BFPT_DW1_FAST_READ_1_2_2, 4, 16, 2 },
+	{ 4, BFPT_DW1_FAST_READ_1_1_4, 3, 16, 1 },
+	{ 5, BFPT_DW1_FAST_READ_1_4_4, 3, 0, 4 },
+};
+
+struct sfdp_erase_type {
+	u32 size;
+	u8 cmd;
+	u8 cmd_4b;	/* 0 if there is no 4-byte address variant */
+};
+
+/**
+ * struct spi_flash_sfdp - parameters discovered through SFDP
+ *
+ * @size:	Flash size in bytes
+ * @page_size:	Page size in bytes, 0 if not described
+ * @addr_bytes:	BFPT_DW1_ADDR_BYTES_... value
+ * @e_rd_cmd:	Supported read commands (enum spi_read_cmds)
+ * @rd_dummy:	Dummy bytes for each supported read command
+ * @bait:	4-byte address instruction support bits, 0 if not described
+ * @erase_types: Number of valid entries in @erase
+ * @erase:	Supported erase commands, smallest first
+ */
+struct spi_flash_sfdp {
+	u32 size;
+	u32 page_size;
+	u32 addr_bytes;
+	u8 e_rd_cmd;
+	u8 rd_dummy[ARRAY_SIZE(spi_read_cmds_array)];
+	u32 bait;
+	int erase_types;
+	struct sfdp_erase_type erase[SPI_FLASH_MAX_ERASE_TYPES];
+};
+
+static int spi_flash_read_sfdp(struct spi_flash *flash, u32 addr, void *buf,
+			       size_t len)
+{
+	u8 cmd[5];
+
+	cmd[0] = CMD_READ_SFDP;
+	cmd[1] = addr >> 16;
+	cmd[2] = addr >> 8;
+	cmd[3] = addr >> 0;
+	cmd[4] = 0x00;	/* 8 dummy cycles */
+
+	return spi_flash_read_common(flash, cmd, sizeof(cmd), buf, len);
+}
+
+static void sfdp_add_erase_type(struct spi_flash_sfdp *sfdp, u32 size, u8 cmd,
+				u8 cmd_4b)
+{
+	int i;
+
+	for (i = sfdp->erase_types; i > 0; i--) {
+		if (sfdp->erase[i - 1].size <= size)
+			break;
+		sfdp->erase[i] = sfdp->erase[i - 1];
+	}
+	sfdp->erase[i].size = size;
+	sfdp->erase[i].cmd = cmd;
+	sfdp->erase[i].cmd_4b = cmd_4b;
+	sfdp->erase_types++;
+}
+
+static int spi_flash_parse_bfpt(const u32 *bfpt, int dwords, u32 bait,
+				u32 bait_erase, struct spi_flash_sfdp *sfdp)
+{
+	u32 val;
+	int i;
+
+	/* Density, in bits */
+	val = bfpt[1];
+	if (val & (1 << 31)) {
+		val &= ~(1 << 31);
+		if (val < 3 || val > 34)
+			return -EINVAL;
+		sfdp->size = 1 << (val - 3);
+	} else {
+		sfdp->size = (val + 1) / 8;
+	}
+
+	sfdp->addr_bytes = bfpt[0] & BFPT_DW1_ADDR_BYTES_MASK;
+	sfdp->bait = bait;
+
+	/* Single-lane reads are always there: 0 and 8 dummy cycles */
+	sfdp->e_rd_cmd = ARRAY_SLOW | ARRAY_FAST;
+	sfdp->rd_dummy[1] = 1;
+	for (i = 0; i < ARRAY_SIZE(sfdp_read_modes); i++) {
+		int idx = sfdp_read_modes[i].rd_idx;
+		uint bits;
+
+		if (!(bfpt[0] & sfdp_read_modes[i].support))
+			continue;
+
+		val = bfpt[sfdp_read_modes[i].dword - 1] >>
+			sfdp_read_modes[i].shift;
+		/* Wait states (4:0) plus mode clocks (7:5), then opcode */
+		bits = ((val & 0x1f) + ((val >> 5) & 0x7)) *
+			sfdp_read_modes[i].addr_lanes;
+		if (((val >> 8) & 0xff) != spi_read_cmds_array[idx] ||
+		    bits % 8)
+			continue;
+
+		sfdp->e_rd_cmd |= 1 << idx;
+		sfdp->rd_dummy[idx] = bits / 8;
+	}
+
+	/* Erase types 1-4 are in DWORD8 and DWORD9: size as 2^N, opcode */
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES; i++) {
+		u8 cmd_4b = 0;
+
+		val = bfpt[7 + i / 2] >> (16 * (i % 2));
+		if (!(val & 0xff) || (val & 0xff) > 31)
+			continue;
+		if (bait & BAIT_ERASE_TYPE(i))
+			cmd_4b = bait_erase >> (8 * i);
+		sfdp_add_erase_type(sfdp, 1 << (val & 0xff), val >> 8, cmd_4b);
+	}
+	if (!sfdp->erase_types &&
+	    (bfpt[0] & BFPT_DW1_ERASE_4K_MASK) == BFPT_DW1_ERASE_4K)
+		sfdp_add_erase_type(sfdp, 4096, bfpt[0] >> 8, 0);
+
+	/* The page size was added in JESD216 revision A */
+	if (dwords >= 11)
+		sfdp->page_size = 1 << ((bfpt[10] >> 4) & 0xf);
+
+	return 0;
+}
+
+static int spi_flash_parse_sfdp(struct spi_flash *flash,
+				struct spi_flash_sfdp *sfdp)
+{
+	struct sfdp_header hdr;
+	struct sfdp_param_header ph;
+	u32 bfpt[SFDP_BFPT_MAX_DWORDS];
+	u32 bfpt_ptr = 0, bait_ptr = 0, ptr;
+	u32 bait[2] = { 0, 0 };
+	int dwords = 0;
+	int i, ret;
+
+	memset(sfdp, '\0', sizeof(*sfdp));
+
+	ret = spi_flash_read_sfdp(flash, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (le32_to_cpu(hdr.signature) != SFDP_SIGNATURE || hdr.major != 1)
+		return -ENOENT;
+
+	for (i = 0; i <= hdr.nph; i++) {
+		ret = spi_flash_read_sfdp(flash, sizeof(hdr) + i * sizeof(ph),
+					  &ph, sizeof(ph));
+		if (ret)
+			return ret;
+
+		ptr = ph.ptr[2] << 16 | ph.ptr[1] << 8 | ph.ptr[0];
+		switch (ph.id_msb << 8 | ph.id_lsb) {
+		case SFDP_PARAM_BFPT:
+			/* Later headers describe newer revisions */
+			if (ph.major != 1 || ph.length < SFDP_BFPT_MIN_DWORDS)
+				break;
+			bfpt_ptr = ptr;
+			dwords = min_t(int, ph.length, SFDP_BFPT_MAX_DWORDS);
+			break;
+		case SFDP_PARAM_4BAIT:
+			if (ph.length >= ARRAY_SIZE(bait))
+				bait_ptr = ptr;
+			break;
+		}
+	}
+	if (!dwords)
+		return -ENOENT;
+
+	memset(bfpt, '\0', sizeof(bfpt));
+	ret = spi_flash_read_sfdp(flash, bfpt_ptr, bfpt, dwords * 4);
+	if (ret)
+		return ret;
+	for (i = 0; i < dwords; i++)
+		bfpt[i] = le32_to_cpu(bfpt[i]);
+
+	if (bait_ptr) {
+		ret = spi_flash_read_sfdp(flash, bait_ptr, bait, sizeof(bait));
+		if (ret)
+			return ret;
+		bait[0] = le32_to_cpu(bait[0]);
+		bait[1] = le32_to_cpu(bait[1]);
+	}
+
+	return spi_flash_parse_bfpt(bfpt, dwords, bait[0], bait[1], sfdp);
+}
+
+/* Whether spi_flash_set_qeb() knows how to enable quad mode */
+static bool spi_flash_has_qeb(u8 idcode0)
+{
+	switch (idcode0) {
+#ifdef CONFIG_SPI_FLASH_MACRONIX
+	case SPI_FLASH_CFI_MFR_MACRONIX:
+#endif
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+	case SPI_FLASH_CFI_MFR_SPANSION:
+	case SPI_FLASH_CFI_MFR_WINBOND:
+#endif
+#ifdef CONFIG_SPI_FLASH_STMICRO
+	case SPI_FLASH_CFI_MFR_STMICRO:
+#endif
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Describe a flash which is not in spi_flash_params_table from its SFDP */
+static int spi_flash_sfdp_params(const struct spi_flash_sfdp *sfdp,
+				 const u8 *idcode,
+				 struct spi_flash_params *params)
+{
+	const struct sfdp_erase_type *erase;
+	int i;
+
+	if (!sfdp->size || !sfdp->erase_types)
+		return -EINVAL;
+
+	/* Use the 64KiB erase if there is one, else the largest */
+	erase = &sfdp->erase[sfdp->erase_types - 1];
+	for (i = 0; i < sfdp->erase_types; i++) {
+		if (sfdp->erase[i].size == 65536)
+			erase = &sfdp->erase[i];
+	}
+
+	memset(params, '\0', sizeof(*params));
+	params->name = "SFDP";
+	params->jedec = idcode[0] << 16 | idcode[1] << 8 | idcode[2];
+	params->sector_size = erase->size;
+	params->nr_sectors = sfdp->size / erase->size;
+	params->e_rd_cmd = sfdp->e_rd_cmd;
+	if (sfdp->erase[0].size == 4096 && sfdp->erase[0].cmd == CMD_ERASE_4K)
+		params->flags |= SECT_4K;
+
+	return 0;
+}
+
+/*
+ * Use what SFDP tells us on top of the table: exact read dummy cycles, page
+ * size, larger erase commands and 4-byte addressing.
+ */
+static void spi_flash_apply_sfdp(struct spi_flash *flash,
+				 const struct spi_flash_sfdp *sfdp, int rd_idx)
+{
+	const struct sfdp_erase_type *erase;
+	u8 erase_cmd_4b = 0;
+	u32 size;
+	bool use_4b;
+	int i, n = 0;
+
+	if (sfdp->e_rd_cmd & (1 << rd_idx))
+		flash->dummy_byte = sfdp->rd_dummy[rd_idx];
+
+	if (sfdp->page_size)
+		flash->page_size = sfdp->page_size << flash->shift;
+
+	for (i = 0; i < sfdp->erase_types; i++) {
+		erase = &sfdp->erase[i];
+		size = erase->size << flash->shift;
+		if (size == flash->erase_size) {
+			flash->erase_cmd = erase->cmd;
+			erase_cmd_4b = erase->cmd_4b;
+		}
+		if (size <= flash->erase_size || size % flash->erase_size ||
+		    size > flash->size)
+			continue;
+		flash->erase_type_cmd[n] = erase->cmd;
+		flash->erase_type_size[n] = size;
+		n++;
+	}
+	flash->erase_types = n;
+
+	if (sfdp->addr_bytes == BFPT_DW1_ADDR_BYTES_4_ONLY) {
+		flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+		return;
+	}
+
+	/*
+	 * Above 16MiB, switch to the 4-byte address commands if the flash
+	 * has all the ones we need. This leaves the flash in its power-on
+	 * address mode, unlike entering 4-byte mode with CMD 0xb7.
+	 */
+	if (sfdp->addr_bytes != BFPT_DW1_ADDR_BYTES_3_OR_4 ||
+	    sfdp->size <= SPI_FLASH_16MB_BOUN)
+		return;
+
+	use_4b = (sfdp->bait & (1 << rd_idx)) && erase_cmd_4b;
+	if (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)
+		use_4b &= !!(sfdp->bait & BAIT_QUAD_PAGE_PROGRAM);
+	else
+		use_4b &= !!(sfdp->bait & BAIT_PAGE_PROGRAM);
+	if (!use_4b)
+		return;
+
+	flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+	flash->read_cmd = spi_read_cmds_4b_array[rd_idx];
+	flash->write_cmd = flash->write_cmd == CMD_QUAD_PAGE_PROGRAM ?
+		CMD_QUAD_PAGE_PROGRAM_4B : CMD_PAGE_PROGRAM_4B;
+	flash->erase_cmd = erase_cmd_4b;
+
+	/* Drop the larger erase commands which have no 4-byte variant */
+	for (i = 0, n = 0; i < flash->erase_types; i++) {
+		for (erase = sfdp->erase; erase->cmd != flash->erase_type_cmd[i];
+		     erase++)
+			;
+		if (!erase->cmd_4b)
+			continue;
+		flash->erase_type_cmd[n] = erase->cmd_4b;
+		flash->erase_type_size[n] = flash->erase_type_size[i];
+		n++;
+	}
+	flash->erase_types = n;
+}
+#endif /* CONFIG_SPI_FLASH_SFDP */
+
 static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 				     struct spi_flash *flash)
 {
 	const struct spi_flash_params *params;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	struct spi_flash_params sfdp_params;
+	struct spi_flash_sfdp sfdp;
+	bool has_sfdp;
+#endif
+	u8 e_rd_cmd;
+	int rd_idx;
 	u8 cmd;
 	u16 jedec = idcode[1] << 8 | idcode[2];
 	u16 ext_jedec = idcode[3] << 8 | idcode[4];
@@ -120,6 +507,18 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 		}
 	}
 
+	flash->spi = spi;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	/* Dual flash setups would mix up the tables of the two chips */
+	has_sfdp = spi->option == SF_SINGLE_FLASH &&
+		!spi_flash_parse_sfdp(flash, &sfdp);
+	if (has_sfdp && !spi_flash_has_qeb(idcode[0]))
+		sfdp.e_rd_cmd &= ~(QUAD_OUTPUT_FAST | QUAD_IO_FAST);
+	if (!params->name && has_sfdp &&
+	    !spi_flash_sfdp_params(&sfdp, idcode, &sfdp_params))
+		params = &sfdp_params;
+#endif
+
 	if (!params->name) {
 		printf("SF: Unsupported flash IDs: ");
 		printf("manuf %02x, jedec %04x, ext_jedec %04x\n",
@@ -128,7 +527,6 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 	}
 
 	/* Assign spi data */
-	flash->spi = spi;
 	flash->name = params->name;
 	flash->memory_map = spi->memory_map;
 	flash->dual_flash = flash->spi->option;
@@ -191,14 +589,19 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 	flash->sector_size = flash->erase_size;
 
 	/* Look for the fastest read cmd */
-	cmd = fls(params->e_rd_cmd & flash->spi->op_mode_rx);
+	e_rd_cmd = params->e_rd_cmd;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (has_sfdp)
+		e_rd_cmd |= sfdp.e_rd_cmd;
+#endif
+	cmd = fls(e_rd_cmd & flash->spi->op_mode_rx);
 	if (cmd) {
-		cmd = spi_read_cmds_array[cmd - 1];
-		flash->read_cmd = cmd;
+		rd_idx = cmd - 1;
 	} else {
 		/* Go for default supported read cmd */
-		flash->read_cmd = CMD_READ_ARRAY_FAST;
+		rd_idx = 1;
 	}
+	flash->read_cmd = spi_read_cmds_array[rd_idx];
 
 	/* Not require to look for fastest only two write cmds yet */
 	if (params->flags & WR_QPP && flash->spi->op_mode_tx & SPI_OPM_TX_QPP)
@@ -217,7 +620,8 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 	 */
 	switch (flash->read_cmd) {
 	case CMD_READ_QUAD_IO_FAST:
-		flash->dummy_byte = 2;
+		/* 2 mode cycles + 4 dummy cycles on 4 lines */
+		flash->dummy_byte = 3;
 		break;
 	case CMD_READ_ARRAY_SLOW:
 		flash->dummy_byte = 0;
@@ -226,6 +630,12 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 		flash->dummy_byte = 1;
 	}
 
+	flash->addr_width = SPI_FLASH_3B_ADDR_LEN;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (has_sfdp)
+		spi_flash_apply_sfdp(flash, &sfdp, rd_idx);
+#endif
+
 	/* Poll cmd selection */
 	flash->poll_cmd = CMD_READ_STATUS;
 #ifdef CONFIG_SPI_FLASH_STMICRO
@@ -236,7 +646,8 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 	/* Configure the BAR - discover bank cmds and read current bank */
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 curr_bank = 0;
-	if (flash->size > SPI_FLASH_16MB_BOUN) {
+	if (flash->size > SPI_FLASH_16MB_BOUN &&
+	    flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
 		int ret;
 
 		flash->bank_read_cmd = (idcode[0] == 0x01) ?
@@ -339,7 +750,10 @@ int spi_flash_probe_slave(struct spi_slave *spi, struct spi_flash *flash)
 	/* Set the quad enable bit - only for quad commands */
 	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
 	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
+	    (flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST_4B) ||
+	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST_4B) ||
+	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM) ||
+	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM_4B)) {
 		if (spi_flash_set_qeb(flash, idcode[0])) {
 			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
 			ret = -EINVAL;
@@ -364,10 +778,11 @@ int spi_flash_probe_slave(struct spi_slave *spi, struct spi_flash *flash)
 	puts("\n");
 #endif
 #ifndef CONFIG_SPI_FLASH_BAR
-	if (((flash->dual_flash == SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN)) ||
+	if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN &&
+	    (((flash->dual_flash == SF_SINGLE_FLASH) &&
+	      (flash->size > SPI_FLASH_16MB_BOUN)) ||
 	     ((flash->dual_flash > SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN << 1))) {
+	      (flash->size > SPI_FLASH_16MB_BOUN << 1)))) {
 		puts("SF: Warning - Only lower 16MiB accessible,");
 		puts(" Full access #define CONFIG_SPI_FLASH_BAR\n");
 	}
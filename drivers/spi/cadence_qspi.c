@@ -272,6 +272,28 @@ static int cadence_spi_xfer(struct udevice *dev, unsigned int bitlen,
 	return err;
 }
 
+static int cadence_spi_mem_read(struct udevice *dev,
+				const struct spi_mem_read *op)
+{
+	struct udevice *bus = dev->parent;
+	struct cadence_spi_platdata *plat = bus->platdata;
+	struct cadence_spi_priv *priv = dev_get_priv(bus);
+
+	cadence_qspi_apb_chipselect(priv->regbase, spi_chip_select(dev),
+				    CONFIG_CQSPI_DECODER);
+	cadence_qspi_apb_mem_read_setup(plat, op);
+
+	/*
+	 * If the flash is memory-mapped over the range, read it directly.
+	 * Otherwise use the indirect engine, which still does the whole
+	 * read in one transfer.
+	 */
+	if (op->addr + op->len <= plat->mmap_size)
+		return cadence_qspi_apb_direct_read_execute(plat, op);
+
+	return cadence_qspi_apb_indirect_mem_read(plat, op);
+}
+
 static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 {
 	struct cadence_spi_platdata *plat = bus->platdata;
@@ -279,6 +301,7 @@ static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 	int node = bus->of_offset;
 	int subnode;
 	u32 data[4];
+	u32 mmap[2];
 	int ret;
 
 	/* 2 base addresses are needed, lets get them from the DT */
@@ -291,6 +314,13 @@ static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 	plat->regbase = (void *)data[0];
 	plat->ahbbase = (void *)data[2];
 
+	/* The memory-mapped flash window for direct reads is optional */
+	if (!fdtdec_get_int_array(blob, node, "cadence,mmap", mmap,
+				  ARRAY_SIZE(mmap))) {
+		plat->mmap_base = (void *)mmap[0];
+		plat->mmap_size = mmap[1];
+	}
+
 	/* Use 500KHz as a suitable default */
 	plat->max_hz = fdtdec_get_int(blob, node, "spi-max-frequency",
 				      500000);
@@ -311,9 +341,10 @@ static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 	plat->tslch_ns = fdtdec_get_int(blob, subnode, "tslch-ns", 20);
 	plat->sram_size = fdtdec_get_int(blob, node, "sram-size", 128);
 
-	debug("%s: regbase=%p ahbbase=%p max-frequency=%d page-size=%d\n",
-	      __func__, plat->regbase, plat->ahbbase, plat->max_hz,
-	      plat->page_size);
+	debug("%s: regbase=%p ahbbase=%p mmap=%p/%#x max-frequency=%d page-size=%d\n",
+	      __func__, plat->regbase, plat->ahbbase, plat->mmap_base,
+	      plat->mmap_size,
+	      plat->max_hz, plat->page_size);
 
 	return 0;
 }
@@ -322,6 +353,7 @@ static const struct dm_spi_ops cadence_spi_ops = {
 	.xfer		= cadence_spi_xfer,
 	.set_speed	= cadence_spi_set_speed,
 	.set_mode	= cadence_spi_set_mode,
+	.mem_read	= cadence_spi_mem_read,
 	/*
 	 * cs_info is not needed, since we require all chip selects to be
 	 * in the device tree explicitly
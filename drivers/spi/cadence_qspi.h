@@ -8,6 +8,8 @@
 #ifndef __CADENCE_QSPI_H__
 #define __CADENCE_QSPI_H__
 
+struct spi_mem_read;
+
 #define CQSPI_IS_ADDR(cmd_len)		(cmd_len > 1 ? 1 : 0)
 
 #define CQSPI_NO_DECODER_MAX_CS		4
@@ -18,6 +20,8 @@ struct cadence_spi_platdata {
 	unsigned int	max_hz;
 	void		*regbase;
 	void		*ahbbase;
+	void		*mmap_base;	/* memory-mapped flash, if any */
+	u32		mmap_size;
 
 	u32		page_size;
 	u32		block_size;
@@ -55,6 +59,12 @@ int cadence_qspi_apb_indirect_read_setup(struct cadence_spi_platdata *plat,
 	unsigned int cmdlen, const u8 *cmdbuf);
 int cadence_qspi_apb_indirect_read_execute(struct cadence_spi_platdata *plat,
 	unsigned int rxlen, u8 *rxbuf);
+void cadence_qspi_apb_mem_read_setup(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op);
+int cadence_qspi_apb_direct_read_execute(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op);
+int cadence_qspi_apb_indirect_mem_read(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op);
 int cadence_qspi_apb_indirect_write_setup(struct cadence_spi_platdata *plat,
 	unsigned int cmdlen, const u8 *cmdbuf);
 int cadence_qspi_apb_indirect_write_execute(struct cadence_spi_platdata *plat,
@@ -26,6 +26,7 @@
  */
 
 #include <common.h>
+#include <spi.h>
 #include <asm/io.h>
 #include <asm/errno.h>
 #include "cadence_qspi.h"
@@ -778,6 +779,84 @@ failrd:
 	return -1;
 }
 
+static unsigned int cadence_qspi_apb_lanes_to_type(unsigned int lanes)
+{
+	switch (lanes) {
+	case 4:
+		return CQSPI_INST_TYPE_QUAD;
+	case 2:
+		return CQSPI_INST_TYPE_DUAL;
+	default:
+		return CQSPI_INST_TYPE_SINGLE;
+	}
+}
+
+/* Program the read instruction used by both direct and indirect reads */
+void cadence_qspi_apb_mem_read_setup(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op)
+{
+	unsigned int reg;
+	unsigned int rd_reg;
+	unsigned int dummy_clk = op->dummy_cycles;
+	unsigned int mode_clk = CQSPI_DUMMY_CLKS_PER_BYTE / op->addr_lanes;
+
+	rd_reg = op->opcode << CQSPI_REG_RD_INSTR_OPCODE_LSB;
+	rd_reg |= cadence_qspi_apb_lanes_to_type(op->addr_lanes) <<
+		CQSPI_REG_RD_INSTR_TYPE_ADDR_LSB;
+	rd_reg |= cadence_qspi_apb_lanes_to_type(op->data_lanes) <<
+		CQSPI_REG_RD_INSTR_TYPE_DATA_LSB;
+
+	/*
+	 * Send the first dummy byte as mode bits of 0xFF, so that the flash
+	 * never enters continuous read (XIP) mode behind our back.
+	 */
+	if (dummy_clk >= mode_clk) {
+		rd_reg |= (1 << CQSPI_REG_RD_INSTR_MODE_EN_LSB);
+		writel(0xFF, plat->regbase + CQSPI_REG_MODE_BIT);
+		dummy_clk -= mode_clk;
+	}
+	if (dummy_clk)
+		rd_reg |= (dummy_clk & CQSPI_REG_RD_INSTR_DUMMY_MASK)
+			<< CQSPI_REG_RD_INSTR_DUMMY_LSB;
+
+	writel(rd_reg, plat->regbase + CQSPI_REG_RD_INSTR);
+
+	/* set device size */
+	reg = readl(plat->regbase + CQSPI_REG_SIZE);
+	reg &= ~CQSPI_REG_SIZE_ADDRESS_MASK;
+	reg |= (op->addr_len - 1);
+	writel(reg, plat->regbase + CQSPI_REG_SIZE);
+}
+
+int cadence_qspi_apb_direct_read_execute(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op)
+{
+	unsigned int reg;
+
+	/* Make sure the direct access controller is enabled */
+	reg = readl(plat->regbase + CQSPI_REG_CONFIG);
+	if (!(reg & CQSPI_REG_CONFIG_DIRECT_MASK)) {
+		reg |= CQSPI_REG_CONFIG_DIRECT_MASK;
+		writel(reg, plat->regbase + CQSPI_REG_CONFIG);
+	}
+
+	memcpy_fromio(op->buf, plat->mmap_base + op->addr, op->len);
+
+	return 0;
+}
+
+int cadence_qspi_apb_indirect_mem_read(struct cadence_spi_platdata *plat,
+	const struct spi_mem_read *op)
+{
+	/* Setup the indirect trigger address */
+	writel(((u32)plat->ahbbase & CQSPI_INDIRECTTRIGGER_ADDR_MASK),
+	       plat->regbase + CQSPI_REG_INDIRECTTRIGGER);
+
+	writel(op->addr, plat->regbase + CQSPI_REG_INDIRECTRDSTARTADDR);
+
+	return cadence_qspi_apb_indirect_read_execute(plat, op->len, op->buf);
+}
+
 /* Opcode + Address (3/4 bytes) */
 int cadence_qspi_apb_indirect_write_setup(struct cadence_spi_platdata *plat,
 	unsigned int cmdlen, const u8 *cmdbuf)
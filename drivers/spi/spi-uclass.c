@@ -95,6 +95,18 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen,
 	return spi_get_ops(bus)->xfer(dev, bitlen, dout, din, flags);
 }
 
+int spi_mem_read(struct spi_slave *slave, const struct spi_mem_read *op)
+{
+	struct udevice *dev = slave->dev;
+	struct udevice *bus = dev->parent;
+	struct dm_spi_ops *ops = spi_get_ops(bus);
+
+	if (!ops->mem_read)
+		return -ENOSYS;
+
+	return ops->mem_read(dev, op);
+}
+
 static int spi_post_bind(struct udevice *dev)
 {
 	/* Scan the bus for devices */
@@ -138,6 +150,20 @@ static int spi_child_pre_probe(struct udevice *dev)
 	slave->max_hz = plat->max_hz;
 	slave->mode = plat->mode;
 
+	/*
+	 * spi_xfer() does not say how many lanes to use, so dual/quad reads
+	 * need the mem_read() op. Quad page program has no such op yet: a
+	 * driver which can do it sets SPI_OPM_TX_QPP in its child_pre_probe().
+	 */
+	slave->op_mode_rx = SPI_OPM_RX_AS | SPI_OPM_RX_AF;
+	if (spi_get_ops(dev->parent)->mem_read) {
+		if (plat->mode & (SPI_RX_DUAL | SPI_RX_QUAD))
+			slave->op_mode_rx |= SPI_OPM_RX_DOUT | SPI_OPM_RX_DIO;
+		if (plat->mode & SPI_RX_QUAD)
+			slave->op_mode_rx |= SPI_OPM_RX_QOF | SPI_OPM_RX_QIOF;
+	}
+	slave->op_mode_tx = 0;
+
 	return 0;
 }
 
@@ -360,6 +386,22 @@ int spi_slave_ofdata_to_platdata(const void *blob, int node,
 		mode |= SPI_CS_HIGH;
 	if (fdtdec_get_bool(blob, node, "spi-half-duplex"))
 		mode |= SPI_PREAMBLE;
+	switch (fdtdec_get_int(blob, node, "spi-tx-bus-width", 1)) {
+	case 2:
+		mode |= SPI_TX_DUAL;
+		break;
+	case 4:
+		mode |= SPI_TX_QUAD;
+		break;
+	}
+	switch (fdtdec_get_int(blob, node, "spi-rx-bus-width", 1)) {
+	case 2:
+		mode |= SPI_RX_DUAL;
+		break;
+	case 4:
+		mode |= SPI_RX_QUAD;
+		break;
+	}
 	plat->mode = mode;
 
 	return 0;
@@ -57,6 +57,36 @@ static unsigned int download_size;
 static unsigned int download_bytes;
 static bool is_high_speed;
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+#ifndef CONFIG_FASTBOOT_STREAM_BUF_SIZE
+#define CONFIG_FASTBOOT_STREAM_BUF_SIZE	(1024 * 1024)
+#endif
+
+/* Largest download accepted once streaming is armed */
+#define FASTBOOT_STREAM_MAX_SIZE	0xffffffff
+
+/*
+ * "oem stream <partition>" arms streaming for the next download: instead
+ * of being stored whole in the download buffer, the image is received
+ * alternately into two CONFIG_FASTBOOT_STREAM_BUF_SIZE staging buffers at
+ * its start. Once one is full, the request for the other one is queued and
+ * the full one is flashed while the controller receives. The following
+ * "flash" command just reports the result.
+ */
+#define STREAM_BUF(i)	((void *)CONFIG_FASTBOOT_BUF_ADDR + \
+			 (i) * CONFIG_FASTBOOT_STREAM_BUF_SIZE)
+
+static char stream_part[32 + 1];
+static bool stream_armed;
+static bool stream_active;
+static bool stream_done;
+static int stream_err;
+static unsigned int stream_cur;		/* Staging buffer being filled */
+static unsigned int stream_fill;	/* Bytes received into it */
+static void *stream_req_buf;		/* out_req's own buffer */
+static char stream_response[RESPONSE_LEN];
+#endif
+
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
 	.bDescriptorType    = USB_DT_ENDPOINT,
@@ -184,6 +214,14 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->in_ep);
 
 	if (f_fb->out_req) {
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+		/* The request may still point into a staging buffer */
+		if (stream_req_buf) {
+			f_fb->out_req->buf = stream_req_buf;
+			stream_req_buf = NULL;
+			stream_active = false;
+		}
+#endif
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 		f_fb->out_req = NULL;
@@ -355,6 +393,15 @@ static int strcmp_l1(const char *s1, const char *s2)
 	return strncmp(s1, s2, strlen(s1));
 }
 
+static unsigned int max_download_size(void)
+{
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (stream_armed || stream_active)
+		return FASTBOOT_STREAM_MAX_SIZE;
+#endif
+	return CONFIG_FASTBOOT_BUF_SIZE;
+}
+
 static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
@@ -380,7 +427,7 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		!strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
-		sprintf(str_num, "0x%08x", CONFIG_FASTBOOT_BUF_SIZE);
+		sprintf(str_num, "0x%08x", max_download_size());
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = getenv("serial#");
@@ -412,6 +459,39 @@ static unsigned int rx_bytes_expected(unsigned int maxpacket)
 	return rx_remain;
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static void stream_write(const void *buf, unsigned int len)
+{
+	/* After a failure the rest of the download is dropped */
+	if (len && !stream_err)
+		stream_err = fb_mmc_stream_write(buf, len, stream_response);
+}
+
+/* Receive the next data straight into the current staging buffer */
+static void stream_rx_setup(struct usb_request *req, unsigned int maxpacket)
+{
+	unsigned int len;
+
+	len = min(download_size - download_bytes,
+		  CONFIG_FASTBOOT_STREAM_BUF_SIZE - stream_fill);
+	req->buf = STREAM_BUF(stream_cur) + stream_fill;
+	req->length = roundup(len, maxpacket);
+}
+
+static void stream_end(char *response)
+{
+	stream_write(STREAM_BUF(stream_cur), stream_fill);
+	/* Frees the stream buffers even after a failure */
+	fb_mmc_stream_finish(stream_response);
+	strcpy(response, stream_response);
+
+	stream_active = false;
+	stream_done = !stream_err;
+	/* The image never went to the download buffer, so don't flash it */
+	download_bytes = 0;
+}
+#endif
+
 #define BYTES_PER_DOT	0x20000
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
@@ -421,6 +501,9 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	unsigned int buffer_size = req->actual;
 	unsigned int pre_dot_num, now_dot_num;
 	unsigned int max;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	void *full_buf = NULL;
+#endif
 
 	if (req->status != 0) {
 		printf("Bad status: %d\n", req->status);
@@ -430,6 +513,12 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/* The data has been received in place */
+	if (stream_active)
+		stream_fill += transfer_size;
+	else
+#endif
 	memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
 	       buffer, transfer_size);
 
@@ -453,13 +542,30 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		req->complete = rx_handler_command;
 		req->length = EP_BUFFER_SIZE;
 
+		printf("\ndownloading of %d bytes finished\n", download_bytes);
+
 		sprintf(response, "OKAY");
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+		if (stream_active) {
+			req->buf = stream_req_buf;
+			stream_req_buf = NULL;
+			stream_end(response);
+		}
+#endif
 		fastboot_tx_write_str(response);
-
-		printf("\ndownloading of %d bytes finished\n", download_bytes);
 	} else {
 		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
 				fs_ep_out.wMaxPacketSize;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+		if (stream_active) {
+			if (stream_fill == CONFIG_FASTBOOT_STREAM_BUF_SIZE) {
+				full_buf = STREAM_BUF(stream_cur);
+				stream_cur = !stream_cur;
+				stream_fill = 0;
+			}
+			stream_rx_setup(req, max);
+		} else
+#endif
 		req->length = rx_bytes_expected(max);
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
@@ -467,7 +573,48 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 
 	req->actual = 0;
 	usb_ep_queue(ep, req, 0);
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/*
+	 * Flash a full buffer only once the request for the other one is
+	 * queued, so that the controller keeps receiving meanwhile.
+	 */
+	if (full_buf)
+		stream_write(full_buf, CONFIG_FASTBOOT_STREAM_BUF_SIZE);
+#endif
+}
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static int stream_start(char *response)
+{
+	int ret;
+
+	stream_done = false;
+	if (!stream_armed)
+		return 0;
+
+	stream_armed = false;
+	/* Room for the staging buffers and a padded last packet */
+	if (2 * CONFIG_FASTBOOT_STREAM_BUF_SIZE + EP_BUFFER_SIZE >
+	    CONFIG_FASTBOOT_BUF_SIZE) {
+		sprintf(response, "FAILdownload buffer too small to stream");
+		return -ENOMEM;
+	}
+
+	ret = fb_mmc_stream_start(stream_part, response);
+	if (ret)
+		return ret;
+
+	stream_active = true;
+	stream_err = 0;
+	stream_cur = 0;
+	stream_fill = 0;
+	stream_response[0] = '\0';
+	printf("Streaming download to '%s'\n", stream_part);
+
+	return 0;
 }
+#endif
 
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
@@ -483,7 +630,11 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_FASTBOOT_BUF_SIZE) {
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	} else if (stream_start(response)) {
+		download_size = 0;
+#endif
+	} else if (download_size > max_download_size()) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
 	} else {
@@ -491,6 +642,12 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 		req->complete = rx_handler_dl_image;
 		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
 			fs_ep_out.wMaxPacketSize;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+		if (stream_active) {
+			stream_req_buf = req->buf;
+			stream_rx_setup(req, max);
+		} else
+#endif
 		req->length = rx_bytes_expected(max);
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
@@ -542,6 +699,23 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 		return;
 	}
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/* The image has already been written while it was downloaded */
+	if (stream_done) {
+		stream_done = false;
+		if (strcmp(cmd, stream_part))
+			fastboot_tx_write_str("FAILimage was streamed to another partition");
+		else
+			fastboot_tx_write_str("OKAY");
+		return;
+	}
+#endif
+
+	if (!download_bytes) {
+		fastboot_tx_write_str("FAILno image downloaded");
+		return;
+	}
+
 	strcpy(response, "FAILno flash device defined");
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	fb_mmc_flash_write(cmd, (void *)CONFIG_FASTBOOT_BUF_ADDR,
@@ -564,6 +738,13 @@ static void cb_oem(struct usb_ep *ep, struct usb_request *req)
                 else
 			fastboot_tx_write_str("OKAY");
 	} else
+#endif
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (strncmp("stream ", cmd + 4, 7) == 0) {
+		strlcpy(stream_part, cmd + 11, sizeof(stream_part));
+		stream_armed = true;
+		fastboot_tx_write_str("OKAY");
+	} else
 #endif
 	if (strncmp("unlock", cmd + 4, 8) == 0) {
 		fastboot_tx_write_str("FAILnot implemented");
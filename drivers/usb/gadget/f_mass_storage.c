@@ -836,6 +836,7 @@ static int do_write(struct fsg_common *common)
 	unsigned int		partial_page;
 	ssize_t			nwritten;
 	int			rc;
+	int			fua = 0;
 
 	if (curlun->ro) {
 		curlun->sense_data = SS_WRITE_PROTECTED;
@@ -852,11 +853,12 @@ static int do_write(struct fsg_common *common)
 		/* We allow DPO (Disable Page Out = don't save data in the
 		 * cache) and FUA (Force Unit Access = write directly to the
 		 * medium).  We don't implement DPO; we implement FUA by
-		 * performing synchronous output. */
+		 * flushing the written data before returning the status. */
 		if (common->cmnd[1] & ~0x18) {
 			curlun->sense_data = SS_INVALID_FIELD_IN_CDB;
 			return -EINVAL;
 		}
+		fua = common->cmnd[1] & 0x08;
 	}
 	if (lba >= curlun->num_sectors) {
 		curlun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
@@ -994,6 +996,9 @@ static int do_write(struct fsg_common *common)
 			return rc;
 	}
 
+	if (fua && fsg_lun_fsync_sub(curlun) && !curlun->sense_data)
+		curlun->sense_data = SS_WRITE_ERROR;
+
 	return -EIO;		/* No default reply */
 }
 
@@ -1001,6 +1006,11 @@ static int do_write(struct fsg_common *common)
 
 static int do_synchronize_cache(struct fsg_common *common)
 {
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+
+	/* We ignore the requested LBA and write out all dirty data */
+	if (fsg_lun_fsync_sub(curlun))
+		curlun->sense_data = SS_WRITE_ERROR;
 	return 0;
 }
 
@@ -1042,6 +1052,7 @@ static int do_verify(struct fsg_common *common)
 	file_offset = ((loff_t) lba) << 9;
 
 	/* Write out all the dirty buffers before invalidating them */
+	fsg_lun_fsync_sub(curlun);
 
 	/* Just try to read the requested blocks */
 	while (amount_left > 0) {
@@ -1328,9 +1339,16 @@ static int do_start_stop(struct fsg_common *common)
 {
 	struct fsg_lun	*curlun = &common->luns[common->lun];
 
-	if (!curlun) {
+	if (!curlun)
 		return -EINVAL;
-	} else if (!curlun->removable) {
+
+	/* Whether or not we can eject, the host is done with the medium */
+	if (!(common->cmnd[4] & 0x01) && fsg_lun_fsync_sub(curlun)) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		return -EINVAL;
+	}
+
+	if (!curlun->removable) {
 		curlun->sense_data = SS_INVALID_COMMAND;
 		return -EINVAL;
 	}
@@ -2379,6 +2397,9 @@ static void handle_exception(struct fsg_common *common)
 		break;
 
 	case FSG_STATE_CONFIG_CHANGE:
+		/* Nothing will ask for a flush after a disconnect */
+		if (!common->new_fsg)
+			fsg_lun_fsync_sub(&common->luns[0]);
 		do_set_interface(common, common->new_fsg);
 		break;
 
@@ -17,6 +17,7 @@
 
 #include <errno.h>
 #include <common.h>
+#include <div64.h>
 #include <malloc.h>
 #include <memalign.h>
 #include <version.h>
@@ -32,6 +33,8 @@
 static void thor_tx_data(unsigned char *data, int len);
 static void thor_set_dma(void *addr, int len);
 static int thor_rx_data(void);
+static int thor_rx_start(void);
+static int thor_rx_finish(int len);
 
 static struct f_thor *thor_func;
 static inline struct f_thor *func_to_thor(struct usb_function *f)
@@ -51,6 +54,10 @@ DEFINE_CACHE_ALIGN_BUFFER(char, f_name, F_NAME_BUF_SIZE);
 static unsigned long long int thor_file_size;
 static int alt_setting_num;
 
+/* Download statistics, in ms */
+static ulong thor_start_time;
+static ulong thor_usb_time;
+
 static void send_rsp(const struct rsp_box *rsp)
 {
 	memcpy(thor_tx_data_buf, rsp, sizeof(struct rsp_box));
@@ -140,80 +147,73 @@ static int process_rqt_cmd(const struct rqt_box *rqt)
 	return true;
 }
 
-static long long int download_head(unsigned long long total,
-				   unsigned int packet_size,
-				   long long int *left,
-				   int *cnt)
+static int download_head(unsigned long long total,
+			 unsigned int packet_size, int *cnt)
 {
-	long long int rcv_cnt = 0, left_to_rcv, ret_rcv;
+	struct thor_dev *dev = thor_func->dev;
 	struct dfu_entity *dfu_entity = dfu_get_entity(alt_setting_num);
-	void *transfer_buffer = dfu_get_buf(dfu_entity);
-	void *buf = transfer_buffer;
-	int usb_pkt_cnt = 0, ret;
+	unsigned long long rcv_cnt = 0;
+	int usb_pkt_cnt = 0, i = 0, ret;
+	unsigned int len;
+	ulong start;
+	void *buf;
 
 	/*
-	 * Files smaller than THOR_STORE_UNIT_SIZE (now 32 MiB) are stored on
-	 * the medium.
-	 * The packet response is sent on the purpose after successful data
-	 * chunk write. There is a room for improvement when asynchronous write
-	 * is performed.
+	 * Packets are received alternately into the two rx buffers. Once a
+	 * packet has arrived, the next one is queued and acknowledged before
+	 * this one is handed to DFU, so the host keeps sending while the
+	 * medium is written. A failed write is thus only reported after the
+	 * packet has been acknowledged.
 	 */
-	while (total - rcv_cnt >= packet_size) {
-		thor_set_dma(buf, packet_size);
-		buf += packet_size;
-		ret_rcv = thor_rx_data();
-		if (ret_rcv < 0)
-			return ret_rcv;
-		rcv_cnt += ret_rcv;
+	if (!total)
+		return 0;
+
+	thor_set_dma(dev->rx_buf[i], packet_size);
+	ret = thor_rx_start();
+	if (ret)
+		return ret;
+
+	while (rcv_cnt < total) {
+		buf = dev->rx_buf[i];
+		start = get_timer(0);
+		ret = thor_rx_finish(packet_size);
+		thor_usb_time += get_timer(start);
+		if (ret)
+			return ret;
+
+		/* The host pads the last packet */
+		len = min_t(unsigned long long, total - rcv_cnt, packet_size);
+		rcv_cnt += len;
 		debug("%d: RCV data count: %llu cnt: %d\n", usb_pkt_cnt,
 		      rcv_cnt, *cnt);
 
-		if ((rcv_cnt % THOR_STORE_UNIT_SIZE) == 0) {
-			ret = dfu_write(dfu_get_entity(alt_setting_num),
-					transfer_buffer, THOR_STORE_UNIT_SIZE,
-					(*cnt)++);
-			if (ret) {
-				error("DFU write failed [%d] cnt: %d",
-				      ret, *cnt);
+		if (rcv_cnt < total) {
+			i = !i;
+			thor_set_dma(dev->rx_buf[i], packet_size);
+			ret = thor_rx_start();
+			if (ret)
 				return ret;
-			}
-			buf = transfer_buffer;
 		}
 		send_data_rsp(0, ++usb_pkt_cnt);
-	}
-
-	/* Calculate the amount of data to arrive from PC (in bytes) */
-	left_to_rcv = total - rcv_cnt;
 
-	/*
-	 * Calculate number of data already received. but not yet stored
-	 * on the medium (they are smaller than THOR_STORE_UNIT_SIZE)
-	 */
-	*left = left_to_rcv + buf - transfer_buffer;
-	debug("%s: left: %llu left_to_rcv: %llu buf: 0x%p\n", __func__,
-	      *left, left_to_rcv, buf);
-
-	if (left_to_rcv) {
-		thor_set_dma(buf, packet_size);
-		ret_rcv = thor_rx_data();
-		if (ret_rcv < 0)
-			return ret_rcv;
-		rcv_cnt += ret_rcv;
-		send_data_rsp(0, ++usb_pkt_cnt);
+		ret = dfu_write(dfu_entity, buf, len, (*cnt)++ & 0xffff);
+		if (ret) {
+			error("DFU write failed [%d] cnt: %d", ret, *cnt);
+			return ret;
+		}
 	}
 
 	debug("%s: %llu total: %llu cnt: %d\n", __func__, rcv_cnt, total, *cnt);
 
-	return rcv_cnt;
+	return 0;
 }
 
-static int download_tail(long long int left, int cnt)
+static int download_tail(int cnt)
 {
 	struct dfu_entity *dfu_entity;
-	void *transfer_buffer;
 	int ret;
 
-	debug("%s: left: %llu cnt: %d\n", __func__, left, cnt);
+	debug("%s: cnt: %d\n", __func__, cnt);
 
 	dfu_entity = dfu_get_entity(alt_setting_num);
 	if (!dfu_entity) {
@@ -221,38 +221,30 @@ static int download_tail(long long int left, int cnt)
 		return -ENOENT;
 	}
 
-	transfer_buffer = dfu_get_buf(dfu_entity);
-	if (!transfer_buffer) {
-		error("Transfer buffer not allocated!");
-		return -ENXIO;
-	}
-
-	if (left) {
-		ret = dfu_write(dfu_entity, transfer_buffer, left, cnt++);
-		if (ret) {
-			error("DFU write failed [%d]: left: %llu", ret, left);
-			return ret;
-		}
-	}
-
 	/*
 	 * To store last "packet" or write file from buffer to filesystem
 	 * DFU storage backend requires dfu_flush
-	 *
-	 * This also frees memory malloc'ed by dfu_get_buf(), so no explicit
-	 * need fo call dfu_free_buf() is needed.
 	 */
-	ret = dfu_flush(dfu_entity, transfer_buffer, 0, cnt);
+	ret = dfu_flush(dfu_entity, NULL, 0, cnt);
 	if (ret)
 		error("DFU flush failed!");
 
 	return ret;
 }
 
+static void thor_print_stats(void)
+{
+	ulong time = max(get_timer(thor_start_time), 1UL);
+
+	printf("THOR: %s: %llu bytes in %lu ms (%lu KiB/s), USB wait %lu ms\n",
+	       f_name, thor_file_size, time,
+	       (ulong)lldiv(thor_file_size * 1000 / 1024, time),
+	       thor_usb_time);
+}
+
 static long long int process_rqt_download(const struct rqt_box *rqt)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(struct rsp_box, rsp, sizeof(struct rsp_box));
-	static long long int left, ret_head;
 	int file_type, ret = 0;
 	static int cnt;
 
@@ -292,18 +284,18 @@ static long long int process_rqt_download(const struct rqt_box *rqt)
 		break;
 	case RQT_DL_FILE_START:
 		send_rsp(rsp);
-		ret_head = download_head(thor_file_size, THOR_PACKET_SIZE,
-					 &left, &cnt);
-		if (ret_head < 0) {
-			left = 0;
+		thor_start_time = get_timer(0);
+		thor_usb_time = 0;
+		ret = download_head(thor_file_size, THOR_PACKET_SIZE, &cnt);
+		if (ret)
 			cnt = 0;
-		}
-		return ret_head;
+		return ret;
 	case RQT_DL_FILE_END:
 		debug("DL FILE_END\n");
-		rsp->ack = download_tail(left, cnt);
+		rsp->ack = download_tail(cnt);
 		ret = rsp->ack;
-		left = 0;
+		if (!ret)
+			thor_print_stats();
 		cnt = 0;
 		break;
 	case RQT_DL_EXIT:
@@ -526,36 +518,66 @@ static struct usb_request *alloc_ep_req(struct usb_ep *ep, unsigned length)
 	return req;
 }
 
-static int thor_rx_data(void)
+static int thor_rx_start(void)
 {
 	struct thor_dev *dev = thor_func->dev;
-	int data_to_rx, tmp, status;
-
-	data_to_rx = dev->out_req->length;
-	tmp = data_to_rx;
-	do {
-		dev->out_req->length = data_to_rx;
-		debug("dev->out_req->length:%d dev->rxdata:%d\n",
-		      dev->out_req->length, dev->rxdata);
-
-		status = usb_ep_queue(dev->out_ep, dev->out_req, 0);
-		if (status) {
-			error("kill %s:  resubmit %d bytes --> %d",
-			      dev->out_ep->name, dev->out_req->length, status);
-			usb_ep_set_halt(dev->out_ep);
-			return -EAGAIN;
-		}
+	int status;
+
+	debug("dev->out_req->length:%d dev->rxdata:%d\n",
+	      dev->out_req->length, dev->rxdata);
 
+	status = usb_ep_queue(dev->out_ep, dev->out_req, 0);
+	if (status) {
+		error("kill %s:  resubmit %d bytes --> %d",
+		      dev->out_ep->name, dev->out_req->length, status);
+		usb_ep_set_halt(dev->out_ep);
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/*
+ * Wait until the request queued by thor_rx_start() has received len bytes.
+ * Data received by dfu_write() is written out meanwhile.
+ */
+static int thor_rx_finish(int len)
+{
+	struct thor_dev *dev = thor_func->dev;
+	int ret;
+
+	for (;;) {
 		while (!dev->rxdata) {
 			usb_gadget_handle_interrupts(0);
+			dfu_write_poll();
 			if (ctrlc())
-				return -1;
+				return -EINTR;
 		}
 		dev->rxdata = 0;
-		data_to_rx -= dev->out_req->actual;
-	} while (data_to_rx);
 
-	return tmp;
+		len -= dev->out_req->actual;
+		if (len <= 0)
+			return 0;
+
+		dev->out_req->buf += dev->out_req->actual;
+		dev->out_req->length = len;
+		ret = thor_rx_start();
+		if (ret)
+			return ret;
+	}
+}
+
+static int thor_rx_data(void)
+{
+	struct thor_dev *dev = thor_func->dev;
+	int len = dev->out_req->length;
+	int ret;
+
+	ret = thor_rx_start();
+	if (!ret)
+		ret = thor_rx_finish(len);
+
+	return ret ? ret : len;
 }
 
 static void thor_tx_data(unsigned char *data, int len)
@@ -890,9 +912,12 @@ static void thor_func_disable(struct usb_function *f)
 	}
 
 	if (dev->out_ep->driver_data) {
+		/* Retire a queued request before its buffer goes away */
+		usb_ep_disable(dev->out_ep);
+		free(dev->rx_buf[0]);
+		free(dev->rx_buf[1]);
 		dev->out_req->buf = NULL;
 		usb_ep_free_request(dev->out_ep, dev->out_req);
-		usb_ep_disable(dev->out_ep);
 		dev->out_ep->driver_data = NULL;
 	}
 
@@ -945,6 +970,16 @@ static int thor_eps_setup(struct usb_function *f)
 		goto exit;
 	}
 
+	/* Data packets are received alternately into two buffers */
+	dev->rx_buf[0] = req->buf;
+	dev->rx_buf[1] = memalign(CONFIG_SYS_CACHELINE_SIZE, THOR_PACKET_SIZE);
+	if (!dev->rx_buf[1]) {
+		free_ep_req(ep, req);
+		usb_ep_disable(ep);
+		result = -ENOMEM;
+		goto exit;
+	}
+
 	dev->out_req = req;
 	/* ACM control EP */
 	ep = dev->int_ep;
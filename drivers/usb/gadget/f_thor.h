@@ -106,6 +106,7 @@ struct thor_dev {
 	/* IN/OUT EP's and correspoinding requests */
 	struct usb_ep *in_ep, *out_ep, *int_ep;
 	struct usb_request *in_req, *out_req;
+	void *rx_buf[2];	/* THOR_PACKET_SIZE each, for data packets */
 
 	/* Control flow variables */
 	unsigned char configuration_done;
@@ -120,7 +121,6 @@ struct f_thor {
 
 #define F_NAME_BUF_SIZE 32
 #define THOR_PACKET_SIZE SZ_1M      /* 1 MiB */
-#define THOR_STORE_UNIT_SIZE SZ_32M /* 32 MiB */
 #ifdef CONFIG_THOR_RESET_OFF
 #define RESET_DONE 0xFFFFFFFF
 #endif
@@ -591,7 +591,10 @@ static void fsg_lun_close(struct fsg_lun *curlun)
  */
 static int fsg_lun_fsync_sub(struct fsg_lun *curlun)
 {
-	return 0;
+	if (!ums->flush)
+		return 0;
+
+	return ums->flush(ums);
 }
 
 static void store_cdrom_address(u8 *dest, int msf, u32 addr)
@@ -92,13 +92,17 @@
  * - implemented fragment sorting to ensure that the newest data is copied
  *   if there are multiple copies of fragments for a certain file offset.
  *
- * The fragment sorting feature must be enabled by CONFIG_SYS_JFFS2_SORT_FRAGMENTS.
- * Sorting is done while adding fragments to the lists, which is more or less a
- * bubble sort. This takes a lot of time, and is most probably not an issue if
- * the boot filesystem is always mounted readonly.
+ * Nodes are kept in per-inode lists, found through an rbtree by inode number
+ * (data nodes) or parent inode number (directory entries). The version of
+ * each node is recorded while scanning, so the data nodes of every inode are
+ * always merge sorted by version in memory, without reading flash again.
  *
- * You should define it if the boot filesystem is mounted writable, and updates
- * to the boot files are done by copying files to that filesystem.
+ * Sorting directory entries by name must be enabled by
+ * CONFIG_SYS_JFFS2_SORT_FRAGMENTS. It needs to read the names from flash, so
+ * it is most probably not worth it if the boot filesystem is always mounted
+ * readonly. You should define it if the boot filesystem is mounted writable,
+ * and updates to the boot files are done by copying files to that filesystem,
+ * so that 'ls' only shows the latest version of each entry.
  *
  *
  * There's a big issue left: endianess is completely ignored in this code. Duh!
@@ -541,47 +545,112 @@ add_node(struct b_list *list)
 	return b;
 }
 
+/*
+ * Find the group of nodes for inode number ino in the tree, creating an
+ * empty one if create is set.
+ */
+static struct b_inode *
+find_group(struct rb_root *root, u32 ino, int create)
+{
+	struct rb_node **p = &root->rb_node;
+	struct rb_node *parent = NULL;
+	struct b_inode *group;
+
+	while (*p) {
+		parent = *p;
+		group = rb_entry(parent, struct b_inode, node);
+		if (ino < group->ino)
+			p = &parent->rb_left;
+		else if (ino > group->ino)
+			p = &parent->rb_right;
+		else
+			return group;
+	}
+	if (!create)
+		return NULL;
+
+	group = calloc(1, sizeof(*group));
+	if (group == NULL) {
+		putstr("find_group: malloc failed\n");
+		return NULL;
+	}
+	group->ino = ino;
+	rb_link_node(&group->node, parent, p);
+	rb_insert_color(&group->node, root);
+
+	return group;
+}
+
+/*
+ * Add the node at offset to the group for ino in the tree. The b_node
+ * itself is allocated from list, which also provides the sort order.
+ */
 static struct b_node *
-insert_node(struct b_list *list, u32 offset)
+insert_node(struct b_list *list, struct rb_root *root, u32 ino, u32 version,
+	    u32 offset)
 {
+	struct b_inode *group;
 	struct b_node *new;
 
+	if (!(group = find_group(root, ino, 1)))
+		return NULL;
 	if (!(new = add_node(list))) {
 		putstr("add_node failed!\r\n");
 		return NULL;
 	}
 	new->offset = offset;
+	new->version = version;
 	new->next = NULL;
 
-	if (list->listTail != NULL)
-		list->listTail->next = new;
+	if (group->nodes.listTail != NULL)
+		group->nodes.listTail->next = new;
 	else
-		list->listHead = new;
-	list->listTail = new;
+		group->nodes.listHead = new;
+	group->nodes.listTail = new;
+	group->nodes.listCount++;
+	group->nodes.listCompare = list->listCompare;
 
 	return new;
 }
 
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+/* Sort each group of nodes in the tree that has a sort order */
+static void
+sort_groups(struct rb_root *root)
+{
+	struct rb_node *rb;
+	struct b_inode *group;
+
+	for (rb = rb_first(root); rb; rb = rb_next(rb)) {
+		group = rb_entry(rb, struct b_inode, node);
+		if (group->nodes.listCompare && group->nodes.listCount > 1)
+			sort_list(&group->nodes);
+	}
+}
+
+static void
+free_groups(struct rb_root *root)
+{
+	struct rb_node *rb = rb_first_postorder(root);
+	struct rb_node *next;
+
+	while (rb) {
+		next = rb_next_postorder(rb);
+		free(rb_entry(rb, struct b_inode, node));
+		rb = next;
+	}
+	*root = RB_ROOT;
+}
+
 /* Sort data entries with the latest version last, so that if there
- * is overlapping data the latest version will be used.
+ * is overlapping data the latest version will be used. The version is
+ * recorded while scanning, so this needs no flash access.
  */
 static int compare_inodes(struct b_node *new, struct b_node *old)
 {
-	/*
-	 * Only read in the version info from flash, not the entire inode.
-	 * This can make a big difference to speed if flash is slow.
-	 */
-	u32 new_version;
-	u32 old_version;
-	get_fl_mem(new->offset + offsetof(struct jffs2_raw_inode, version),
-		   sizeof(new_version), &new_version);
-	get_fl_mem(old->offset + offsetof(struct jffs2_raw_inode, version),
-		   sizeof(old_version), &old_version);
-
-	return new_version > old_version;
+	return new->version > old->version;
 }
 
+#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
 /* Sort directory entries so all entries in the same directory
  * with the same name are grouped together, with the latest version
  * last. This makes it easy to eliminate all but the latest version
@@ -621,7 +690,7 @@ static int compare_dirents(struct b_node *new, struct b_node *old)
 			 * we have duplicate names in this directory,
 			 * so use ascending sort by version
 			 */
-			ret = jNew->version > jOld->version;
+			ret = new->version > old->version;
 		}
 	}
 	put_fl_mem(jNew, NULL);
@@ -638,6 +707,8 @@ jffs2_free_cache(struct part_info *part)
 
 	if (part->jffs2_priv != NULL) {
 		pL = (struct b_lists *)part->jffs2_priv;
+		free_groups(&pL->frags);
+		free_groups(&pL->dirs);
 		free_nodes(&pL->frag);
 		free_nodes(&pL->dir);
 		free(pL->readbuf);
@@ -656,9 +727,11 @@ jffs_init_1pass_list(struct part_info *part)
 		pL = (struct b_lists *)part->jffs2_priv;
 
 		memset(pL, 0, sizeof(*pL));
+		pL->dirs = RB_ROOT;
+		pL->frags = RB_ROOT;
+		pL->frag.listCompare = compare_inodes;
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
 		pL->dir.listCompare = compare_dirents;
-		pL->frag.listCompare = compare_inodes;
 #endif
 	}
 	return 0;
@@ -668,43 +741,40 @@ jffs_init_1pass_list(struct part_info *part)
 static long
 jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 {
+	struct b_inode *group;
 	struct b_node *b;
 	struct jffs2_raw_inode *jNode;
 	u32 totalSize = 0;
-	u32 latestVersion = 0;
 	uchar *lDest;
 	uchar *src;
 	int i;
 	u32 counter = 0;
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+
+	group = find_group(&pL->frags, inode, 0);
+	if (group == NULL)
+		return 0;
+
 	/* Find file size before loading any data, so fragments that
 	 * start past the end of file can be ignored. A fragment
 	 * that is partially in the file is loaded, so extra data may
 	 * be loaded up to the next 4K boundary above the file size.
 	 * This shouldn't cause trouble when loading kernel images, so
-	 * we will live with it.
+	 * we will live with it. The fragments are sorted by version,
+	 * so the actual file length is in the last one.
 	 */
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
-		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
+	jNode = (struct jffs2_raw_inode *)get_fl_mem(
+			group->nodes.listTail->offset,
 			sizeof(struct jffs2_raw_inode), pL->readbuf);
-		if ((inode == jNode->ino)) {
-			/* get actual file length from the newest node */
-			if (jNode->version >= latestVersion) {
-				totalSize = jNode->isize;
-				latestVersion = jNode->version;
-			}
-		}
-		put_fl_mem(jNode, pL->readbuf);
-	}
+	totalSize = jNode->isize;
+	put_fl_mem(jNode, pL->readbuf);
 	/*
 	 * If no destination is provided, we are done.
 	 * Just return the total size.
 	 */
 	if (!dest)
 		return totalSize;
-#endif
 
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
+	for (b = group->nodes.listHead; b != NULL; b = b->next) {
 		/*
 		 * Copy just the node and not the data at this point,
 		 * since we don't yet know if we need this data.
@@ -712,91 +782,73 @@ jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 		jNode = (struct jffs2_raw_inode *)get_fl_mem(b->offset,
 				sizeof(struct jffs2_raw_inode),
 				pL->readbuf);
-		if (inode == jNode->ino) {
 #if 0
-			putLabeledWord("\r\n\r\nread_inode: totlen = ", jNode->totlen);
-			putLabeledWord("read_inode: inode = ", jNode->ino);
-			putLabeledWord("read_inode: version = ", jNode->version);
-			putLabeledWord("read_inode: isize = ", jNode->isize);
-			putLabeledWord("read_inode: offset = ", jNode->offset);
-			putLabeledWord("read_inode: csize = ", jNode->csize);
-			putLabeledWord("read_inode: dsize = ", jNode->dsize);
-			putLabeledWord("read_inode: compr = ", jNode->compr);
-			putLabeledWord("read_inode: usercompr = ", jNode->usercompr);
-			putLabeledWord("read_inode: flags = ", jNode->flags);
-#endif
-
-#ifndef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-			/* get actual file length from the newest node */
-			if (jNode->version >= latestVersion) {
-				totalSize = jNode->isize;
-				latestVersion = jNode->version;
-			}
+		putLabeledWord("\r\n\r\nread_inode: totlen = ", jNode->totlen);
+		putLabeledWord("read_inode: inode = ", jNode->ino);
+		putLabeledWord("read_inode: version = ", jNode->version);
+		putLabeledWord("read_inode: isize = ", jNode->isize);
+		putLabeledWord("read_inode: offset = ", jNode->offset);
+		putLabeledWord("read_inode: csize = ", jNode->csize);
+		putLabeledWord("read_inode: dsize = ", jNode->dsize);
+		putLabeledWord("read_inode: compr = ", jNode->compr);
+		putLabeledWord("read_inode: usercompr = ", jNode->usercompr);
+		putLabeledWord("read_inode: flags = ", jNode->flags);
 #endif
+		/* ignore data behind latest known EOF */
+		if (jNode->offset > totalSize) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
 
-			if(dest) {
-				/*
-				 * Now that the inode has been checked,
-				 * read the entire inode, including data.
-				 */
-				put_fl_mem(jNode, pL->readbuf);
-				jNode = (struct jffs2_raw_inode *)
-					get_node_mem(b->offset, pL->readbuf);
-				src = ((uchar *)jNode) +
-					sizeof(struct jffs2_raw_inode);
-				/* ignore data behind latest known EOF */
-				if (jNode->offset > totalSize) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
-				if (b->datacrc == CRC_UNKNOWN)
-					b->datacrc = data_crc(jNode) ?
-						CRC_OK : CRC_BAD;
-				if (b->datacrc == CRC_BAD) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
+		/*
+		 * Now that the inode has been checked,
+		 * read the entire inode, including data.
+		 */
+		put_fl_mem(jNode, pL->readbuf);
+		jNode = (struct jffs2_raw_inode *)get_node_mem(b->offset,
+							       pL->readbuf);
+		src = ((uchar *)jNode) + sizeof(struct jffs2_raw_inode);
+		if (b->datacrc == CRC_UNKNOWN)
+			b->datacrc = data_crc(jNode) ? CRC_OK : CRC_BAD;
+		if (b->datacrc == CRC_BAD) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
 
-				lDest = (uchar *) (dest + jNode->offset);
+		lDest = (uchar *) (dest + jNode->offset);
 #if 0
-				putLabeledWord("read_inode: src = ", src);
-				putLabeledWord("read_inode: dest = ", lDest);
+		putLabeledWord("read_inode: src = ", src);
+		putLabeledWord("read_inode: dest = ", lDest);
 #endif
-				switch (jNode->compr) {
-				case JFFS2_COMPR_NONE:
-					ldr_memcpy(lDest, src, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZERO:
-					for (i = 0; i < jNode->dsize; i++)
-						*(lDest++) = 0;
-					break;
-				case JFFS2_COMPR_RTIME:
-					rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_DYNRUBIN:
-					/* this is slow but it works */
-					dynrubin_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZLIB:
-					zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
+		switch (jNode->compr) {
+		case JFFS2_COMPR_NONE:
+			ldr_memcpy(lDest, src, jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZERO:
+			for (i = 0; i < jNode->dsize; i++)
+				*(lDest++) = 0;
+			break;
+		case JFFS2_COMPR_RTIME:
+			rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
+		case JFFS2_COMPR_DYNRUBIN:
+			/* this is slow but it works */
+			dynrubin_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZLIB:
+			zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #if defined(CONFIG_JFFS2_LZO)
-				case JFFS2_COMPR_LZO:
-					lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-#endif
-				default:
-					/* unknown */
-					putLabeledWord("UNKNOWN COMPRESSION METHOD = ", jNode->compr);
-					put_fl_mem(jNode, pL->readbuf);
-					return -1;
-					break;
-				}
-			}
-
-#if 0
-			putLabeledWord("read_inode: totalSize = ", totalSize);
+		case JFFS2_COMPR_LZO:
+			lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #endif
+		default:
+			/* unknown */
+			putLabeledWord("UNKNOWN COMPRESSION METHOD = ", jNode->compr);
+			put_fl_mem(jNode, pL->readbuf);
+			return -1;
+			break;
 		}
 		counter++;
 		put_fl_mem(jNode, pL->readbuf);
@@ -812,6 +864,7 @@ jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 static u32
 jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 {
+	struct b_inode *group;
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
 	int len;
@@ -819,15 +872,22 @@ jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 	u32 version = 0;
 	u32 inode = 0;
 
+	group = find_group(&pL->dirs, pino, 0);
+	if (group == NULL)
+		return 0;
+
 	/* name is assumed slash free */
 	len = strlen(name);
 
 	counter = 0;
 	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next, counter++) {
+	for (b = group->nodes.listHead; b; b = b->next, counter++) {
+		/* older entries can't win, so don't even read them */
+		if (b->version < version)
+			continue;
 		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
 								pL->readbuf);
-		if ((pino == jDir->pino) && (len == jDir->nsize) &&
+		if ((len == jDir->nsize) &&
 		    (!strncmp((char *)jDir->name, name, len))) {	/* a match */
 			if (jDir->version < version) {
 				put_fl_mem(jDir, pL->readbuf);
@@ -942,71 +1002,64 @@ static inline u32 dump_inode(struct b_lists * pL, struct jffs2_raw_dirent *d, st
 static u32
 jffs2_1pass_list_inodes(struct b_lists * pL, u32 pino)
 {
+	struct b_inode *group;
+	struct b_inode *frags;
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
+	struct jffs2_raw_inode *i;
+#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+	int match;
+#endif
+
+	group = find_group(&pL->dirs, pino, 0);
+	if (group == NULL)
+		return pino;
 
-	for (b = pL->dir.listHead; b; b = b->next) {
+	for (b = group->nodes.listHead; b; b = b->next) {
 		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
 								pL->readbuf);
-		if (pino == jDir->pino) {
-			u32 i_version = 0;
-			struct jffs2_raw_inode *jNode, *i = NULL;
-			struct b_node *b2;
-
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-			/* Check for more recent versions of this file */
-			int match;
-			do {
-				struct b_node *next = b->next;
-				struct jffs2_raw_dirent *jDirNext;
-				if (!next)
-					break;
-				jDirNext = (struct jffs2_raw_dirent *)
-					get_node_mem(next->offset, NULL);
-				match = jDirNext->pino == jDir->pino &&
-					jDirNext->nsize == jDir->nsize &&
-					strncmp((char *)jDirNext->name,
-						(char *)jDir->name,
-						jDir->nsize) == 0;
-				if (match) {
-					/* Use next. It is more recent */
-					b = next;
-					/* Update buffer with the new info */
-					*jDir = *jDirNext;
-				}
-				put_fl_mem(jDirNext, NULL);
-			} while (match);
-#endif
-			if (jDir->ino == 0) {
-				/* Deleted file */
-				put_fl_mem(jDir, pL->readbuf);
-				continue;
-			}
-
-			for (b2 = pL->frag.listHead; b2; b2 = b2->next) {
-				jNode = (struct jffs2_raw_inode *)
-					get_fl_mem(b2->offset, sizeof(*jNode),
-						   NULL);
-				if (jNode->ino == jDir->ino &&
-				    jNode->version >= i_version) {
-					i_version = jNode->version;
-					if (i)
-						put_fl_mem(i, NULL);
-
-					if (jDir->type == DT_LNK)
-						i = get_node_mem(b2->offset,
-								 NULL);
-					else
-						i = get_fl_mem(b2->offset,
-							       sizeof(*i),
-							       NULL);
-				}
-				put_fl_mem(jNode, NULL);
+		/* Check for more recent versions of this file */
+		do {
+			struct b_node *next = b->next;
+			struct jffs2_raw_dirent *jDirNext;
+			if (!next)
+				break;
+			jDirNext = (struct jffs2_raw_dirent *)
+				get_node_mem(next->offset, NULL);
+			match = jDirNext->nsize == jDir->nsize &&
+				strncmp((char *)jDirNext->name,
+					(char *)jDir->name,
+					jDir->nsize) == 0;
+			if (match) {
+				/* Use next. It is more recent */
+				b = next;
+				/* Update buffer with the new info */
+				*jDir = *jDirNext;
 			}
+			put_fl_mem(jDirNext, NULL);
+		} while (match);
+#endif
+		if (jDir->ino == 0) {
+			/* Deleted file */
+			put_fl_mem(jDir, pL->readbuf);
+			continue;
+		}
 
-			dump_inode(pL, jDir, i);
-			put_fl_mem(i, NULL);
+		/* the newest data node of the inode is sorted last */
+		i = NULL;
+		frags = find_group(&pL->frags, jDir->ino, 0);
+		if (frags) {
+			if (jDir->type == DT_LNK)
+				i = get_node_mem(frags->nodes.listTail->offset,
+						 NULL);
+			else
+				i = get_fl_mem(frags->nodes.listTail->offset,
+					       sizeof(*i), NULL);
 		}
+
+		dump_inode(pL, jDir, i);
+		put_fl_mem(i, NULL);
 		put_fl_mem(jDir, pL->readbuf);
 	}
 	return pino;
@@ -1071,77 +1124,70 @@ jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino)
 static u32
 jffs2_1pass_resolve_inode(struct b_lists * pL, u32 ino)
 {
+	struct rb_node *rb;
+	struct b_inode *group;
 	struct b_node *b;
-	struct b_node *b2;
 	struct jffs2_raw_dirent *jDir;
 	struct jffs2_raw_inode *jNode;
-	u8 jDirFoundType = 0;
-	u32 jDirFoundIno = 0;
 	u32 jDirFoundPino = 0;
 	char tmp[256];
 	u32 version = 0;
-	u32 pino;
 	unsigned char *src;
 
-	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		if (ino == jDir->ino) {
-			if (jDir->version < version) {
-				put_fl_mem(jDir, pL->readbuf);
-				continue;
-			}
-
-			if (jDir->version == version && jDirFoundType) {
-				/* I'm pretty sure this isn't legal */
-				putstr(" ** ERROR ** ");
-				putnstr(jDir->name, jDir->nsize);
-				putLabeledWord(" has dup version (resolve) = ",
-					version);
-			}
-
-			jDirFoundType = jDir->type;
-			jDirFoundIno = jDir->ino;
-			jDirFoundPino = jDir->pino;
-			version = jDir->version;
-		}
-		put_fl_mem(jDir, pL->readbuf);
+	/*
+	 * Only a soft link needs resolving. That is known from the mode
+	 * of its newest data node, which is sorted last.
+	 */
+	group = find_group(&pL->frags, ino, 0);
+	if (group == NULL)
+		return ino;
+	jNode = (struct jffs2_raw_inode *)get_node_mem(
+			group->nodes.listTail->offset, pL->readbuf);
+	if (!S_ISLNK(jNode->mode)) {
+		put_fl_mem(jNode, pL->readbuf);
+		return ino;
 	}
-	/* now we found the right entry again. (shoulda returned inode*) */
-	if (jDirFoundType != DT_LNK)
-		return jDirFoundIno;
 
 	/* it's a soft link so we follow it again. */
-	b2 = pL->frag.listHead;
-	while (b2) {
-		jNode = (struct jffs2_raw_inode *) get_node_mem(b2->offset,
-								pL->readbuf);
-		if (jNode->ino == jDirFoundIno) {
-			src = (unsigned char *)jNode + sizeof(struct jffs2_raw_inode);
-
+	src = (unsigned char *)jNode + sizeof(struct jffs2_raw_inode);
 #if 0
-			putLabeledWord("\t\t dsize = ", jNode->dsize);
-			putstr("\t\t target = ");
-			putnstr(src, jNode->dsize);
-			putstr("\r\n");
+	putLabeledWord("\t\t dsize = ", jNode->dsize);
+	putstr("\t\t target = ");
+	putnstr(src, jNode->dsize);
+	putstr("\r\n");
 #endif
-			strncpy(tmp, (char *)src, jNode->dsize);
-			tmp[jNode->dsize] = '\0';
-			put_fl_mem(jNode, pL->readbuf);
-			break;
-		}
-		b2 = b2->next;
-		put_fl_mem(jNode, pL->readbuf);
-	}
+	strncpy(tmp, (char *)src, jNode->dsize);
+	tmp[jNode->dsize] = '\0';
+	put_fl_mem(jNode, pL->readbuf);
+
 	/* ok so the name of the new file to find is in tmp */
 	/* if it starts with a slash it is root based else shared dirs */
 	if (tmp[0] == '/')
-		pino = 1;
-	else
-		pino = jDirFoundPino;
+		return jffs2_1pass_search_inode(pL, tmp, 1);
 
-	return jffs2_1pass_search_inode(pL, tmp, pino);
+	/* we need to search all and use the entry with the highest version */
+	for (rb = rb_first(&pL->dirs); rb; rb = rb_next(rb)) {
+		group = rb_entry(rb, struct b_inode, node);
+		for (b = group->nodes.listHead; b; b = b->next) {
+			if (b->version < version)
+				continue;
+			jDir = (struct jffs2_raw_dirent *)get_node_mem(
+					b->offset, pL->readbuf);
+			if (ino == jDir->ino) {
+				if (jDir->version == version && jDirFoundPino) {
+					/* I'm pretty sure this isn't legal */
+					putstr(" ** ERROR ** ");
+					putnstr(jDir->name, jDir->nsize);
+					putLabeledWord(" has dup version (resolve) = ",
+						       version);
+				}
+				jDirFoundPino = jDir->pino;
+				version = jDir->version;
+			}
+			put_fl_mem(jDir, pL->readbuf);
+		}
+	}
+	return jffs2_1pass_search_inode(pL, tmp, jDirFoundPino);
 }
 
 static u32
@@ -1195,6 +1241,7 @@ jffs2_1pass_search_list_inodes(struct b_lists * pL, const char *fname, u32 pino)
 unsigned char
 jffs2_1pass_rescan_needed(struct part_info *part)
 {
+	struct rb_node *rb;
 	struct b_node *b;
 	struct jffs2_unknown_node onode;
 	struct jffs2_unknown_node *node;
@@ -1212,16 +1259,18 @@ jffs2_1pass_rescan_needed(struct part_info *part)
 	}
 
 	/* but suppose someone reflashed a partition at the same offset... */
-	b = pL->dir.listHead;
-	while (b) {
-		node = (struct jffs2_unknown_node *) get_fl_mem(b->offset,
-			sizeof(onode), &onode);
-		if (node->nodetype != JFFS2_NODETYPE_DIRENT) {
-			DEBUGF ("rescan: fs changed beneath me? (%lx)\n",
-					(unsigned long) b->offset);
-			return 1;
+	for (rb = rb_first(&pL->dirs); rb; rb = rb_next(rb)) {
+		b = rb_entry(rb, struct b_inode, node)->nodes.listHead;
+		while (b) {
+			node = (struct jffs2_unknown_node *) get_fl_mem(
+				b->offset, sizeof(onode), &onode);
+			if (node->nodetype != JFFS2_NODETYPE_DIRENT) {
+				DEBUGF ("rescan: fs changed beneath me? (%lx)\n",
+						(unsigned long) b->offset);
+				return 1;
+			}
+			b = b->next;
 		}
-		b = b->next;
 	}
 	return 0;
 }
@@ -1275,6 +1324,11 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 						spi = sp;
 
 						ret = insert_node(&pL->frag,
+							&pL->frags,
+							sum_get_unaligned32(
+								&spi->inode),
+							sum_get_unaligned32(
+								&spi->version),
 							(u32)part->offset +
 							offset +
 							sum_get_unaligned32(
@@ -1292,6 +1346,11 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 					spd = sp;
 					if (pass) {
 						ret = insert_node(&pL->dir,
+							&pL->dirs,
+							sum_get_unaligned32(
+								&spd->pino),
+							sum_get_unaligned32(
+								&spd->version),
 							(u32) part->offset +
 							offset +
 							sum_get_unaligned32(
@@ -1391,29 +1450,32 @@ crc_err:
 static void
 dump_fragments(struct b_lists *pL)
 {
+	struct rb_node *rb;
 	struct b_node *b;
 	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
 
 	putstr("\r\n\r\n******The fragment Entries******\r\n");
-	b = pL->frag.listHead;
-	while (b) {
-		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
-			sizeof(ojNode), &ojNode);
-		putLabeledWord("\r\n\tbuild_list: FLASH_OFFSET = ", b->offset);
-		putLabeledWord("\tbuild_list: totlen = ", jNode->totlen);
-		putLabeledWord("\tbuild_list: inode = ", jNode->ino);
-		putLabeledWord("\tbuild_list: version = ", jNode->version);
-		putLabeledWord("\tbuild_list: isize = ", jNode->isize);
-		putLabeledWord("\tbuild_list: atime = ", jNode->atime);
-		putLabeledWord("\tbuild_list: offset = ", jNode->offset);
-		putLabeledWord("\tbuild_list: csize = ", jNode->csize);
-		putLabeledWord("\tbuild_list: dsize = ", jNode->dsize);
-		putLabeledWord("\tbuild_list: compr = ", jNode->compr);
-		putLabeledWord("\tbuild_list: usercompr = ", jNode->usercompr);
-		putLabeledWord("\tbuild_list: flags = ", jNode->flags);
-		putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
-		b = b->next;
+	for (rb = rb_first(&pL->frags); rb; rb = rb_next(rb)) {
+		b = rb_entry(rb, struct b_inode, node)->nodes.listHead;
+		while (b) {
+			jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
+				sizeof(ojNode), &ojNode);
+			putLabeledWord("\r\n\tbuild_list: FLASH_OFFSET = ", b->offset);
+			putLabeledWord("\tbuild_list: totlen = ", jNode->totlen);
+			putLabeledWord("\tbuild_list: inode = ", jNode->ino);
+			putLabeledWord("\tbuild_list: version = ", jNode->version);
+			putLabeledWord("\tbuild_list: isize = ", jNode->isize);
+			putLabeledWord("\tbuild_list: atime = ", jNode->atime);
+			putLabeledWord("\tbuild_list: offset = ", jNode->offset);
+			putLabeledWord("\tbuild_list: csize = ", jNode->csize);
+			putLabeledWord("\tbuild_list: dsize = ", jNode->dsize);
+			putLabeledWord("\tbuild_list: compr = ", jNode->compr);
+			putLabeledWord("\tbuild_list: usercompr = ", jNode->usercompr);
+			putLabeledWord("\tbuild_list: flags = ", jNode->flags);
+			putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
+			b = b->next;
+		}
 	}
 }
 #endif
@@ -1422,35 +1484,39 @@ dump_fragments(struct b_lists *pL)
 static void
 dump_dirents(struct b_lists *pL)
 {
+	struct rb_node *rb;
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
 
 	putstr("\r\n\r\n******The directory Entries******\r\n");
-	b = pL->dir.listHead;
-	while (b) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		putstr("\r\n");
-		putnstr(jDir->name, jDir->nsize);
-		putLabeledWord("\r\n\tbuild_list: magic = ", jDir->magic);
-		putLabeledWord("\tbuild_list: nodetype = ", jDir->nodetype);
-		putLabeledWord("\tbuild_list: hdr_crc = ", jDir->hdr_crc);
-		putLabeledWord("\tbuild_list: pino = ", jDir->pino);
-		putLabeledWord("\tbuild_list: version = ", jDir->version);
-		putLabeledWord("\tbuild_list: ino = ", jDir->ino);
-		putLabeledWord("\tbuild_list: mctime = ", jDir->mctime);
-		putLabeledWord("\tbuild_list: nsize = ", jDir->nsize);
-		putLabeledWord("\tbuild_list: type = ", jDir->type);
-		putLabeledWord("\tbuild_list: node_crc = ", jDir->node_crc);
-		putLabeledWord("\tbuild_list: name_crc = ", jDir->name_crc);
-		putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
-		b = b->next;
-		put_fl_mem(jDir, pL->readbuf);
+	for (rb = rb_first(&pL->dirs); rb; rb = rb_next(rb)) {
+		b = rb_entry(rb, struct b_inode, node)->nodes.listHead;
+		while (b) {
+			jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
+									pL->readbuf);
+			putstr("\r\n");
+			putnstr(jDir->name, jDir->nsize);
+			putLabeledWord("\r\n\tbuild_list: magic = ", jDir->magic);
+			putLabeledWord("\tbuild_list: nodetype = ", jDir->nodetype);
+			putLabeledWord("\tbuild_list: hdr_crc = ", jDir->hdr_crc);
+			putLabeledWord("\tbuild_list: pino = ", jDir->pino);
+			putLabeledWord("\tbuild_list: version = ", jDir->version);
+			putLabeledWord("\tbuild_list: ino = ", jDir->ino);
+			putLabeledWord("\tbuild_list: mctime = ", jDir->mctime);
+			putLabeledWord("\tbuild_list: nsize = ", jDir->nsize);
+			putLabeledWord("\tbuild_list: type = ", jDir->type);
+			putLabeledWord("\tbuild_list: node_crc = ", jDir->node_crc);
+			putLabeledWord("\tbuild_list: name_crc = ", jDir->name_crc);
+			putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
+			b = b->next;
+			put_fl_mem(jDir, pL->readbuf);
+		}
 	}
 }
 #endif
 
 #define DEFAULT_EMPTY_SCAN_SIZE	256
+#define EMPTY_READ_SIZE		4096	/* read size when skipping 0xFF */
 
 static inline uint32_t EMPTY_SCAN_SIZE(uint32_t sector_size)
 {
@@ -1460,6 +1526,26 @@ static inline uint32_t EMPTY_SCAN_SIZE(uint32_t sector_size)
 		return DEFAULT_EMPTY_SCAN_SIZE;
 }
 
+/*
+ * Return the offset of the first word in buf between ofs and len which
+ * is not erased, or len if they all are. ofs must be 4-byte aligned.
+ * Whole machine words are compared where possible.
+ */
+static uint32_t skip_erased(const char *buf, uint32_t ofs, uint32_t len)
+{
+	while (ofs + 4 <= len && (ofs & (sizeof(ulong) - 1))) {
+		if (*(uint32_t *)&buf[ofs] != 0xFFFFFFFF)
+			return ofs;
+		ofs += 4;
+	}
+	while (ofs + sizeof(ulong) <= len && *(ulong *)&buf[ofs] == ~0UL)
+		ofs += sizeof(ulong);
+	while (ofs + 4 <= len && *(uint32_t *)&buf[ofs] == 0xFFFFFFFF)
+		ofs += 4;
+
+	return ofs < len ? ofs : len;
+}
+
 static u32
 jffs2_1pass_build_lists(struct part_info * part)
 {
@@ -1483,7 +1569,7 @@ jffs2_1pass_build_lists(struct part_info * part)
 	/* if we are building a list we need to refresh the cache. */
 	jffs_init_1pass_list(part);
 	pL = (struct b_lists *)part->jffs2_priv;
-	buf = malloc(DEFAULT_EMPTY_SCAN_SIZE);
+	buf = malloc(EMPTY_READ_SIZE);
 	puts ("Scanning JFFS2 FS:   ");
 
 	/* start at the beginning of the partition */
@@ -1565,14 +1651,10 @@ jffs2_1pass_build_lists(struct part_info * part)
 		get_fl_mem((u32)part->offset + buf_ofs, buf_len, buf);
 
 		/* We temporarily use 'ofs' as a pointer into the buffer/jeb */
-		ofs = 0;
+		ofs = skip_erased(buf, 0, buf_len);
 
-		/* Scan only 4KiB of 0xFF before declaring it's empty */
-		while (ofs < EMPTY_SCAN_SIZE(part->sector_size) &&
-				*(uint32_t *)(&buf[ofs]) == 0xFFFFFFFF)
-			ofs += 4;
-
-		if (ofs == EMPTY_SCAN_SIZE(part->sector_size))
+		/* Scan only the first bytes of 0xFF before declaring it's empty */
+		if (ofs == buf_len)
 			continue;
 
 		ofs += sector_ofs;
@@ -1615,13 +1697,12 @@ jffs2_1pass_build_lists(struct part_info * part)
 							buf_len);
 			more_empty:
 				inbuf_ofs = ofs - buf_ofs;
-				while (inbuf_ofs < scan_end) {
-					if (*(uint32_t *)(&buf[inbuf_ofs]) !=
-							0xffffffff)
+				if (inbuf_ofs < scan_end) {
+					inbuf_ofs = skip_erased(buf, inbuf_ofs,
+								scan_end);
+					ofs = buf_ofs + inbuf_ofs;
+					if (inbuf_ofs < scan_end)
 						goto scan_more;
-
-					inbuf_ofs += 4;
-					ofs += 4;
 				}
 				/* Ran off end. */
 				/*
@@ -1634,9 +1715,10 @@ jffs2_1pass_build_lists(struct part_info * part)
 					break;
 
 				/* See how much more there is to read in this
-				 * eraseblock...
+				 * eraseblock, in large chunks as it is likely
+				 * to be erased as well...
 				 */
-				buf_len = min_t(uint32_t, buf_size,
+				buf_len = min_t(uint32_t, EMPTY_READ_SIZE,
 						sector_ofs +
 						part->sector_size - ofs);
 				if (!buf_len) {
@@ -1688,8 +1770,12 @@ jffs2_1pass_build_lists(struct part_info * part)
 				if (!inode_crc((struct jffs2_raw_inode *)node))
 					break;
 
-				if (insert_node(&pL->frag, (u32) part->offset +
-						ofs) == NULL) {
+				if (insert_node(&pL->frag, &pL->frags,
+						((struct jffs2_raw_inode *)
+						 node)->ino,
+						((struct jffs2_raw_inode *)
+						 node)->version,
+						(u32) part->offset + ofs) == NULL) {
 					free(buf);
 					jffs2_free_cache(part);
 					return 0;
@@ -1723,8 +1809,12 @@ jffs2_1pass_build_lists(struct part_info * part)
 					break;
 				if (! (counterN%100))
 					puts ("\b\b.  ");
-				if (insert_node(&pL->dir, (u32) part->offset +
-						ofs) == NULL) {
+				if (insert_node(&pL->dir, &pL->dirs,
+						((struct jffs2_raw_dirent *)
+						 node)->pino,
+						((struct jffs2_raw_dirent *)
+						 node)->version,
+						(u32) part->offset + ofs) == NULL) {
 					free(buf);
 					jffs2_free_cache(part);
 					return 0;
@@ -1770,13 +1860,12 @@ jffs2_1pass_build_lists(struct part_info * part)
 	}
 
 	free(buf);
-#if defined(CONFIG_SYS_JFFS2_SORT_FRAGMENTS)
 	/*
-	 * Sort the lists.
+	 * Sort the nodes of each inode. Data nodes are always sorted by
+	 * version, directory entries only with SORT_FRAGMENTS.
 	 */
-	sort_list(&pL->frag);
-	sort_list(&pL->dir);
-#endif
+	sort_groups(&pL->frags);
+	sort_groups(&pL->dirs);
 	putstr("\b\b done.\r\n");		/* close off the dots */
 
 	/* We don't care if malloc failed - then each read operation will
@@ -1813,6 +1902,7 @@ jffs2_1pass_build_lists(struct part_info * part)
 static u32
 jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 {
+	struct rb_node *rb;
 	struct b_node *b;
 	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
@@ -1824,16 +1914,20 @@ jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 		piL->compr_info[i].decompr_sum = 0;
 	}
 
-	b = pL->frag.listHead;
-	while (b) {
-		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
-			sizeof(ojNode), &ojNode);
-		if (jNode->compr < JFFS2_NUM_COMPR) {
-			piL->compr_info[jNode->compr].num_frags++;
-			piL->compr_info[jNode->compr].compr_sum += jNode->csize;
-			piL->compr_info[jNode->compr].decompr_sum += jNode->dsize;
+	for (rb = rb_first(&pL->frags); rb; rb = rb_next(rb)) {
+		b = rb_entry(rb, struct b_inode, node)->nodes.listHead;
+		while (b) {
+			jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
+				sizeof(ojNode), &ojNode);
+			if (jNode->compr < JFFS2_NUM_COMPR) {
+				piL->compr_info[jNode->compr].num_frags++;
+				piL->compr_info[jNode->compr].compr_sum +=
+					jNode->csize;
+				piL->compr_info[jNode->compr].decompr_sum +=
+					jNode->dsize;
+			}
+			b = b->next;
 		}
-		b = b->next;
 	}
 	return 0;
 }
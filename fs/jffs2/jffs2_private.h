@@ -2,10 +2,12 @@
 #define jffs2_private_h
 
 #include <jffs2/jffs2.h>
+#include <linux/rbtree.h>
 
 
 struct b_node {
 	u32 offset;
+	u32 version;
 	struct b_node *next;
 	enum { CRC_UNKNOWN = 0, CRC_OK, CRC_BAD } datacrc;
 };
@@ -15,16 +17,25 @@ struct b_list {
 	struct b_node *listHead;
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
 	struct b_node *listLast;
-	int (*listCompare)(struct b_node *new, struct b_node *node);
 	u32 listLoops;
 #endif
+	int (*listCompare)(struct b_node *new, struct b_node *node);
 	u32 listCount;
 	struct mem_block *listMemBase;
 };
 
+/* The nodes sharing one inode number, kept in an rbtree by that number */
+struct b_inode {
+	struct rb_node node;
+	u32 ino;
+	struct b_list nodes;
+};
+
 struct b_lists {
-	struct b_list dir;
-	struct b_list frag;
+	struct b_list dir;	/* allocates all dirent nodes */
+	struct b_list frag;	/* allocates all data nodes */
+	struct rb_root dirs;	/* dirent nodes grouped by parent inode */
+	struct rb_root frags;	/* data nodes grouped by inode */
 	void *readbuf;
 };
 
@@ -90,7 +101,7 @@ static inline int
 data_crc(struct jffs2_raw_inode *node)
 {
 	if (node->data_crc != crc32_no_comp(0, (unsigned char *)
-					    ((int) &node->node_crc + sizeof (node->node_crc)),
+					    ((uintptr_t) &node->node_crc + sizeof (node->node_crc)),
 					     node->csize)) {
 		return 0;
 	} else {
@@ -98,8 +109,6 @@ data_crc(struct jffs2_raw_inode *node)
 	}
 }
 
-#if defined(CONFIG_SYS_JFFS2_SORT_FRAGMENTS)
 /* External merge sort. */
 int sort_list(struct b_list *list);
-#endif
 #endif /* jffs2_private.h */
@@ -13,7 +13,7 @@
 
 int sort_list(struct b_list *list)
 {
-	struct b_node *p, *q, *e, **tail;
+	struct b_node *p, *q, *e = list->listTail, **tail;
 	int k, psize, qsize;
 
 	if (!list->listHead)
@@ -48,5 +48,7 @@ int sort_list(struct b_list *list)
 			}
 		}
 	}
+	/* the last element merged in the final pass is the new tail */
+	list->listTail = e;
 	return 0;
 }
@@ -787,15 +787,113 @@ error:
 	return err;
 }
 
+/**
+ * do_bulk_read - read a run of full blocks using bulk-read.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @bu: bulk-read information, @bu->buf must be allocated
+ * @addr: destination address of block @block
+ * @block: first block to read
+ * @count: number of blocks to read
+ *
+ * This function looks up the data nodes following @block with a single TNC
+ * walk, reads all of them that are consecutive in the same LEB with one flash
+ * read and decompresses them straight to their final destination. Holes are
+ * zero-filled. Returns the number of blocks filled in (at least one) or a
+ * negative error code in case of failure.
+ */
+static int do_bulk_read(struct ubifs_info *c, struct inode *inode,
+			struct bu_info *bu, void *addr, unsigned int block,
+			unsigned int count)
+{
+	unsigned int next = block, end = block + count, blk;
+	struct ubifs_data_node *dn = NULL;
+	void *buf = bu->buf;
+	int err, i;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+
+	/*
+	 * No data node was found within UBIFS_MAX_BULK_READ blocks, so the
+	 * first @bu->blk_cnt blocks are a hole.
+	 */
+	if (!bu->cnt && !bu->eof) {
+		next = block + min_t(unsigned int, max(bu->blk_cnt, 1), count);
+		memset(addr, 0, (next - block) * UBIFS_BLOCK_SIZE);
+		return next - block;
+	}
+
+	if (bu->cnt) {
+		err = ubifs_tnc_bulk_read(c, bu);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < bu->cnt; i++) {
+		int len, out_len, dlen;
+		void *dst;
+
+		dn = buf;
+		blk = key_block(c, &bu->zbranch[i].key);
+		if (blk >= end)
+			break;
+
+		/* Blocks without data node are holes */
+		if (blk > next)
+			memset(addr + (next - block) * UBIFS_BLOCK_SIZE, 0,
+			       (blk - next) * UBIFS_BLOCK_SIZE);
+
+		len = le32_to_cpu(dn->size);
+		if (len <= 0 || len > UBIFS_BLOCK_SIZE)
+			goto dump;
+
+		dst = addr + (blk - block) * UBIFS_BLOCK_SIZE;
+		dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
+		out_len = UBIFS_BLOCK_SIZE;
+		err = ubifs_decompress(&dn->data, dlen, dst, &out_len,
+				       le16_to_cpu(dn->compr_type));
+		if (err || len != out_len)
+			goto dump;
+
+		if (len < UBIFS_BLOCK_SIZE)
+			memset(dst + len, 0, UBIFS_BLOCK_SIZE - len);
+
+		next = blk + 1;
+		buf += ALIGN(bu->zbranch[i].len, 8);
+	}
+
+	/*
+	 * If the next data node lies beyond the requested range, or there are
+	 * no more data nodes for this inode, the rest of the range is a hole.
+	 */
+	if (i < bu->cnt || bu->eof) {
+		memset(addr + (next - block) * UBIFS_BLOCK_SIZE, 0,
+		       (end - next) * UBIFS_BLOCK_SIZE);
+		next = end;
+	}
+
+	return next - block;
+
+dump:
+	ubifs_err("bad data node (block %u, inode %lu)", blk, inode->i_ino);
+	ubifs_dump_node(c, dn);
+	return -EINVAL;
+}
+
 int ubifs_load(char *filename, u32 addr, u32 size)
 {
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum;
 	struct inode *inode;
 	struct page page;
+	struct bu_info *bu;
 	int err = 0;
 	int i;
-	int count;
+	int count, full;
 	int last_block_size = 0;
 
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
@@ -831,7 +929,37 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	page.addr = (void *)addr;
 	page.index = 0;
 	page.inode = inode;
-	for (i = 0; i < count; i++) {
+
+	/*
+	 * Read all blocks which are completely inside the requested size
+	 * with bulk-read. Fall back to page-by-page reads if the bulk-read
+	 * buffer cannot be allocated.
+	 */
+	full = size >> UBIFS_BLOCK_SHIFT;
+	bu = kmalloc(sizeof(struct bu_info), GFP_NOFS);
+	if (bu)
+		bu->buf = malloc_cache_aligned(c->max_bu_buf_len);
+	if (!bu || !bu->buf)
+		full = 0;
+
+	i = 0;
+	while (i < full) {
+		err = do_bulk_read(c, inode, bu, page.addr, i, full - i);
+		if (err < 0)
+			break;
+
+		page.addr += err * PAGE_SIZE;
+		page.index += err;
+		i += err;
+		err = 0;
+	}
+
+	if (bu) {
+		free(bu->buf);
+		kfree(bu);
+	}
+
+	for (; !err && i < count; i++) {
 		/*
 		 * Make sure to not read beyond the requested size
 		 */
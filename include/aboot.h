@@ -23,6 +23,41 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * struct sparse_stream - state of a sparse image written piecewise
+ *
+ * The image is passed to sparse_stream_write() in pieces of any size, so
+ * that it can be flashed while it is still being received. Images which
+ * are not sparse are written as they are.
+ */
+struct sparse_stream {
+	block_dev_desc_t *dev_desc;
+	disk_partition_t *info;
+	const char *part_name;
+	int state;
+	int err;			/* first error, reported to fastboot */
+	sparse_header_t sparse_header;
+	chunk_header_t chunk_header;
+	unsigned int hdr_bytes;		/* bytes of a header gathered so far */
+	unsigned int skip_bytes;	/* bytes to drop before the next field */
+	unsigned int chunk;		/* index of the current chunk */
+	unsigned int chunk_bytes;	/* data left in the current raw chunk */
+	uint32_t fill_val;
+	uint32_t *fill_buf;
+	unsigned int fill_blks;		/* size of fill_buf in blocks */
+	char *blk_buf;			/* partial block carried to next write */
+	unsigned int blk_buf_len;
+	lbaint_t blk;			/* next block to write */
+	uint32_t total_blocks;
+	u64 bytes_written;
+};
+
+int sparse_stream_init(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+		       disk_partition_t *info, const char *part_name);
+int sparse_stream_write(struct sparse_stream *s, const void *data,
+			unsigned int len);
+int sparse_stream_finish(struct sparse_stream *s);
+
 void write_sparse_image(block_dev_desc_t *dev_desc,
 		disk_partition_t *info, const char *part_name,
 		void *data, unsigned sz);
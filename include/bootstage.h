@@ -199,6 +199,10 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_SPI,
 	BOOTSTAGE_ID_ACCUM_DECOMP,
 
+	BOOTSTAGE_ID_SPL_INIT_DONE,
+	BOOTSTAGE_ID_SPL_LOAD_DONE,
+	BOOTSTAGE_ID_END_SPL,
+
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
 	BOOTSTAGE_ID_COUNT = BOOTSTAGE_ID_USER + CONFIG_BOOTSTAGE_USER_COUNT,
@@ -224,8 +228,8 @@ void show_boot_progress(int val);
 #define show_boot_progress(val) do {} while (0)
 #endif
 
-#if defined(CONFIG_BOOTSTAGE) && !defined(CONFIG_SPL_BUILD) && \
-	!defined(USE_HOSTCC)
+#if defined(CONFIG_BOOTSTAGE) && !defined(USE_HOSTCC) && \
+	(!defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_BOOTSTAGE))
 /* This is the full bootstage implementation */
 
 /**
@@ -17,6 +17,26 @@ extern int u_boot_hush_start(void);
 extern int parse_string_outer(const char *, int);
 extern int parse_file_outer(void);
 
+/**
+ * run_env_script() - Run a script from an environment variable
+ *
+ * The parsed script is kept and run again as long as the variable is not
+ * changed, instead of parsing it each time.
+ *
+ * @name:	Name of the environment variable
+ * @script:	Its value
+ * @return 0 on success, 1 on error, as parse_string_outer()
+ */
+int run_env_script(const char *name, const char *script);
+
+/**
+ * hush_script_cached() - Check whether a variable has a parsed script kept
+ *
+ * @name:	Name of the environment variable
+ * @return 1 if the script of @name is cached, 0 if not
+ */
+int hush_script_cached(const char *name);
+
 int set_local_var(const char *s, int flg_export);
 void unset_local_var(const char *name);
 char *get_local_var(const char *s);
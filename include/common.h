@@ -787,6 +787,15 @@ int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
 
+/*
+ * CPUs for gzip_parallel() and gzwrite(): how many workers can run at once
+ * (1 unless overridden), and run func(arg, n) for n = 0 to count - 1, at the
+ * same time if possible. Worker 0 runs on the calling CPU.
+ */
+int gzip_parallel_workers(void);
+void gzip_parallel_run(void (*func)(void *arg, int worker), void *arg,
+		       int count);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
@@ -819,12 +828,17 @@ void gzwrite_progress_finish(int retcode,
  * @param	szexpected	expected uncompressed length
  *				may be zero to use gzip trailer
  *				for files under 4GiB
+ * @param	flags		GZWRITE_... flags
  */
 int gzwrite(unsigned char *src, int len,
 	    struct block_dev_desc *dev,
 	    unsigned long szwritebuf,
 	    u64 startoffs,
-	    u64 szexpected);
+	    u64 szexpected,
+	    uint flags);
+
+/* gzwrite() flags */
+#define GZWRITE_ERASE_ZERO	(1 << 0)	/* erase buffers of zeroes */
 
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
@@ -915,6 +929,9 @@ int gzip(void *dst, unsigned long *lenp,
 int zzip(void *dst, unsigned long *lenp, unsigned char *src,
 		unsigned long srclen, int stoponerr,
 		int (*func)(unsigned long, unsigned long));
+/* Compress as independent blocks, see CONFIG_GZIP_PARALLEL in README */
+int gzip_parallel(void *dst, unsigned long *lenp, unsigned char *src,
+		  unsigned long srclen);
 
 /* lib/net_utils.c */
 #include <net.h>
@@ -42,6 +42,10 @@
 #define CONFIG_EXT4_WRITE
 #endif
 
+#if defined(CONFIG_CMD_JFFS2) && !defined(CONFIG_RBTREE)
+#define CONFIG_RBTREE
+#endif
+
 /* Rather than repeat this expression each time, add a define for it */
 #if defined(CONFIG_CMD_IDE) || \
 	defined(CONFIG_CMD_SATA) || \
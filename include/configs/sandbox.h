@@ -50,6 +50,10 @@
 
 #define CONFIG_CMD_GPIO
 
+/* MMC - the sandbox host emulates an eMMC and an SD card */
+#define CONFIG_GENERIC_MMC
+#define CONFIG_CMD_MMC
+
 #define CONFIG_CMD_GPT
 #define CONFIG_PARTITION_UUIDS
 #define CONFIG_EFI_PARTITION
@@ -205,7 +209,10 @@
 	BOOTENV \
 	MEM_LAYOUT_ENV_SETTINGS
 
+#define CONFIG_BCH
+
 #define CONFIG_GZIP_COMPRESSED
+#define CONFIG_GZIP_PARALLEL
 #define CONFIG_BZIP2
 #define CONFIG_LZO
 #define CONFIG_LZMA
@@ -88,6 +88,9 @@ struct sf_internal_data {
 #ifndef CONFIG_SYS_DFU_MAX_FILE_SIZE
 #define CONFIG_SYS_DFU_MAX_FILE_SIZE CONFIG_SYS_DFU_DATA_BUF_SIZE
 #endif
+#ifndef CONFIG_SYS_DFU_WRITE_STEP
+#define CONFIG_SYS_DFU_WRITE_STEP	(16 * 1024)
+#endif
 #ifndef DFU_DEFAULT_POLL_TIMEOUT
 #define DFU_DEFAULT_POLL_TIMEOUT 0
 #endif
@@ -102,6 +105,7 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	unsigned long           write_step;	/* see dfu_write_poll() */
 
 	union {
 		struct mmc_internal_data mmc;
@@ -137,6 +141,17 @@ struct dfu_entity {
 
 	u32 bad_skip;	/* for nand use */
 
+	/* transfer statistics, in ms */
+	ulong start_time;
+	ulong write_time;
+
+#ifdef CONFIG_DFU_DOUBLE_BUF
+	/* buffer being written by dfu_write_poll() */
+	u8 *w_buf;
+	long w_left;
+	int w_err;
+#endif
+
 	unsigned int inited:1;
 };
 
@@ -163,6 +178,20 @@ int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 
+/**
+ * dfu_write_poll - write out some of the data received by dfu_write()
+ *
+ * With CONFIG_DFU_DOUBLE_BUF, dfu_write() continues receiving into a second
+ * buffer once the first one is full, and the full one is written by this
+ * function, called from the USB polling loop. Media setting write_step are
+ * written in pieces of that size per call; others are written at once.
+ */
+#ifdef CONFIG_DFU_DOUBLE_BUF
+void dfu_write_poll(void);
+#else
+static inline void dfu_write_poll(void) {}
+#endif
+
 /**
  * dfu_write_from_mem_addr - write data from memory to DFU managed medium
  *
@@ -7,3 +7,12 @@
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes, char *response);
 void fb_mmc_erase(const char *cmd, char *response);
+
+/*
+ * Flash an image to partition @cmd while it is being downloaded: start,
+ * then write the image in pieces of any size, then finish. The partition
+ * name must stay valid until fb_mmc_stream_finish().
+ */
+int fb_mmc_stream_start(const char *cmd, char *response);
+int fb_mmc_stream_write(const void *buf, unsigned int len, char *response);
+int fb_mmc_stream_finish(char *response);
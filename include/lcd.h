@@ -38,6 +38,29 @@ int bmp_display(ulong addr, int x, int y);
  */
 void lcd_set_flush_dcache(int flush);
 
+/**
+ * Let the console scroll by moving the start of the displayed area, for
+ * controllers which can scan out from any line of the frame buffer. The
+ * console then only copies the screen once it has used up the spare lines,
+ * instead of on every scroll. This is only used for unrotated consoles
+ * without a logo above them. The driver must reserve the spare lines after
+ * the panel height itself, by overriding lcd_get_size().
+ *
+ * @param spare_lines	number of frame buffer lines after the panel height,
+ *			0 to scroll by copying the screen
+ * @param set_offset	called with the frame buffer line to display first
+ */
+void lcd_set_hw_scroll(int spare_lines, void (*set_offset)(int line));
+
+/**
+ * Get the hardware scrolling set up by lcd_set_hw_scroll(), e.g. to put it
+ * back after changing it
+ *
+ * @param spare_lines	returns the number of spare lines
+ * @param set_offset	returns the offset function, NULL if there is none
+ */
+void lcd_get_hw_scroll(int *spare_lines, void (**set_offset)(int line));
+
 #if defined CONFIG_MPC823
 #include <mpc823_lcd.h>
 #elif defined(CONFIG_CPU_PXA25X) || defined(CONFIG_CPU_PXA27X) || \
@@ -132,6 +155,9 @@ int lcd_get_size(int *line_length);
 /* Update the LCD / flush the cache */
 void lcd_sync(void);
 
+/* Update the LCD / flush the cache for the frame buffer from start to end */
+void lcd_sync_range(void *start, void *end);
+
 /*
  *  Information about displays we are using. This is for configuring
  *  the LCD controller and memory allocation. Someone has to know what
@@ -14,6 +14,11 @@ struct console_t {
 	short cols, rows;
 	void *fbbase;
 	u32 lcdsizex, lcdsizey, lcdrot;
+	/* Hardware scrolling: fbbase is scroll_pos lines after fbstart */
+	void *fbstart;
+	u32 scroll_lines, scroll_pos;
+	/* Part of the frame buffer changed since the last sync */
+	void *dirty_start, *dirty_end;
 	void (*fp_putc_xy)(struct console_t *pcons, ushort x, ushort y, char c);
 	void (*fp_console_moverow)(struct console_t *pcons,
 				   u32 rowdst, u32 rowsrc);
@@ -41,6 +46,25 @@ void console_calc_rowcol(struct console_t *pcons, u32 sizex, u32 sizey);
  * @vl_rot: Rotation of display in degree (0 - 90 - 180 - 270) counterlockwise
  */
 void lcd_init_console(void *address, int vl_cols, int vl_rows, int vl_rot);
+/**
+ * lcd_console_unscroll() - Undo hardware scrolling of the console
+ *
+ * Move the visible screen back to the start of the frame buffer, so that
+ * drawing relative to that start shows up on the screen again.
+ */
+void lcd_console_unscroll(void);
+/**
+ * lcd_console_save() - Copy the state of the console
+ *
+ * @pcons: Where to put the state
+ */
+void lcd_console_save(struct console_t *pcons);
+/**
+ * lcd_console_restore() - Put back a state saved by lcd_console_save()
+ *
+ * @pcons: The saved state
+ */
+void lcd_console_restore(const struct console_t *pcons);
 /**
  * lcd_set_col() - Set the number of the current lcd console column
  *
@@ -56,8 +56,26 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_CMD23		(1 << 6)	/* SET_BLOCK_COUNT before writes */
+#define MMC_MODE_HS200		(1 << 7)	/* eMMC 200MHz SDR, 1.8V */
+#define MMC_MODE_HS400		(1 << 8)	/* eMMC 200MHz DDR, 1.8V */
+#define MMC_MODE_UHS_SDR50	(1 << 9)	/* SD 100MHz, 1.8V */
+#define MMC_MODE_UHS_SDR104	(1 << 10)	/* SD 208MHz, 1.8V */
+
+/* Bus timing selected by the core, for the host's set_ios() */
+#define MMC_TIMING_LEGACY	0
+#define MMC_TIMING_HS		1
+#define MMC_TIMING_UHS_SDR50	2
+#define MMC_TIMING_UHS_SDR104	3
+#define MMC_TIMING_MMC_HS200	4
+#define MMC_TIMING_MMC_HS400	5
+
+#define MMC_SIGNAL_VOLTAGE_330	0
+#define MMC_SIGNAL_VOLTAGE_180	1
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_DATA_STAT_AFTER_ERASE	0x00800000
+#define SD_CMD23_SUPPORT	0x00000002
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -86,6 +104,8 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK	19
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -115,13 +135,23 @@
 /* SCR definitions in different words */
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
+#define SD_SDR50_SUPPORTED	0x00040000
+#define SD_SDR104_SUPPORTED	0x00080000
+
+/* Access modes (function group 1) for SD_CMD_SWITCH_FUNC */
+#define SD_MODE_HIGHSPEED	1
+#define SD_MODE_UHS_SDR50	2
+#define SD_MODE_UHS_SDR104	3
 
 #define OCR_BUSY		0x80000000
 #define OCR_HCS			0x40000000
 #define OCR_VOLTAGE_MASK	0x007FFF80
 #define OCR_ACCESS_MODE		0x60000000
+#define OCR_S18R		0x01000000	/* SD: switch to 1.8V I/O */
 
 #define SECURE_ERASE		0x80000000
+#define MMC_ERASE_ARG		0x00000000
+#define MMC_TRIM_ARG		0x00000001
 
 #define MMC_STATUS_MASK		(~0x0206BF7F)
 #define MMC_STATUS_SWITCH_ERROR	(1 << 7)
@@ -176,6 +206,7 @@
 #define EXT_CSD_WR_REL_SET		167	/* R/W */
 #define EXT_CSD_RPMB_MULT		168	/* RO */
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
@@ -186,6 +217,7 @@
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
 
 /*
  * EXT_CSD field definitions
@@ -201,6 +233,15 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)
+#define EXT_CSD_CARD_TYPE_HS400_1_8V	(1 << 6)
+#define EXT_CSD_CARD_TYPE_HS400_1_2V	(1 << 7)
+
+#define EXT_CSD_TIMING_LEGACY	0	/* HS_TIMING values */
+#define EXT_CSD_TIMING_HS	1
+#define EXT_CSD_TIMING_HS200	2
+#define EXT_CSD_TIMING_HS400	3
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -228,6 +269,8 @@
 
 #define EXT_CSD_HS_CTRL_REL	(1 << 0)	/* host controlled WR_REL_SET */
 
+#define EXT_CSD_SEC_GB_CL_EN	(1 << 4)	/* TRIM is supported */
+
 #define EXT_CSD_WR_DATA_REL_USR		(1 << 0)	/* user data area WR_REL */
 #define EXT_CSD_WR_DATA_REL_GP(x)	(1 << ((x)+1))	/* GP part (x+1) WR_REL */
 
@@ -324,6 +367,24 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/*
+	 * Optional, needed for UHS-I and HS200: switch the I/O lines to
+	 * @voltage (MMC_SIGNAL_VOLTAGE_...) after SD_CMD_SWITCH_UHS18V or
+	 * before HS200, stopping the clock while doing so
+	 */
+	int (*set_signal_voltage)(struct mmc *mmc, uint voltage);
+	/*
+	 * Optional, needed for SDR104 and HS200: find a working sampling
+	 * point, typically with mmc_send_tuning(mmc, opcode)
+	 */
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
+	/*
+	 * Optional: switch the card's power off and on again, which is the
+	 * only way back to 3.3V for an SD card at 1.8V. Return -ENOSYS if
+	 * the board cannot switch it. Without this, a card left at 1.8V by
+	 * an earlier init keeps running at 1.8V.
+	 */
+	int (*power_cycle)(struct mmc *mmc);
 };
 
 struct mmc_config {
@@ -364,6 +425,8 @@ struct mmc {
 	uint read_bl_len;
 	uint write_bl_len;
 	uint erase_grp_size;	/* in 512-byte sectors */
+	char can_trim;		/* 1 if blocks can be erased singly */
+	char erase_zeroes;	/* 1 if erased blocks read back as zeroes */
 	uint hc_wp_grp_size;	/* in 512-byte sectors */
 	u64 capacity;
 	u64 capacity_user;
@@ -377,6 +440,8 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	uint timing;		/* MMC_TIMING_... */
+	uint signal_voltage;	/* MMC_SIGNAL_VOLTAGE_... */
 };
 
 struct mmc_hwpart_conf {
@@ -407,6 +472,9 @@ int mmc_initialize(bd_t *bis);
 int mmc_init(struct mmc *mmc);
 int mmc_read(struct mmc *mmc, u64 src, uchar *dst, int size);
 void mmc_set_clock(struct mmc *mmc, uint clock);
+int mmc_send_tuning(struct mmc *mmc, uint opcode);
+extern const u8 tuning_blk_pattern_4bit[64];
+extern const u8 tuning_blk_pattern_8bit[128];
 struct mmc *find_mmc_device(int dev_num);
 int mmc_set_dev(int dev_num);
 void print_mmc_devices(char separator);
@@ -10,6 +10,17 @@
 #ifndef __TFTP_H__
 #define __TFTP_H__
 
+/* Error codes in TFTP ERROR packets */
+enum {
+	TFTP_ERR_UNDEFINED           = 0,
+	TFTP_ERR_FILE_NOT_FOUND      = 1,
+	TFTP_ERR_ACCESS_DENIED       = 2,
+	TFTP_ERR_DISK_FULL           = 3,
+	TFTP_ERR_UNEXPECTED_OPCODE   = 4,
+	TFTP_ERR_UNKNOWN_TRANSFER_ID  = 5,
+	TFTP_ERR_FILE_ALREADY_EXISTS = 6,
+};
+
 /**********************************************************************/
 /*
  *	Global functions and variables.
@@ -24,6 +35,7 @@ void tftp_start_server(void);	/* Wait for incoming TFTP put */
 
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
+extern int tftp_error;
 
 /**********************************************************************/
 
@@ -170,6 +170,29 @@ void os_usleep(unsigned long usec);
  */
 uint64_t os_get_nsec(void);
 
+/**
+ * os_get_cpu_count() - Get the number of CPUs available on the host
+ *
+ * @return number of CPUs, at least 1
+ */
+int os_get_cpu_count(void);
+
+/**
+ * os_run_parallel() - Run a function on several host threads at once
+ *
+ * Each thread calls @func with @arg and its own number, from 0 to
+ * @count - 1. This returns when all of them have finished. The function
+ * must not call U-Boot's malloc() or print anything.
+ *
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @count:	Number of threads
+ * @return 0 if OK, -1 if the threads could not be started, in which case
+ *	@func has not been called
+ */
+int os_run_parallel(void (*func)(void *arg, int thread), void *arg,
+		    int count);
+
 /**
  * Parse arguments and update sandbox state.
  *
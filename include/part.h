@@ -191,6 +191,27 @@ int get_partition_info_efi (block_dev_desc_t * dev_desc, int part, disk_partitio
  */
 int get_partition_info_efi_by_name(block_dev_desc_t *dev_desc,
 	const char *name, disk_partition_t *info);
+/**
+ * get_partition_info_efi_by_uuid() - Find the GPT partition with a given UUID
+ *
+ * @param dev_desc - block device descriptor
+ * @param uuid - the partition UUID, as a GUID string
+ * @param info - returns the disk partition info
+ *
+ * @return - '0' on match, '-1' on no match, otherwise error
+ */
+int get_partition_info_efi_by_uuid(block_dev_desc_t *dev_desc,
+	const char *uuid, disk_partition_t *info);
+/**
+ * gpt_cache_invalidate() - Forget the GPT read from a device
+ *
+ * The GPT of a device is kept once read and checked. This must be called
+ * when the device changes other than through write_gpt_table() or
+ * write_mbr_and_gpt_partitions(), which call it themselves.
+ *
+ * @param dev_desc - block device descriptor
+ */
+void gpt_cache_invalidate(block_dev_desc_t *dev_desc);
 void print_part_efi (block_dev_desc_t *dev_desc);
 int   test_part_efi (block_dev_desc_t *dev_desc);
 
@@ -64,6 +64,7 @@
 #define  SDHCI_CARD_STATE_STABLE	0x00020000
 #define  SDHCI_CARD_DETECT_PIN_LEVEL	0x00040000
 #define  SDHCI_WRITE_PROTECT	0x00080000
+#define  SDHCI_DATA_LVL_MASK	0x00F00000
 
 #define SDHCI_HOST_CONTROL	0x28
 #define  SDHCI_CTRL_LED		0x01
@@ -144,7 +145,17 @@
 
 #define SDHCI_ACMD12_ERR	0x3C
 
-/* 3E-3F reserved */
+#define SDHCI_HOST_CONTROL2	0x3E
+#define  SDHCI_CTRL_UHS_MASK	0x0007
+#define   SDHCI_CTRL_UHS_SDR12	0x0000
+#define   SDHCI_CTRL_UHS_SDR25	0x0001
+#define   SDHCI_CTRL_UHS_SDR50	0x0002
+#define   SDHCI_CTRL_UHS_SDR104	0x0003
+#define   SDHCI_CTRL_UHS_DDR50	0x0004
+#define   SDHCI_CTRL_HS400	0x0005	/* SDHCI_QUIRK_HS400 only */
+#define  SDHCI_CTRL_VDD_180	0x0008
+#define  SDHCI_CTRL_EXEC_TUNING	0x0040
+#define  SDHCI_CTRL_TUNED_CLK	0x0080
 
 #define SDHCI_CAPABILITIES	0x40
 #define  SDHCI_TIMEOUT_CLK_MASK	0x0000003F
@@ -166,6 +177,9 @@
 #define  SDHCI_CAN_64BIT	0x10000000
 
 #define SDHCI_CAPABILITIES_1	0x44
+#define  SDHCI_SUPPORT_SDR50	0x00000001
+#define  SDHCI_SUPPORT_SDR104	0x00000002
+#define  SDHCI_SUPPORT_DDR50	0x00000004
 
 #define SDHCI_MAX_CURRENT	0x48
 
@@ -179,6 +193,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -214,6 +229,8 @@
 #define SDHCI_QUIRK_WAIT_SEND_CMD	(1 << 6)
 #define SDHCI_QUIRK_NO_SIMULT_VDD_AND_POWER (1 << 7)
 #define SDHCI_QUIRK_USE_WIDE8		(1 << 8)
+/* HS400 is selected with the non-standard UHS mode 5 in HOST_CONTROL2 */
+#define SDHCI_QUIRK_HS400		(1 << 9)
 
 /* to make gcc happy */
 struct sdhci_host;
@@ -223,6 +240,32 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/* Tuning blocks tried before the controller gives up, as per the spec */
+#define SDHCI_TUNING_LOOPS		40
+
+/*
+ * ADMA2 descriptor. The high half of the address is only there with
+ * 64-bit addressing, otherwise descriptors are 8 bytes apart.
+ */
+struct sdhci_adma_desc {
+	u16 attr;
+	u16 len;
+	u32 addr_lo;
+	u32 addr_hi;
+};
+
+#define SDHCI_ADMA_VALID		(1 << 0)
+#define SDHCI_ADMA_END			(1 << 1)
+#define SDHCI_ADMA_INT			(1 << 2)
+#define SDHCI_ADMA_ACT_TRAN		(2 << 4)
+
+/* Most bytes per descriptor, keeping the next address 32-bit aligned */
+#define SDHCI_ADMA_MAX_LEN		65532
+#define SDHCI_ADMA_DESC_NUM		\
+	DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * MMC_MAX_BLOCK_LEN, \
+		     SDHCI_ADMA_MAX_LEN)
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32             (*read_l)(struct sdhci_host *host, int reg);
@@ -251,8 +294,13 @@ struct sdhci_host {
 
 	void (*set_control_reg)(struct sdhci_host *host);
 	void (*set_clock)(int dev_index, unsigned int div);
+	/* Optional: switch an external I/O regulator for UHS-I cards */
+	int (*set_signal_voltage)(struct sdhci_host *host, uint voltage);
 	uint	voltages;
 
+	struct sdhci_adma_desc *adma_desc;	/* CONFIG_MMC_SDHCI_ADMA */
+	bool adma_64;			/* 64-bit ADMA2 addressing */
+
 	struct mmc_config cfg;
 };
 
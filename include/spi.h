@@ -23,6 +23,10 @@
 #define	SPI_LOOP	0x20			/* loopback mode */
 #define	SPI_SLAVE	0x40			/* slave mode */
 #define	SPI_PREAMBLE	0x80			/* Skip preamble bytes */
+#define	SPI_TX_DUAL	0x100			/* transmit with 2 wires */
+#define	SPI_TX_QUAD	0x200			/* transmit with 4 wires */
+#define	SPI_RX_DUAL	0x400			/* receive with 2 wires */
+#define	SPI_RX_QUAD	0x800			/* receive with 4 wires */
 
 /* SPI transfer flags */
 #define SPI_XFER_BEGIN		0x01	/* Assert CS before transfer */
@@ -82,6 +86,36 @@ struct dm_spi_slave_platdata {
 	uint mode;
 };
 
+/**
+ * struct spi_mem_read - description of a complete SPI flash read
+ *
+ * This is passed to the mem_read() operation, which lets a controller
+ * perform a whole flash read in one go (e.g. through its direct-mapped or
+ * indirect read engine) instead of as a series of spi_xfer() calls. Unlike
+ * spi_xfer() it carries the number of lanes used for each phase, so it can
+ * describe dual/quad I/O commands which send the address on several lanes.
+ *
+ * @opcode:	Read opcode, always sent on a single lane
+ * @addr:	Flash address of the first byte to read
+ * @addr_len:	Number of address bytes (3 or 4)
+ * @addr_lanes:	Number of lanes used for the address and dummy phase
+ * @dummy_cycles: Number of clock cycles between the address and the data,
+ *		including any mode bits
+ * @data_lanes:	Number of lanes used for the data phase
+ * @buf:	Buffer to put the data that is read
+ * @len:	Number of bytes to read
+ */
+struct spi_mem_read {
+	u8 opcode;
+	u32 addr;
+	u8 addr_len;
+	u8 addr_lanes;
+	u8 dummy_cycles;
+	u8 data_lanes;
+	void *buf;
+	size_t len;
+};
+
 #endif /* CONFIG_DM_SPI */
 
 /**
@@ -484,6 +518,24 @@ struct dm_spi_ops {
 	 *	   is invalid, other -ve value on error
 	 */
 	int (*cs_info)(struct udevice *bus, uint cs, struct spi_cs_info *info);
+
+	/**
+	 * Read from a SPI flash in a single operation
+	 *
+	 * This is optional. Controllers which can run a complete flash read
+	 * (opcode, address, dummy cycles and data) themselves should provide
+	 * it, since it avoids splitting the read into spi_xfer() calls and
+	 * allows dual/quad I/O read commands to be used.
+	 *
+	 * The bus is claimed by the caller.
+	 *
+	 * @dev:	The SPI slave
+	 * @op:		Description of the read
+	 * @return 0 if OK, -ENOSYS if this particular read cannot be done
+	 *	   (the caller then falls back to spi_xfer()), other -ve value
+	 *	   on error
+	 */
+	int (*mem_read)(struct udevice *dev, const struct spi_mem_read *op);
 };
 
 struct dm_spi_emul_ops {
@@ -585,6 +637,19 @@ int spi_find_chip_select(struct udevice *bus, int cs, struct udevice **devp);
 int spi_slave_ofdata_to_platdata(const void *blob, int node,
 				 struct dm_spi_slave_platdata *plat);
 
+/**
+ * spi_mem_read() - Read from a SPI flash in a single operation
+ *
+ * See the mem_read() operation in struct dm_spi_ops. The bus must already be
+ * claimed.
+ *
+ * @slave:	The SPI slave
+ * @op:		Description of the read
+ * @return 0 if OK, -ENOSYS if the controller cannot do this read, other -ve
+ *	   value on error
+ */
+int spi_mem_read(struct spi_slave *slave, const struct spi_mem_read *op);
+
 /**
  * spi_cs_info() - Check information on a chip select
  *
@@ -31,6 +31,9 @@
 # define CONFIG_SF_DEFAULT_BUS		0
 #endif
 
+/* Maximum number of erase types a flash can advertise through SFDP */
+#define SPI_FLASH_MAX_ERASE_TYPES	4
+
 struct spi_slave;
 
 /**
@@ -46,6 +49,10 @@ struct spi_slave;
  * @page_size:		Write (page) size
  * @sector_size:	Sector size
  * @erase_size:		Erase size
+ * @addr_width:		Number of address bytes (3 or 4)
+ * @erase_types:	Number of extra, larger erase commands (from SFDP)
+ * @erase_type_cmd:	Extra erase commands, smallest first
+ * @erase_type_size:	Size erased by each extra erase command
  * @bank_read_cmd:	Bank read cmd
  * @bank_write_cmd:	Bank write cmd
  * @bank_curr:		Current flash bank
@@ -77,6 +84,12 @@ struct spi_flash {
 	u32 page_size;
 	u32 sector_size;
 	u32 erase_size;
+	u8 addr_width;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	u8 erase_types;
+	u8 erase_type_cmd[SPI_FLASH_MAX_ERASE_TYPES];
+	u32 erase_type_size[SPI_FLASH_MAX_ERASE_TYPES];
+#endif
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 bank_read_cmd;
 	u8 bank_write_cmd;
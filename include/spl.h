@@ -33,6 +33,37 @@ struct spl_image_info {
 
 extern struct spl_image_info spl_image;
 
+/**
+ * struct spl_load_info - Information about how to read an image
+ *
+ * @dev:	Device to read from, for use by @read
+ * @bl_len:	Block size in bytes
+ * @read:	Read @count blocks from @sector to @buf, which is aligned to
+ *		ARCH_DMA_MINALIGN, and return the number of blocks read
+ */
+struct spl_load_info {
+	void *dev;
+	int bl_len;
+	ulong (*read)(struct spl_load_info *load, ulong sector, ulong count,
+		      void *buf);
+};
+
+/**
+ * spl_load_simple_fit() - Load the images of a FIT and set up spl_image
+ *
+ * The firmware, the device tree and any loadables of the default
+ * configuration are read, and decompressed if needed, to their load
+ * addresses; the device tree goes after the firmware if it has no load
+ * address. The FIT must be built with its image data embedded.
+ *
+ * @info:	How to read from the device
+ * @sector:	First sector of the FIT
+ * @fit:	Buffer of one block holding the first sector of the FIT; it
+ *		is used as a cache while the FIT is read
+ * @return 0 on success, -ve on error
+ */
+int spl_load_simple_fit(struct spl_load_info *info, ulong sector, void *fit);
+
 /* SPL common functions */
 void preloader_console_init(void);
 u32 spl_boot_device(void);
@@ -8,6 +8,11 @@
 #ifndef __TEST_SUITES_H__
 #define __TEST_SUITES_H__
 
+int do_ut_bch(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_hush(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_lcd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_rsa(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_string(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 int do_ut_dm(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 int do_ut_env(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 int do_ut_time(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
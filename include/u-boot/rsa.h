@@ -15,18 +15,29 @@
 #include <errno.h>
 #include <image.h>
 
+/*
+ * Big numbers are held as little endian arrays of limbs. Limbs are 64-bit
+ * when the compiler has a 128-bit type to hold the product of two limbs,
+ * and 32-bit otherwise.
+ */
+#ifdef __SIZEOF_INT128__
+typedef uint64_t rsa_limb_t;
+#else
+typedef uint32_t rsa_limb_t;
+#endif
+
 /**
  * struct rsa_public_key - holder for a public key
  *
  * An RSA public key consists of a modulus (typically called N), the inverse
- * and R^2, where R is 2^(# key bits).
+ * and R^2, where R is 2^(# bits in modulus[]).
  */
 
 struct rsa_public_key {
-	uint len;		/* len of modulus[] in number of uint32_t */
-	uint32_t n0inv;		/* -1 / modulus[0] mod 2^32 */
-	uint32_t *modulus;	/* modulus as little endian array */
-	uint32_t *rr;		/* R^2 as little endian array */
+	uint len;		/* len of modulus[] in number of limbs */
+	rsa_limb_t n0inv;	/* -1 / modulus[0] mod 2^(# bits in a limb) */
+	rsa_limb_t *modulus;	/* modulus as little endian array */
+	rsa_limb_t *rr;		/* R^2 as little endian array */
 	uint64_t exponent;	/* public exponent */
 };
 
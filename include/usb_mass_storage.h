@@ -20,6 +20,8 @@ struct ums {
 			   ulong start, lbaint_t blkcnt, void *buf);
 	int (*write_sector)(struct ums *ums_dev,
 			    ulong start, lbaint_t blkcnt, const void *buf);
+	/* Write back anything held by write_sector(), may be NULL */
+	int (*flush)(struct ums *ums_dev);
 	unsigned int start_sector;
 	unsigned int num_sectors;
 	const char *name;
@@ -46,7 +46,8 @@
  * remainder lookup tables.
  *
  * The final stage of decoding involves the following internal steps:
- * a. Syndrome computation
+ * a. Syndrome computation (8 bits at a time, using one lookup table per
+ *    syndrome; skipped altogether when the ecc shows no error)
  * b. Error locator polynomial computation using Berlekamp-Massey algorithm
  * c. Error locator root finding (by far the most expensive step)
  *
@@ -334,9 +335,9 @@ static inline int a_ilog(struct bch_control *bch, unsigned int x)
 static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
-	int i, j, s;
-	unsigned int m;
-	uint32_t poly;
+	int i, j, s, shift;
+	unsigned int m, b, v, words, pad, step;
+	const uint16_t *tab;
 	const int t = GF_T(bch);
 
 	s = bch->ecc_bits;
@@ -345,20 +346,43 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 	m = ((unsigned int)s) & 31;
 	if (m)
 		ecc[s/32] &= ~((1u << (32-m))-1);
-	memset(syn, 0, 2*t*sizeof(*syn));
 
-	/* compute v(a^j) for j=1 .. 2t-1 */
-	do {
-		poly = *ecc++;
-		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
+	words = DIV_ROUND_UP(s, 32);
+	pad = 32*words-s;
+
+	/*
+	 * compute v(a^j) for j=1 .. 2t-1 by Horner's rule, 8 ecc bits at a
+	 * time: v = v*a^(8j)+syn8_tab[byte]. All syndromes are updated for
+	 * each byte, so that their independent computations can overlap.
+	 */
+	memset(syn, 0, 2*t*sizeof(*syn));
+	for (i = 0; i < words; i++) {
+		for (shift = 24; shift >= 0; shift -= 8) {
+			b = (ecc[i] >> shift) & 0xff;
+			tab = bch->syn8_tab+b;
+			step = 8;
+			for (j = 0; j < 2*t; j += 2) {
+				v = syn[j];
+				if (v)
+					v = bch->a_pow_tab[mod_s(bch,
+						bch->a_log_tab[v]+step)];
+				syn[j] = v^*tab;
+				tab += 256;
+				step = mod_s(bch, step+16);
+			}
+		}
+	}
 
-			poly ^= (1 << i);
+	/* correct for the @pad unused bits at the end of the last ecc word */
+	if (pad) {
+		for (j = 0; j < 2*t; j += 2) {
+			v = syn[j];
+			if (v)
+				syn[j] = bch->a_pow_tab[mod_s(bch,
+					bch->a_log_tab[v]+GF_N(bch)-
+					modulo(bch, (j+1)*pad))];
 		}
-	} while (s > 0);
+	}
 
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
@@ -1008,14 +1032,15 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		for (i = 0, sum = 0; i < (int)ecc_words; i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found */
+			return 0;
+
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
 	}
@@ -1103,6 +1128,27 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	}
 }
 
+/*
+ * build syndrome lookup tables: for each odd syndrome a^j, j=1..2t-1, table
+ * entry b is the value in a^j of the 8 bit polynomial b
+ */
+static void build_syn8_tables(struct bch_control *bch)
+{
+	int i, j, b;
+	uint16_t *tab;
+	const int t = GF_T(bch);
+
+	for (j = 0; j < t; j++) {
+		tab = bch->syn8_tab+256*j;
+		tab[0] = 0;
+		for (b = 1; b < 256; b++) {
+			/* add lowest set bit to the value of the other bits */
+			i = ffs(b)-1;
+			tab[b] = tab[b & (b-1)]^a_pow(bch, (2*j+1)*i);
+		}
+	}
+}
+
 /*
  * build a base for factoring degree 2 polynomials
  */
@@ -1295,6 +1341,7 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
 	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+	bch->syn8_tab  = bch_alloc(t*256*sizeof(*bch->syn8_tab), &err);
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
@@ -1320,6 +1367,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	build_mod8_tables(bch, genpoly);
 	kfree(genpoly);
 
+	build_syn8_tables(bch);
+
 	err = build_deg2_base(bch);
 	if (err)
 		goto fail;
@@ -1343,6 +1392,7 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->a_pow_tab);
 		kfree(bch->a_log_tab);
 		kfree(bch->mod8_tab);
+		kfree(bch->syn8_tab);
 		kfree(bch->ecc_buf);
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
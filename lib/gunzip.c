@@ -40,6 +40,20 @@ void gzfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
+__weak int gzip_parallel_workers(void)
+{
+	return 1;
+}
+
+__weak void gzip_parallel_run(void (*func)(void *arg, int worker), void *arg,
+			      int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		func(arg, i);
+}
+
 int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 {
 	int i, flags;
@@ -102,22 +116,100 @@ void gzwrite_progress_finish(int returnval,
 	}
 }
 
+/*
+ * gzwrite() inflates into one buffer while the other one is written. The
+ * writes stay on the calling CPU (worker 0); inflate(), which does not call
+ * malloc() once it has its window, may run on a second CPU (worker 1).
+ */
+struct gzwrite_state {
+	z_stream s;
+	struct block_dev_desc *dev;
+	uint flags;
+	/* Inflating */
+	unsigned char *out;	/* buffer to inflate into */
+	ulong out_len;		/* its size */
+	int r;			/* result of inflate() */
+	unsigned crc;
+	/* Writing */
+	const unsigned char *wbuf;	/* data to write, or NULL */
+	lbaint_t wstart;	/* first block */
+	lbaint_t wblocks;	/* number of blocks */
+	lbaint_t wdone;		/* number written or erased */
+	lbaint_t erase_blocks;	/* size of a whole, aligned buffer */
+};
+
+static bool gzwrite_is_zero(const unsigned char *buf, ulong len)
+{
+	const ulong *p = (const ulong *)buf;
+	ulong i;
+
+	/* buffers come from malloc(), so they are aligned */
+	for (i = 0; i < len / sizeof(ulong); i++)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static void gzwrite_inflate(struct gzwrite_state *gz)
+{
+	ulong left;
+
+	gz->s.next_out = gz->out;
+	gz->s.avail_out = gz->out_len;
+	/* inflate() stops at each block end with Z_SYNC_FLUSH, so go on */
+	do {
+		left = gz->s.avail_out;
+		gz->r = inflate(&gz->s, Z_SYNC_FLUSH);
+	} while (gz->r == Z_OK && gz->s.avail_out && gz->s.avail_in &&
+		 gz->s.avail_out != left);
+	gz->crc = crc32(gz->crc, gz->out, gz->out_len - gz->s.avail_out);
+}
+
+static void gzwrite_write(struct gzwrite_state *gz)
+{
+	struct block_dev_desc *dev = gz->dev;
+	ulong len = gz->wblocks * dev->blksz;
+
+	/* only whole buffers are aligned to the erase size */
+	if ((gz->flags & GZWRITE_ERASE_ZERO) && dev->block_erase &&
+	    gz->wblocks == gz->erase_blocks && gzwrite_is_zero(gz->wbuf, len))
+		gz->wdone = dev->block_erase(dev->dev, gz->wstart,
+					     gz->wblocks);
+	else
+		gz->wdone = dev->block_write(dev->dev, gz->wstart,
+					     gz->wblocks, gz->wbuf);
+}
+
+static void gzwrite_worker(void *arg, int worker)
+{
+	struct gzwrite_state *gz = arg;
+
+	if (worker)
+		gzwrite_inflate(gz);
+	else if (gz->wbuf)
+		gzwrite_write(gz);
+}
+
 int gzwrite(unsigned char *src, int len,
 	    struct block_dev_desc *dev,
 	    unsigned long szwritebuf,
 	    u64 startoffs,
-	    u64 szexpected)
+	    u64 szexpected,
+	    uint flags)
 {
-	int i, flags;
-	z_stream s;
+	int i, hflags;
+	struct gzwrite_state gz;
 	int r = 0;
-	unsigned char *writebuf;
-	unsigned crc = 0;
+	unsigned char *writebuf[2];
+	int cur = 0;
 	u64 totalfilled = 0;
-	lbaint_t blksperbuf, outblock;
+	lbaint_t blksperbuf, outblock, first;
+	u64 first_div;
 	u32 expected_crc;
 	u32 payload_size;
 	int iteration = 0;
+	bool parallel;
 
 	if (!szwritebuf ||
 	    (szwritebuf % dev->blksz) ||
@@ -138,20 +230,20 @@ int gzwrite(unsigned char *src, int len,
 
 	/* skip header */
 	i = 10;
-	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
+	hflags = src[3];
+	if (src[2] != DEFLATED || (hflags & RESERVED) != 0) {
 		puts("Error: Bad gzipped data\n");
 		return -1;
 	}
-	if ((flags & EXTRA_FIELD) != 0)
+	if ((hflags & EXTRA_FIELD) != 0)
 		i = 12 + src[10] + (src[11] << 8);
-	if ((flags & ORIG_NAME) != 0)
+	if ((hflags & ORIG_NAME) != 0)
 		while (src[i++] != 0)
 			;
-	if ((flags & COMMENT) != 0)
+	if ((hflags & COMMENT) != 0)
 		while (src[i++] != 0)
 			;
-	if ((flags & HEAD_CRC) != 0)
+	if ((hflags & HEAD_CRC) != 0)
 		i += 2;
 
 	if (i >= len-8) {
@@ -180,81 +272,129 @@ int gzwrite(unsigned char *src, int len,
 
 	gzwrite_progress_init(szexpected);
 
-	s.zalloc = gzalloc;
-	s.zfree = gzfree;
+	memset(&gz, '\0', sizeof(gz));
+	gz.dev = dev;
+	gz.flags = flags;
+	gz.erase_blocks = blksperbuf;
+	gz.s.zalloc = gzalloc;
+	gz.s.zfree = gzfree;
 
-	r = inflateInit2(&s, -MAX_WBITS);
+	r = inflateInit2(&gz.s, -MAX_WBITS);
 	if (r != Z_OK) {
 		printf("Error: inflateInit2() returned %d\n", r);
 		return -1;
 	}
 
-	s.next_in = src + i;
-	s.avail_in = payload_size+8;
-	writebuf = (unsigned char *)malloc(szwritebuf);
+	gz.s.next_in = src + i;
+	gz.s.avail_in = payload_size+8;
+	parallel = gzip_parallel_workers() > 1;
+	writebuf[0] = (unsigned char *)malloc(szwritebuf);
+	/*
+	 * Without a second worker, a buffer is always written before it is
+	 * inflated into again, so one is enough
+	 */
+	if (parallel)
+		writebuf[1] = (unsigned char *)malloc(szwritebuf);
+	else
+		writebuf[1] = writebuf[0];
+	if (!writebuf[0] || !writebuf[1]) {
+		printf("%s: no memory for write buffers\n", __func__);
+		r = -1;
+		goto out;
+	}
+
+	/*
+	 * Make the first write end on a multiple of the buffer size, so that
+	 * the others are aligned to it, as well as to the erase size if the
+	 * buffer is a multiple of that
+	 */
+	first_div = outblock;
+	first = do_div(first_div, blksperbuf);
+	gz.out_len = (blksperbuf - first) * dev->blksz;
+	gz.out = writebuf[cur];
+
+	/* The first inflate() allocates the window, so do it here */
+	gzwrite_inflate(&gz);
 
 	/* decompress until deflate stream ends or end of file */
-	do {
-		if (s.avail_in == 0) {
-			printf("%s: weird termination with result %d\n",
-			       __func__, r);
-			break;
+	for (;;) {
+		ulong numfilled;
+		lbaint_t writeblocks;
+
+		if ((gz.r != Z_OK) && (gz.r != Z_STREAM_END)) {
+			printf("Error: inflate() returned %d\n", gz.r);
+			r = -1;
+			goto out;
+		}
+		if (gz.wbuf && gz.wdone != gz.wblocks) {
+			printf("%s: wrote " LBAF " of " LBAF " blocks at "
+			       LBAF "\n", __func__, gz.wdone, gz.wblocks,
+			       gz.wstart);
+			r = -1;
+			goto out;
+		}
+
+		numfilled = gz.out_len - gz.s.avail_out;
+		totalfilled += numfilled;
+		gz.wbuf = NULL;
+		if (numfilled) {
+			writeblocks = (numfilled + dev->blksz - 1) /
+					dev->blksz;
+			if (numfilled % dev->blksz)
+				memset(gz.out + numfilled, 0,
+				       dev->blksz - (numfilled % dev->blksz));
+			gz.wbuf = gz.out;
+			gz.wstart = outblock;
+			gz.wblocks = writeblocks;
+			outblock += writeblocks;
+			gzwrite_progress(iteration++, totalfilled, szexpected);
 		}
 
-		/* run inflate() on input until output buffer not full */
-		do {
-			unsigned long blocks_written;
-			int numfilled;
-			lbaint_t writeblocks;
-
-			s.avail_out = szwritebuf;
-			s.next_out = writebuf;
-			r = inflate(&s, Z_SYNC_FLUSH);
-			if ((r != Z_OK) &&
-			    (r != Z_STREAM_END)) {
-				printf("Error: inflate() returned %d\n", r);
-				goto out;
-			}
-			numfilled = szwritebuf - s.avail_out;
-			crc = crc32(crc, writebuf, numfilled);
-			totalfilled += numfilled;
-			if (numfilled < szwritebuf) {
-				writeblocks = (numfilled+dev->blksz-1)
-						/ dev->blksz;
-				memset(writebuf+numfilled, 0,
-				       dev->blksz-(numfilled%dev->blksz));
-			} else {
-				writeblocks = blksperbuf;
-			}
-
-			gzwrite_progress(iteration++,
-					 totalfilled,
-					 szexpected);
-			blocks_written = dev->block_write(dev->dev,
-							  outblock,
-							  writeblocks,
-							  writebuf);
-			outblock += blocks_written;
-			if (ctrlc()) {
-				puts("abort\n");
-				goto out;
-			}
-			WATCHDOG_RESET();
-		} while (s.avail_out == 0);
 		/* done when inflate() says it's done */
-	} while (r != Z_STREAM_END);
+		if (gz.r == Z_STREAM_END || !gz.s.avail_in ||
+		    gz.s.avail_out) {
+			if (gz.r != Z_STREAM_END)
+				printf("%s: weird termination with result %d\n",
+				       __func__, gz.r);
+			if (gz.wbuf)
+				gzwrite_write(&gz);
+			if (gz.wbuf && gz.wdone != gz.wblocks)
+				r = -1;
+			break;
+		}
+
+		/* write this buffer while inflating into the other one */
+		cur = !cur;
+		gz.out = writebuf[cur];
+		gz.out_len = szwritebuf;
+		if (parallel) {
+			gzip_parallel_run(gzwrite_worker, &gz, 2);
+		} else {
+			gzwrite_worker(&gz, 0);
+			gzwrite_worker(&gz, 1);
+		}
+
+		if (ctrlc()) {
+			puts("abort\n");
+			r = -1;
+			goto out;
+		}
+		WATCHDOG_RESET();
+	}
 
 	if ((szexpected != totalfilled) ||
-	    (crc != expected_crc))
+	    (gz.crc != expected_crc) || r)
 		r = -1;
 	else
 		r = 0;
 
 out:
 	gzwrite_progress_finish(r, totalfilled, szexpected,
-				expected_crc, crc);
-	free(writebuf);
-	inflateEnd(&s);
+				expected_crc, gz.crc);
+	if (writebuf[1] != writebuf[0])
+		free(writebuf[1]);
+	free(writebuf[0]);
+	inflateEnd(&gz.s);
 
 	return r;
 }
@@ -12,11 +12,15 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <u-boot/zlib.h>
+#include <asm/unaligned.h>
 #include "zlib/zutil.h"
 
 #ifndef CONFIG_GZIP_COMPRESS_DEF_SZ
 #define CONFIG_GZIP_COMPRESS_DEF_SZ	0x200
 #endif
+#ifndef CONFIG_GZIP_BLOCK_SZ
+#define CONFIG_GZIP_BLOCK_SZ		(128 << 10)
+#endif
 #define ZALLOC_ALIGNMENT		16
 
 static void *zalloc(void *x, unsigned items, unsigned size)
@@ -39,9 +43,198 @@ static void zfree(void *x, void *addr, unsigned nb)
 int gzip(void *dst, unsigned long *lenp,
 		unsigned char *src, unsigned long srclen)
 {
+#ifdef CONFIG_GZIP_PARALLEL
+	if (srclen > CONFIG_GZIP_BLOCK_SZ)
+		return gzip_parallel(dst, lenp, src, srclen);
+#endif
 	return zzip(dst, lenp, src, srclen, 1, NULL);
 }
 
+#ifdef CONFIG_GZIP_PARALLEL
+/* Largest number of blocks compressed at the same time */
+#define GZIP_MAX_WORKERS	8
+/* Memory used by deflate with a 32KiB window at the default memory level */
+#define GZIP_WORKER_HEAP	(288 << 10)
+/* Room for a compressed block, even if it does not compress */
+#define GZIP_BLOCK_BOUND	(CONFIG_GZIP_BLOCK_SZ + \
+				 (CONFIG_GZIP_BLOCK_SZ >> 3) + 64)
+
+/* The same header as deflate writes for the compression level */
+#ifdef CONFIG_GZIP
+static const unsigned char header[] = {
+	0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 4, OS_CODE
+};
+#else
+static const unsigned char header[] = { 0x78, 0x01 };
+#endif
+
+/* One block of the input, compressed by one worker */
+struct gzip_job {
+	unsigned char *start;	/* start of the input, for the dictionary */
+	unsigned char *src;	/* data to compress */
+	ulong len;		/* its length, 0 if there is nothing to do */
+	int last;		/* true to end the deflate stream */
+	unsigned char *out;	/* compressed data, GZIP_BLOCK_BOUND bytes */
+	ulong out_len;		/* length of the compressed data */
+	char *heap;		/* memory for deflate, GZIP_WORKER_HEAP bytes */
+	ulong heap_used;
+	int ret;		/* 0 if OK, -1 on error */
+};
+
+/*
+ * Workers may run on other CPUs, so they take memory from their own heap
+ * rather than calling malloc()
+ */
+static void *gzip_job_alloc(void *x, unsigned items, unsigned size)
+{
+	struct gzip_job *job = x;
+	ulong start = ALIGN(job->heap_used, ZALLOC_ALIGNMENT);
+
+	if (start + (ulong)items * size > GZIP_WORKER_HEAP)
+		return Z_NULL;
+	job->heap_used = start + items * size;
+
+	return job->heap + start;
+}
+
+static void gzip_job_free(void *x, void *addr, unsigned nb)
+{
+}
+
+/*
+ * Compress one block as raw deflate data, primed with the 32KiB of input
+ * before it so that matches can reach back into the previous block. All
+ * but the last block end with a sync flush, which leaves the output on a
+ * byte boundary so that the blocks can simply be put together.
+ */
+static void gzip_worker(void *arg, int worker)
+{
+	struct gzip_job *job = (struct gzip_job *)arg + worker;
+	ulong dict_len;
+	z_stream s;
+	int r;
+
+	if (!job->len)
+		return;
+	job->ret = -1;
+	job->heap_used = 0;
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = gzip_job_alloc;
+	s.zfree = gzip_job_free;
+	s.opaque = job;
+	if (deflateInit2_(&s, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS,
+			  DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, ZLIB_VERSION,
+			  sizeof(z_stream)) != Z_OK)
+		return;
+
+	dict_len = job->src - job->start;
+	if (dict_len > 1 << MAX_WBITS)
+		dict_len = 1 << MAX_WBITS;
+	if (dict_len &&
+	    deflateSetDictionary(&s, job->src - dict_len, dict_len) != Z_OK)
+		goto out;
+
+	s.next_in = job->src;
+	s.avail_in = job->len;
+	s.next_out = job->out;
+	s.avail_out = GZIP_BLOCK_BOUND;
+	r = deflate(&s, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+	if (job->last ? r != Z_STREAM_END :
+	    r != Z_OK || s.avail_in || !s.avail_out)
+		goto out;
+	job->out_len = GZIP_BLOCK_BOUND - s.avail_out;
+	job->ret = 0;
+out:
+	deflateEnd(&s);
+}
+
+int gzip_parallel(void *dst, unsigned long *lenp, unsigned char *src,
+		  unsigned long srclen)
+{
+	struct gzip_job job[GZIP_MAX_WORKERS];
+	unsigned char *out = dst;
+	unsigned long left = *lenp;
+	ulong offset = 0, check;
+	char *mem;
+	int workers, i, ret = -1;
+
+	workers = gzip_parallel_workers();
+	workers = clamp(workers, 1, GZIP_MAX_WORKERS);
+	workers = min_t(ulong, workers, DIV_ROUND_UP(srclen,
+						     CONFIG_GZIP_BLOCK_SZ));
+	mem = malloc(workers * (GZIP_WORKER_HEAP + GZIP_BLOCK_BOUND));
+	if (!mem) {
+		printf("Error: no memory for %d gzip workers\n", workers);
+		return -1;
+	}
+	for (i = 0; i < workers; i++) {
+		job[i].heap = mem + i * (GZIP_WORKER_HEAP + GZIP_BLOCK_BOUND);
+		job[i].out = (unsigned char *)job[i].heap + GZIP_WORKER_HEAP;
+		job[i].start = src;
+	}
+
+#ifdef CONFIG_GZIP
+	check = crc32(0, NULL, 0);
+#else
+	check = adler32(0, NULL, 0);
+#endif
+	if (left < sizeof(header) + 8)
+		goto need_space;
+	memcpy(out, header, sizeof(header));
+	out += sizeof(header);
+	left -= sizeof(header);
+
+	for (offset = 0; offset < srclen;) {
+		for (i = 0; i < workers; i++) {
+			job[i].src = src + offset;
+			job[i].len = min_t(ulong, srclen - offset,
+					   CONFIG_GZIP_BLOCK_SZ);
+			offset += job[i].len;
+			job[i].last = offset == srclen;
+		}
+		gzip_parallel_run(gzip_worker, job, workers);
+
+		for (i = 0; i < workers && job[i].len; i++) {
+			if (job[i].ret) {
+				printf("Error: deflate() failed at offset %lx\n",
+				       (ulong)(job[i].src - src));
+				goto bail;
+			}
+			if (job[i].out_len + 8 > left)
+				goto need_space;
+			memcpy(out, job[i].out, job[i].out_len);
+			out += job[i].out_len;
+			left -= job[i].out_len;
+#ifdef CONFIG_GZIP
+			check = crc32(check, job[i].src, job[i].len);
+#else
+			check = adler32(check, job[i].src, job[i].len);
+#endif
+		}
+		WATCHDOG_RESET();
+	}
+
+#ifdef CONFIG_GZIP
+	put_unaligned_le32(check, out);
+	put_unaligned_le32(srclen, out + 4);
+	out += 8;
+#else
+	put_unaligned_be32(check, out);
+	out += 4;
+#endif
+	*lenp = out - (unsigned char *)dst;
+	ret = 0;
+	goto bail;
+
+need_space:
+	printf("Deflate need more space to compress left %lu bytes\n",
+	       srclen - offset);
+bail:
+	free(mem);
+	return ret;
+}
+#endif
+
 /*
  * Compress blocks with zlib
  */
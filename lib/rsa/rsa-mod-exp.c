@@ -7,6 +7,7 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <asm/types.h>
 #include <asm/byteorder.h>
 #include <asm/errno.h>
@@ -20,29 +21,56 @@
 #include <u-boot/rsa.h>
 #include <u-boot/rsa-mod-exp.h>
 
-#define UINT64_MULT32(v, multby)  (((uint64_t)(v)) * ((uint32_t)(multby)))
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 rsa_dlimb_t;
+#else
+typedef uint64_t rsa_dlimb_t;
+#endif
 
-#define get_unaligned_be32(a) fdt32_to_cpu(*(uint32_t *)a)
-#define put_unaligned_be32(a, b) (*(uint32_t *)(b) = cpu_to_fdt32(a))
+#define RSA_LIMB_BYTES	sizeof(rsa_limb_t)
+#define RSA_LIMB_BITS	(RSA_LIMB_BYTES * 8)
 
 /* Default public exponent for backward compatibility */
 #define RSA_DEFAULT_PUBEXP	65537
 
+#ifndef USE_HOSTCC
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of keys whose precomputed form is kept between verifications */
+#define RSA_KEY_CACHE_SIZE	4
+
+/**
+ * struct rsa_key_cache - a key as prepared for pow_mod()
+ *
+ * @key:	Key, with modulus and rr pointing into @limbs
+ * @limbs:	Modulus followed by R^2, each of key.len limbs
+ */
+struct rsa_key_cache {
+	struct rsa_public_key key;
+	rsa_limb_t limbs[];
+};
+
+static struct rsa_key_cache *rsa_key_cache[RSA_KEY_CACHE_SIZE];
+static int rsa_key_cache_next;
+#endif
+
 /**
  * subtract_modulus() - subtract modulus from the given value
  *
  * @key:	Key containing modulus to subtract
- * @num:	Number to subtract modulus from, as little endian word array
+ * @num:	Number to subtract modulus from, as little endian limb array
  */
-static void subtract_modulus(const struct rsa_public_key *key, uint32_t num[])
+static void subtract_modulus(const struct rsa_public_key *key,
+			     rsa_limb_t num[])
 {
-	int64_t acc = 0;
+	rsa_dlimb_t acc;
+	rsa_limb_t borrow = 0;
 	uint i;
 
 	for (i = 0; i < key->len; i++) {
-		acc += (uint64_t)num[i] - key->modulus[i];
-		num[i] = (uint32_t)acc;
-		acc >>= 32;
+		acc = (rsa_dlimb_t)num[i] - key->modulus[i] - borrow;
+		num[i] = (rsa_limb_t)acc;
+		borrow = (rsa_limb_t)(acc >> RSA_LIMB_BITS) & 1;
 	}
 }
 
@@ -50,11 +78,11 @@ static void subtract_modulus(const struct rsa_public_key *key, uint32_t num[])
  * greater_equal_modulus() - check if a value is >= modulus
  *
  * @key:	Key containing modulus to check
- * @num:	Number to check against modulus, as little endian word array
+ * @num:	Number to check against modulus, as little endian limb array
  * @return 0 if num < modulus, 1 if num >= modulus
  */
 static int greater_equal_modulus(const struct rsa_public_key *key,
-				 uint32_t num[])
+				 rsa_limb_t num[])
 {
 	int i;
 
@@ -74,32 +102,34 @@ static int greater_equal_modulus(const struct rsa_public_key *key,
  * Operation: montgomery result[] += a * b[] / n0inv % modulus
  *
  * @key:	RSA key
- * @result:	Place to put result, as little endian word array
+ * @result:	Place to put result, as little endian limb array
  * @a:		Multiplier
- * @b:		Multiplicand, as little endian word array
+ * @b:		Multiplicand, as little endian limb array
  */
 static void montgomery_mul_add_step(const struct rsa_public_key *key,
-		uint32_t result[], const uint32_t a, const uint32_t b[])
+		rsa_limb_t result[], const rsa_limb_t a, const rsa_limb_t b[])
 {
-	uint64_t acc_a, acc_b;
-	uint32_t d0;
+	rsa_dlimb_t acc_a, acc_b;
+	rsa_limb_t d0;
 	uint i;
 
-	acc_a = (uint64_t)a * b[0] + result[0];
-	d0 = (uint32_t)acc_a * key->n0inv;
-	acc_b = (uint64_t)d0 * key->modulus[0] + (uint32_t)acc_a;
+	acc_a = (rsa_dlimb_t)a * b[0] + result[0];
+	d0 = (rsa_limb_t)acc_a * key->n0inv;
+	acc_b = (rsa_dlimb_t)d0 * key->modulus[0] + (rsa_limb_t)acc_a;
 	for (i = 1; i < key->len; i++) {
-		acc_a = (acc_a >> 32) + (uint64_t)a * b[i] + result[i];
-		acc_b = (acc_b >> 32) + (uint64_t)d0 * key->modulus[i] +
-				(uint32_t)acc_a;
-		result[i - 1] = (uint32_t)acc_b;
+		acc_a = (acc_a >> RSA_LIMB_BITS) + (rsa_dlimb_t)a * b[i] +
+				result[i];
+		acc_b = (acc_b >> RSA_LIMB_BITS) +
+				(rsa_dlimb_t)d0 * key->modulus[i] +
+				(rsa_limb_t)acc_a;
+		result[i - 1] = (rsa_limb_t)acc_b;
 	}
 
-	acc_a = (acc_a >> 32) + (acc_b >> 32);
+	acc_a = (acc_a >> RSA_LIMB_BITS) + (acc_b >> RSA_LIMB_BITS);
 
-	result[i - 1] = (uint32_t)acc_a;
+	result[i - 1] = (rsa_limb_t)acc_a;
 
-	if (acc_a >> 32)
+	if (acc_a >> RSA_LIMB_BITS)
 		subtract_modulus(key, result);
 }
 
@@ -109,12 +139,12 @@ static void montgomery_mul_add_step(const struct rsa_public_key *key,
  * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
  *
  * @key:	RSA key
- * @result:	Place to put result, as little endian word array
- * @a:		Multiplier, as little endian word array
- * @b:		Multiplicand, as little endian word array
+ * @result:	Place to put result, as little endian limb array
+ * @a:		Multiplier, as little endian limb array
+ * @b:		Multiplicand, as little endian limb array
  */
 static void montgomery_mul(const struct rsa_public_key *key,
-		uint32_t result[], uint32_t a[], const uint32_t b[])
+		rsa_limb_t result[], const rsa_limb_t a[], const rsa_limb_t b[])
 {
 	uint i;
 
@@ -170,28 +200,21 @@ static int is_public_exponent_bit_set(const struct rsa_public_key *key,
  * pow_mod() - in-place public exponentiation
  *
  * @key:	RSA key
- * @inout:	Big-endian word array containing value and result
+ * @inout:	Little endian limb array containing value and result
  */
-static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
+static int pow_mod(const struct rsa_public_key *key, rsa_limb_t *inout)
 {
-	uint32_t *result, *ptr;
-	uint i;
 	int j, k;
 
-	/* Sanity check for stack size - key->len is in 32-bit words */
-	if (key->len > RSA_MAX_KEY_BITS / 32) {
-		debug("RSA key words %u exceeds maximum %d\n", key->len,
-		      RSA_MAX_KEY_BITS / 32);
+	/* Sanity check for stack size */
+	if (key->len > RSA_MAX_KEY_BITS / RSA_LIMB_BITS + 1) {
+		debug("RSA key limbs %u exceeds maximum %d\n", key->len,
+		      (int)(RSA_MAX_KEY_BITS / RSA_LIMB_BITS + 1));
 		return -EINVAL;
 	}
 
-	uint32_t val[key->len], acc[key->len], tmp[key->len];
-	uint32_t a_scaled[key->len];
-	result = tmp;  /* Re-use location. */
-
-	/* Convert from big endian byte array to little endian word array. */
-	for (i = 0, ptr = inout + key->len - 1; i < key->len; i++, ptr--)
-		val[i] = get_unaligned_be32(ptr);
+	rsa_limb_t acc[key->len], tmp[key->len];
+	rsa_limb_t a_scaled[key->len];
 
 	if (0 != num_public_exponent_bits(key, &k))
 		return -EINVAL;
@@ -208,7 +231,7 @@ static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 	}
 
 	/* the bit at e[k-1] is 1 by definition, so start with: C := M */
-	montgomery_mul(key, acc, val, key->rr); /* acc = a * RR / R mod n */
+	montgomery_mul(key, acc, inout, key->rr); /* acc = a * RR / R mod n */
 	/* retain scaled version for intermediate use */
 	memcpy(a_scaled, acc, key->len * sizeof(a_scaled[0]));
 
@@ -226,39 +249,175 @@ static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 
 	/* the bit at e[0] is always 1 */
 	montgomery_mul(key, tmp, acc, acc); /* tmp = acc^2 / R mod n */
-	montgomery_mul(key, acc, tmp, val); /* acc = tmp * a / R mod M */
-	memcpy(result, acc, key->len * sizeof(result[0]));
+	montgomery_mul(key, acc, tmp, inout); /* acc = tmp * a / R mod M */
 
 	/* Make sure result < mod; result is at most 1x mod too large. */
-	if (greater_equal_modulus(key, result))
-		subtract_modulus(key, result);
+	if (greater_equal_modulus(key, acc))
+		subtract_modulus(key, acc);
+
+	memcpy(inout, acc, key->len * sizeof(inout[0]));
 
-	/* Convert to bigendian byte array */
-	for (i = key->len - 1, ptr = inout; (int)i >= 0; i--, ptr++)
-		put_unaligned_be32(result[i], ptr);
 	return 0;
 }
 
-static void rsa_convert_big_endian(uint32_t *dst, const uint32_t *src, int len)
+/**
+ * rsa_convert_big_endian() - convert a big endian byte array to limbs
+ *
+ * @dst:	Place to put the little endian limb array
+ * @len:	Number of limbs in @dst
+ * @src:	Big endian byte array
+ * @bytes:	Number of bytes in @src, no more than @len limbs hold
+ */
+static void rsa_convert_big_endian(rsa_limb_t *dst, uint len,
+				   const uint8_t *src, uint bytes)
+{
+	uint i;
+
+	memset(dst, 0, len * RSA_LIMB_BYTES);
+	for (i = 0; i < bytes; i++)
+		dst[i / RSA_LIMB_BYTES] |= (rsa_limb_t)src[bytes - 1 - i] <<
+					   (i % RSA_LIMB_BYTES * 8);
+}
+
+/**
+ * rsa_convert_to_big_endian() - convert limbs to a big endian byte array
+ *
+ * @dst:	Place to put the big endian byte array
+ * @bytes:	Number of bytes to put in @dst
+ * @src:	Little endian limb array
+ */
+static void rsa_convert_to_big_endian(uint8_t *dst, uint bytes,
+				      const rsa_limb_t *src)
+{
+	uint i;
+
+	for (i = 0; i < bytes; i++)
+		dst[bytes - 1 - i] = src[i / RSA_LIMB_BYTES] >>
+				     (i % RSA_LIMB_BYTES * 8);
+}
+
+/**
+ * rsa_n0inv() - compute -1 / n mod 2^(# bits in a limb)
+ *
+ * Any odd n is its own inverse modulo 2^3 and each Newton step doubles the
+ * number of correct bits, so this does not need the 32-bit n0inv stored
+ * with the key.
+ *
+ * @n:		Lowest limb of the modulus, which must be odd
+ * @return -1 / n mod 2^(# bits in a limb)
+ */
+static rsa_limb_t rsa_n0inv(rsa_limb_t n)
+{
+	rsa_limb_t inv = n;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		inv *= 2 - n * inv;
+
+	return -inv;
+}
+
+/**
+ * rsa_compute_rr() - compute R^2 mod modulus by repeated doubling
+ *
+ * This is needed when the key length is not a whole number of limbs, since
+ * the R^2 stored with the key is then for a different R.
+ *
+ * @key:	RSA key
+ * @rr:		Place to put R^2 mod modulus, as little endian limb array
+ */
+static void rsa_compute_rr(const struct rsa_public_key *key, rsa_limb_t rr[])
 {
+	rsa_limb_t carry, top;
+	uint i, j;
+
+	memset(rr, 0, key->len * RSA_LIMB_BYTES);
+	rr[0] = 1;
+	for (i = 0; i < 2 * key->len * RSA_LIMB_BITS; i++) {
+		carry = 0;
+		for (j = 0; j < key->len; j++) {
+			top = rr[j] >> (RSA_LIMB_BITS - 1);
+			rr[j] = rr[j] << 1 | carry;
+			carry = top;
+		}
+		if (carry || greater_equal_modulus(key, rr))
+			subtract_modulus(key, rr);
+	}
+}
+
+/**
+ * rsa_key_cache_find() - look up a prepared key
+ *
+ * @key:	Key with its len, exponent and modulus filled in
+ * @return the cached key with the same modulus and exponent, or NULL
+ */
+static const struct rsa_public_key *rsa_key_cache_find(
+		const struct rsa_public_key *key)
+{
+#ifndef USE_HOSTCC
+	struct rsa_key_cache *entry;
 	int i;
 
-	for (i = 0; i < len; i++)
-		dst[i] = fdt32_to_cpu(src[len - 1 - i]);
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return NULL;
+
+	for (i = 0; i < RSA_KEY_CACHE_SIZE; i++) {
+		entry = rsa_key_cache[i];
+		if (entry && entry->key.len == key->len &&
+		    entry->key.exponent == key->exponent &&
+		    !memcmp(entry->key.modulus, key->modulus,
+			    key->len * RSA_LIMB_BYTES))
+			return &entry->key;
+	}
+#endif
+
+	return NULL;
+}
+
+/**
+ * rsa_key_cache_add() - keep a copy of a prepared key
+ *
+ * The oldest key is dropped when the cache is full. Nothing is kept if
+ * there is no memory, or before malloc() is fully set up.
+ *
+ * @key:	Key ready for pow_mod()
+ */
+static void rsa_key_cache_add(const struct rsa_public_key *key)
+{
+#ifndef USE_HOSTCC
+	struct rsa_key_cache *entry;
+	uint size = key->len * RSA_LIMB_BYTES;
+
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return;
+
+	free(rsa_key_cache[rsa_key_cache_next]);
+	entry = malloc(sizeof(*entry) + 2 * size);
+	rsa_key_cache[rsa_key_cache_next] = entry;
+	if (!entry)
+		return;
+
+	entry->key = *key;
+	entry->key.modulus = entry->limbs;
+	entry->key.rr = entry->limbs + key->len;
+	memcpy(entry->key.modulus, key->modulus, size);
+	memcpy(entry->key.rr, key->rr, size);
+	rsa_key_cache_next = (rsa_key_cache_next + 1) % RSA_KEY_CACHE_SIZE;
+#endif
 }
 
 int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 		struct key_prop *prop, uint8_t *out)
 {
+	const struct rsa_public_key *cached;
 	struct rsa_public_key key;
+	uint bytes;
 	int ret;
 
 	if (!prop) {
 		debug("%s: Skipping invalid prop", __func__);
 		return -EBADF;
 	}
-	key.n0inv = prop->n0inv;
-	key.len = prop->num_bits;
 
 	if (!prop->public_exponent)
 		key.exponent = RSA_DEFAULT_PUBEXP;
@@ -266,38 +425,56 @@ int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 		key.exponent =
 			fdt64_to_cpu(*((uint64_t *)(prop->public_exponent)));
 
-	if (!key.len || !prop->modulus || !prop->rr) {
+	if (!prop->num_bits || !prop->modulus || !prop->rr) {
 		debug("%s: Missing RSA key info", __func__);
 		return -EFAULT;
 	}
 
 	/* Sanity check for stack size */
-	if (key.len > RSA_MAX_KEY_BITS || key.len < RSA_MIN_KEY_BITS) {
-		debug("RSA key bits %u outside allowed range %d..%d\n",
-		      key.len, RSA_MIN_KEY_BITS, RSA_MAX_KEY_BITS);
+	if (prop->num_bits > RSA_MAX_KEY_BITS ||
+	    prop->num_bits < RSA_MIN_KEY_BITS) {
+		debug("RSA key bits %d outside allowed range %d..%d\n",
+		      prop->num_bits, RSA_MIN_KEY_BITS, RSA_MAX_KEY_BITS);
 		return -EFAULT;
 	}
-	key.len /= sizeof(uint32_t) * 8;
-	uint32_t key1[key.len], key2[key.len];
+
+	/* The key holds modulus and R^2 as arrays of 32-bit words */
+	bytes = prop->num_bits / 32 * sizeof(uint32_t);
+	key.len = (bytes + RSA_LIMB_BYTES - 1) / RSA_LIMB_BYTES;
+	if (sig_len > key.len * RSA_LIMB_BYTES) {
+		debug("%s: Signature is longer than the key\n", __func__);
+		return -EINVAL;
+	}
+
+	rsa_limb_t key1[key.len], key2[key.len], buf[key.len];
 
 	key.modulus = key1;
-	key.rr = key2;
-	rsa_convert_big_endian(key.modulus, (uint32_t *)prop->modulus, key.len);
-	rsa_convert_big_endian(key.rr, (uint32_t *)prop->rr, key.len);
-	if (!key.modulus || !key.rr) {
-		debug("%s: Out of memory", __func__);
-		return -ENOMEM;
+	rsa_convert_big_endian(key.modulus, key.len, prop->modulus, bytes);
+	if (!(key.modulus[0] & 1)) {
+		debug("%s: RSA modulus must be odd\n", __func__);
+		return -EINVAL;
 	}
 
-	uint32_t buf[sig_len / sizeof(uint32_t)];
+	cached = rsa_key_cache_find(&key);
+	if (!cached) {
+		key.n0inv = rsa_n0inv(key.modulus[0]);
+		key.rr = key2;
+		if (bytes == key.len * RSA_LIMB_BYTES)
+			rsa_convert_big_endian(key.rr, key.len, prop->rr,
+					       bytes);
+		else
+			rsa_compute_rr(&key, key.rr);
+		rsa_key_cache_add(&key);
+		cached = &key;
+	}
 
-	memcpy(buf, sig, sig_len);
+	rsa_convert_big_endian(buf, key.len, sig, sig_len);
 
-	ret = pow_mod(&key, buf);
+	ret = pow_mod(cached, buf);
 	if (ret)
 		return ret;
 
-	memcpy(out, buf, sig_len);
+	rsa_convert_to_big_endian(out, sig_len, buf);
 
 	return 0;
 }
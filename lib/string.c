@@ -425,6 +425,92 @@ char *strswab(const char *s)
 }
 #endif
 
+/*
+ * Helpers for the word-at-a-time memory functions below. Reading a whole
+ * aligned word is always safe as long as one of its bytes is within the
+ * area, since it cannot cross a page boundary.
+ */
+#define WSIZE		sizeof(unsigned long)
+#define WMASK		(WSIZE - 1)
+#define WALIGNED(p)	(((ulong)(p) & WMASK) == 0)
+#define WONES		(~0UL / 0xff)		/* 0x0101...01 */
+#define WHIGHS		(WONES << 7)		/* 0x8080...80 */
+
+/* Non-zero if any byte of @x is zero */
+#define WHASZERO(x)	(((x) - WONES) & ~(x) & WHIGHS)
+
+/*
+ * Build a word from the last bytes of aligned word @w0 and the first
+ * bytes of @w1, where the wanted data starts @sh0 bits into @w0 and
+ * @sh0 + @sh1 is the number of bits in a word.
+ */
+#if defined(__BYTE_ORDER__) ? __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ : \
+	defined(__BIG_ENDIAN)
+#define WMERGE(w0, sh0, w1, sh1)	(((w0) << (sh0)) | ((w1) >> (sh1)))
+#else
+#define WMERGE(w0, sh0, w1, sh1)	(((w0) >> (sh0)) | ((w1) << (sh1)))
+#endif
+
+/*
+ * Copy @count bytes forwards, a word at a time wherever possible. Since
+ * every source word is read before the destination word at the same or
+ * a lower address is written, this is also safe for overlapping areas
+ * when @dest is below @src.
+ */
+static inline void copy_forward(char *d8, const char *s8, size_t count)
+{
+	unsigned long *dl;
+	const unsigned long *sl;
+	unsigned long w0, w1;
+	unsigned int off, sh0, sh1;
+
+	if (count >= 2 * WSIZE) {
+		/* align the destination */
+		while (!WALIGNED(d8)) {
+			*d8++ = *s8++;
+			count--;
+		}
+		dl = (unsigned long *)d8;
+
+		off = (ulong)s8 & WMASK;
+		if (!off) {
+			sl = (const unsigned long *)s8;
+			while (count >= 4 * WSIZE) {
+				dl[0] = sl[0];
+				dl[1] = sl[1];
+				dl[2] = sl[2];
+				dl[3] = sl[3];
+				dl += 4;
+				sl += 4;
+				count -= 4 * WSIZE;
+			}
+			while (count >= WSIZE) {
+				*dl++ = *sl++;
+				count -= WSIZE;
+			}
+			s8 = (const char *)sl;
+		} else {
+			/* read aligned source words and shift them into place */
+			sh0 = 8 * off;
+			sh1 = 8 * (WSIZE - off);
+			sl = (const unsigned long *)(s8 - off);
+			w0 = *sl++;
+			while (count >= WSIZE) {
+				w1 = *sl++;
+				*dl++ = WMERGE(w0, sh0, w1, sh1);
+				w0 = w1;
+				count -= WSIZE;
+			}
+			s8 = (const char *)sl - WSIZE + off;
+		}
+		d8 = (char *)dl;
+	}
+
+	/* copy the rest one byte at a time */
+	while (count--)
+		*d8++ = *s8++;
+}
+
 #ifndef __HAVE_ARCH_MEMSET
 /**
  * memset - Fill a region of memory with the given value
@@ -436,24 +522,33 @@ char *strswab(const char *s)
  */
 void * memset(void * s,int c,size_t count)
 {
-	unsigned long *sl = (unsigned long *) s;
-	unsigned long cl = 0;
-	char *s8;
-	int i;
+	unsigned long *sl;
+	unsigned long cl;
+	char *s8 = s;
 
 	/* do it one word at a time (32 bits or 64 bits) while possible */
-	if ( ((ulong)s & (sizeof(*sl) - 1)) == 0) {
-		for (i = 0; i < sizeof(*sl); i++) {
-			cl <<= 8;
-			cl |= c & 0xff;
+	if (count >= 2 * WSIZE) {
+		while (!WALIGNED(s8)) {
+			*s8++ = c;
+			count--;
+		}
+		cl = WONES * (c & 0xff);
+		sl = (unsigned long *)s8;
+		while (count >= 4 * WSIZE) {
+			sl[0] = cl;
+			sl[1] = cl;
+			sl[2] = cl;
+			sl[3] = cl;
+			sl += 4;
+			count -= 4 * WSIZE;
 		}
-		while (count >= sizeof(*sl)) {
+		while (count >= WSIZE) {
 			*sl++ = cl;
-			count -= sizeof(*sl);
+			count -= WSIZE;
 		}
+		s8 = (char *)sl;
 	}
 	/* fill 8 bits at a time */
-	s8 = (char *)sl;
 	while (count--)
 		*s8++ = c;
 
@@ -497,24 +592,10 @@ char * bcopy(const char * src, char * dest, int count)
  */
 void * memcpy(void *dest, const void *src, size_t count)
 {
-	unsigned long *dl = (unsigned long *)dest, *sl = (unsigned long *)src;
-	char *d8, *s8;
-
 	if (src == dest)
 		return dest;
 
-	/* while all data is aligned (common case), copy a word at a time */
-	if ( (((ulong)dest | (ulong)src) & (sizeof(*dl) - 1)) == 0) {
-		while (count >= sizeof(*dl)) {
-			*dl++ = *sl++;
-			count -= sizeof(*dl);
-		}
-	}
-	/* copy the reset one byte at a time */
-	d8 = (char *)dl;
-	s8 = (char *)sl;
-	while (count--)
-		*d8++ = *s8++;
+	copy_forward(dest, src, count);
 
 	return dest;
 }
@@ -531,23 +612,39 @@ void * memcpy(void *dest, const void *src, size_t count)
  */
 void * memmove(void * dest,const void *src,size_t count)
 {
-	char *tmp, *s;
+	unsigned long *dl;
+	const unsigned long *sl;
+	char *tmp;
+	const char *s;
 
 	if (src == dest)
 		return dest;
 
 	if (dest <= src) {
-		tmp = (char *) dest;
-		s = (char *) src;
-		while (count--)
-			*tmp++ = *s++;
-		}
-	else {
-		tmp = (char *) dest + count;
-		s = (char *) src + count;
-		while (count--)
+		copy_forward(dest, src, count);
+		return dest;
+	}
+
+	tmp = (char *)dest + count;
+	s = (const char *)src + count;
+
+	/* copy backwards a word at a time if both ends can be aligned */
+	if (count >= 2 * WSIZE && (((ulong)tmp ^ (ulong)s) & WMASK) == 0) {
+		while (!WALIGNED(tmp)) {
 			*--tmp = *--s;
+			count--;
+		}
+		dl = (unsigned long *)tmp;
+		sl = (const unsigned long *)s;
+		while (count >= WSIZE) {
+			*--dl = *--sl;
+			count -= WSIZE;
 		}
+		tmp = (char *)dl;
+		s = (const char *)sl;
+	}
+	while (count--)
+		*--tmp = *--s;
 
 	return dest;
 }
@@ -562,10 +659,29 @@ void * memmove(void * dest,const void *src,size_t count)
  */
 int memcmp(const void * cs,const void * ct,size_t count)
 {
-	const unsigned char *su1, *su2;
+	const unsigned char *su1 = cs, *su2 = ct;
 	int res = 0;
 
-	for( su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+	/*
+	 * Skip equal words while both areas are aligned alike; the byte loop
+	 * below then finds the difference within the first unequal word.
+	 */
+	if (count >= 2 * WSIZE && (((ulong)su1 ^ (ulong)su2) & WMASK) == 0) {
+		while (!WALIGNED(su1)) {
+			res = *su1++ - *su2++;
+			if (res)
+				return res;
+			count--;
+		}
+		while (count >= WSIZE && *(const unsigned long *)su1 ==
+					 *(const unsigned long *)su2) {
+			su1 += WSIZE;
+			su2 += WSIZE;
+			count -= WSIZE;
+		}
+	}
+
+	for (; 0 < count; ++su1, ++su2, count--)
 		if ((res = *su1 - *su2) != 0)
 			break;
 	return res;
@@ -633,6 +749,26 @@ char * strstr(const char * s1,const char * s2)
 void *memchr(const void *s, int c, size_t n)
 {
 	const unsigned char *p = s;
+	unsigned long cl, x;
+
+	/* look for a word holding @c, then for @c within that word */
+	if (n >= 2 * WSIZE) {
+		while (!WALIGNED(p)) {
+			if ((unsigned char)c == *p)
+				return (void *)p;
+			p++;
+			n--;
+		}
+		cl = WONES * (c & 0xff);
+		while (n >= WSIZE) {
+			x = *(const unsigned long *)p ^ cl;
+			if (WHASZERO(x))
+				break;
+			p += WSIZE;
+			n -= WSIZE;
+		}
+	}
+
 	while (n-- != 0) {
 		if ((unsigned char)c == *p++) {
 			return (void *)(p-1);
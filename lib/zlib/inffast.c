@@ -31,6 +31,87 @@
 #  define PUP(a) *++(a)
 #endif
 
+/*
+   U-Boot: where longs are 64 bits wide the bit buffer is refilled with one
+   unaligned 64-bit load per code, which leaves at least 56 bits in it.  That
+   is enough for a whole length/distance pair (48 bits, see below), so the
+   byte-at-a-time refills further down are then only used close to the end
+   of the input.  Bits above "bits" in hold may hold the input which follows,
+   so new bytes are or-ed in rather than added.
+ */
+#if BITS_PER_LONG == 64
+#  define INFLATE_WIDE_HOLD
+#endif
+
+/*
+   Copy one word between addresses of any alignment.  The fixed-size
+   __builtin_memcpy() becomes a plain load and store where the CPU allows
+   unaligned accesses and byte accesses where it does not.
+ */
+#define ZWSIZE sizeof(unsigned long)
+
+local inline void copy_word(unsigned char FAR *dst,
+                            const unsigned char FAR *src)
+{
+    unsigned long w;
+
+    __builtin_memcpy(&w, src, ZWSIZE);
+    __builtin_memcpy(dst, &w, ZWSIZE);
+}
+
+/*
+   Copy len bytes a word at a time.  src must not overlap dst, or be at least
+   a word below it.  Returns the new dst.
+ */
+local inline unsigned char FAR *copy_words(unsigned char FAR *dst,
+                                           const unsigned char FAR *src,
+                                           unsigned len)
+{
+    while (len >= 2 * ZWSIZE) {
+        copy_word(dst, src);
+        copy_word(dst + ZWSIZE, src + ZWSIZE);
+        dst += 2 * ZWSIZE;
+        src += 2 * ZWSIZE;
+        len -= 2 * ZWSIZE;
+    }
+    if (len >= ZWSIZE) {
+        copy_word(dst, src);
+        dst += ZWSIZE;
+        src += ZWSIZE;
+        len -= ZWSIZE;
+    }
+    while (len--)
+        *dst++ = *src++;
+    return dst;
+}
+
+/*
+   Copy a match of len bytes from dist bytes back in the output.  When dist
+   is less than a word, the match repeats every dist bytes, so after the
+   first few bytes it can be copied from a multiple of dist that is at least
+   a word back.  Returns the new out.
+ */
+local inline unsigned char FAR *copy_match(unsigned char FAR *out,
+                                           unsigned dist, unsigned len)
+{
+    const unsigned char FAR *src = out - dist;
+    unsigned step, n;
+
+    if (dist < ZWSIZE) {
+        step = dist;
+        while (step < ZWSIZE)
+            step += dist;
+        n = step - dist;
+        if (n > len)
+            n = len;
+        len -= n;
+        while (n--)
+            *out++ = *src++;
+        src = out - step;
+    }
+    return copy_words(out, src, len);
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -72,6 +153,9 @@ void inflate_fast(z_streamp strm, unsigned start)
     struct inflate_state FAR *state;
     unsigned char FAR *in;      /* local strm->next_in */
     unsigned char FAR *last;    /* while in < last, enough input available */
+#ifdef INFLATE_WIDE_HOLD
+    unsigned char FAR *wlast;   /* while in < wlast, 8 bytes can be loaded */
+#endif
     unsigned char FAR *out;     /* local strm->next_out */
     unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
     unsigned char FAR *end;     /* while out < end, enough space available */
@@ -107,6 +191,9 @@ void inflate_fast(z_streamp strm, unsigned start)
 	strm->avail_in = 0xffffffff - (uintptr_t)in;
         last = in + (strm->avail_in - 5);
     }
+#ifdef INFLATE_WIDE_HOLD
+    wlast = last - 2;
+#endif
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
@@ -127,10 +214,17 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#ifdef INFLATE_WIDE_HOLD
+        if (in < wlast) {
+            hold |= (unsigned long)get_unaligned_le64(in + OFF) << bits;
+            in += (63 - bits) >> 3;
+            bits |= 56;
+        }
+#endif
         if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
+            hold |= (unsigned long)(PUP(in)) << bits;
             bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
+            hold |= (unsigned long)(PUP(in)) << bits;
             bits += 8;
         }
         this = lcode[hold & lmask];
@@ -150,7 +244,7 @@ void inflate_fast(z_streamp strm, unsigned start)
             op &= 15;                           /* number of extra bits */
             if (op) {
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                 }
                 len += (unsigned)hold & ((1U << op) - 1);
@@ -159,9 +253,9 @@ void inflate_fast(z_streamp strm, unsigned start)
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
             if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
             }
             this = dcode[hold & dmask];
@@ -174,10 +268,10 @@ void inflate_fast(z_streamp strm, unsigned start)
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                     if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
+                        hold |= (unsigned long)(PUP(in)) << bits;
                         bits += 8;
                     }
                 }
@@ -205,9 +299,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = copy_words(out + OFF, from + OFF, op) - OFF;
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -216,16 +308,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = copy_words(out + OFF, from + OFF, op) - OFF;
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                out = copy_words(out + OFF, from + OFF, op) - OFF;
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -234,67 +322,17 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = copy_words(out + OFF, from + OFF, op) - OFF;
                             from = out - dist;  /* rest from output */
                         }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
-                }
-                else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
-                    from = out - dist;          /* copy direct from output */
-                    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2 ) {
-			unsigned short *sfrom;
-
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-			    PUP(sout) = get_unaligned(++sfrom);
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
-
-			pat16 = *(sout-2+2*OFF);
-			if (dist == 1)
-#if defined(__BIG_ENDIAN)
-			    pat16 = (pat16 & 0xff) | ((pat16 & 0xff ) << 8);
-#elif defined(__LITTLE_ENDIAN)
-			    pat16 = (pat16 & 0xff00) | ((pat16 & 0xff00 ) >> 8);
-#else
-#error __BIG_ENDIAN nor __LITTLE_ENDIAN is defined
-#endif
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                    if (from == out - dist)     /* rest from output */
+                        out = copy_match(out + OFF, dist, len) - OFF;
+                    else                        /* all from window */
+                        out = copy_words(out + OFF, from + OFF, len) - OFF;
                 }
+                else                            /* copy direct from output */
+                    out = copy_match(out + OFF, dist, len) - OFF;
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
                 this = dcode[this.val + (hold & ((1U << op) - 1))];
@@ -10,6 +10,7 @@
  * - added minCompression parameter to deflateInit2
  * - added Z_PACKET_FLUSH (see zlib.h for details)
  * - added inflateIncomp
+ * - inflate_fast() refills 64 bits at a time and copies matches by words
  */
 
 #include <common.h>
@@ -46,24 +46,21 @@ static ulong time_start;   /* Record time we started tftp */
 /*
  * These globals govern the timeout behavior when attempting a connection to a
  * TFTP server. tftp_timeout_ms specifies the number of milliseconds to
- * wait for the server to respond to initial connection. Second global,
- * tftp_timeout_count_max, gives the number of such connection retries.
- * tftp_timeout_count_max must be non-negative and tftp_timeout_ms must be
- * positive. The globals are meant to be set (and restored) by code needing
- * non-standard timeout behavior when initiating a TFTP transfer.
+ * wait for the server to respond to initial connection, or 0 to wait as
+ * long as for data packets. Second global, tftp_timeout_count_max, gives
+ * the number of such connection retries. tftp_timeout_count_max must be
+ * non-negative. The globals are meant to be set (and restored) by code
+ * needing non-standard timeout behavior when initiating a TFTP transfer,
+ * e.g. to give up quickly on files which are likely to be missing.
  */
-ulong tftp_timeout_ms = TIMEOUT;
+ulong tftp_timeout_ms;
 int tftp_timeout_count_max = TIMEOUT_COUNT;
 
-enum {
-	TFTP_ERR_UNDEFINED           = 0,
-	TFTP_ERR_FILE_NOT_FOUND      = 1,
-	TFTP_ERR_ACCESS_DENIED       = 2,
-	TFTP_ERR_DISK_FULL           = 3,
-	TFTP_ERR_UNEXPECTED_OPCODE   = 4,
-	TFTP_ERR_UNKNOWN_TRANSFER_ID  = 5,
-	TFTP_ERR_FILE_ALREADY_EXISTS = 6,
-};
+/*
+ * Error code from the ERROR packet which ended the last transfer, or -1 if
+ * it did not end with one (e.g. it succeeded or timed out).
+ */
+int tftp_error = -1;
 
 static struct in_addr tftp_remote_ip;
 /* The UDP port at their end */
@@ -133,6 +130,18 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * Number of blocks the server may send before waiting for an ACK (RFC 7440).
+ * 1 means plain lock-step TFTP, and the option is then not requested.
+ */
+#define TFTP_MAX_WINDOWSIZE	64
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = 1;
+/* Blocks received since the last ACK */
+static unsigned short tftp_window_count;
+/* 1 if the last in-order block has been ACKed again after a loss */
+static int tftp_window_nacked;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -371,6 +380,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* Only a download can use a window */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -526,6 +539,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		      pkt, pkt + strlen((char *)pkt) + 1);
 		tftp_state = STATE_OACK;
 		tftp_remote_port = src;
+		/* The server has the file, so retry as for data from now on */
+		timeout_count_max = TIMEOUT_COUNT;
 		/*
 		 * Check for 'blksize' option.
 		 * Careful: "i" is signed, "len" is unsigned, thus
@@ -539,6 +554,15 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (i + 11 < len &&
+			    strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = simple_strtoul(
+					(char *)pkt + i + 11, NULL, 10);
+				if (!tftp_windowsize ||
+				    tftp_windowsize > tftp_windowsize_option)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %d\n", tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -569,6 +593,23 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
+		/*
+		 * With a window, the blocks after a lost one arrive out of
+		 * order. Drop them and ACK the last block received in order
+		 * once, so that the server sends again from there.
+		 */
+		if ((tftp_state == STATE_DATA || tftp_state == STATE_OACK) &&
+		    tftp_windowsize > 1 &&
+		    tftp_cur_block != ((tftp_prev_block + 1) & 0xffff)) {
+			tftp_cur_block = tftp_prev_block;
+			if (!tftp_window_nacked) {
+				tftp_window_nacked = 1;
+				tftp_window_count = 0;
+				tftp_send();
+			}
+			break;
+		}
+
 		update_block_number();
 
 		if (tftp_state == STATE_SEND_RRQ)
@@ -637,7 +678,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 #endif
-		tftp_send();
+		/* Within a window only the last block is acknowledged */
+		tftp_window_nacked = 0;
+		if (len < tftp_block_size ||
+		    ++tftp_window_count >= tftp_windowsize) {
+			tftp_window_count = 0;
+			tftp_send();
+		}
 
 #ifdef CONFIG_MCAST_TFTP
 		if (tftp_mcast_active) {
@@ -657,7 +704,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		printf("\nTFTP error: '%s' (%d)\n",
 		       pkt + 2, ntohs(*(__be16 *)pkt));
 
-		switch (ntohs(*(__be16 *)pkt)) {
+		tftp_error = ntohs(*(__be16 *)pkt);
+		switch (tftp_error) {
 		case TFTP_ERR_FILE_NOT_FOUND:
 		case TFTP_ERR_ACCESS_DENIED:
 			puts("Not retrying...\n");
@@ -682,13 +730,25 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 }
 
 
+/* Time to wait for a reply before sending the last packet again */
+static ulong tftp_get_timeout(void)
+{
+	if (tftp_state == STATE_SEND_RRQ && tftp_timeout_ms)
+		return tftp_timeout_ms;
+
+	return timeout_ms;
+}
+
 static void tftp_timeout_handler(void)
 {
 	if (++timeout_count > timeout_count_max) {
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		net_set_timeout_handler(tftp_get_timeout(),
+					tftp_timeout_handler);
+		/* ACK the last block again, in case a window got lost */
+		tftp_window_count = 0;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -711,6 +771,14 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = clamp_t(long,
+						 simple_strtol(ep, NULL, 10),
+						 1, TFTP_MAX_WINDOWSIZE);
+	else
+		tftp_windowsize_option = 1;
+
 	if (timeout_ms < 1000) {
 		printf("TFTP timeout (%ld ms) too low, set min = 1000 ms\n",
 		       timeout_ms);
@@ -796,7 +864,7 @@ void tftp_start(enum proto_t protocol)
 	time_start = get_timer(0);
 	timeout_count_max = tftp_timeout_count_max;
 
-	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	net_set_timeout_handler(tftp_get_timeout(), tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
@@ -815,11 +883,17 @@ void tftp_start(enum proto_t protocol)
 		tftp_our_port = simple_strtol(ep, NULL, 10);
 #endif
 	tftp_cur_block = 0;
+	new_transfer();
+	tftp_error = -1;
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	/* Until the server agrees to a window */
+	tftp_windowsize = 1;
+	tftp_window_count = 0;
+	tftp_window_nacked = 0;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -849,6 +923,7 @@ void tftp_start_server(void)
 
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
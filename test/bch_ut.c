@@ -0,0 +1,142 @@
+/*
+ * Unit test and benchmark for the software BCH library
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/bch.h>
+
+/* Number of sectors decoded for each set of parameters */
+#define BCH_UT_SECTORS		512
+
+struct bch_ut_params {
+	int m;		/* Galois field order */
+	int t;		/* correctable bit errors per sector */
+	int len;	/* sector size in bytes */
+};
+
+static const struct bch_ut_params bch_ut_params[] = {
+	{ 13, 4, 512 },
+	{ 13, 8, 512 },
+	{ 14, 16, 1024 },
+	{ 14, 24, 1024 },
+};
+
+/* Flip bit @pos of the codeword made of @data followed by @ecc */
+static void flip_bit(unsigned int pos, uint8_t *data, int len, uint8_t *ecc)
+{
+	if (pos < 8 * len) {
+		data[pos / 8] ^= 1 << (pos % 8);
+	} else {
+		pos -= 8 * len;
+		ecc[pos / 8] ^= 0x80 >> (pos % 8);
+	}
+}
+
+static int test_bch_decode(const struct bch_ut_params *p)
+{
+	struct bch_control *bch;
+	uint8_t *data, *orig, *ecc;
+	unsigned int *errloc, *pos;
+	unsigned int nbits;
+	ulong start, clean_us = 0, err_us = 0;
+	int clean = 0, errors = 0;
+	int sector, nerr, i, j, ret = -ENOMEM;
+
+	bch = init_bch(p->m, p->t, 0);
+	if (!bch) {
+		printf("%s: init_bch(%d, %d) failed\n", __func__, p->m, p->t);
+		return -EINVAL;
+	}
+
+	data = malloc(p->len);
+	orig = malloc(p->len);
+	ecc = malloc(bch->ecc_bytes);
+	errloc = malloc(p->t * sizeof(*errloc));
+	pos = malloc(p->t * sizeof(*pos));
+	if (!data || !orig || !ecc || !errloc || !pos)
+		goto out;
+
+	/* Only the first ecc_bits of the ecc bytes are part of the code */
+	nbits = 8 * p->len + bch->ecc_bits;
+
+	for (sector = 0; sector < BCH_UT_SECTORS; sector++) {
+		for (i = 0; i < p->len; i++)
+			orig[i] = rand();
+		memset(ecc, 0, bch->ecc_bytes);
+		encode_bch(bch, orig, p->len, ecc);
+		memcpy(data, orig, p->len);
+
+		/* Half of the sectors are clean, the others have 1..t errors */
+		nerr = sector & 1 ? 1 + rand() % p->t : 0;
+		for (i = 0; i < nerr; i++) {
+			do {
+				pos[i] = rand() % nbits;
+				for (j = 0; j < i && pos[j] != pos[i]; j++)
+					;
+			} while (j < i);
+			flip_bit(pos[i], data, p->len, ecc);
+		}
+
+		start = timer_get_us();
+		ret = decode_bch(bch, data, p->len, ecc, NULL, NULL, errloc);
+		if (nerr) {
+			err_us += timer_get_us() - start;
+			errors++;
+		} else {
+			clean_us += timer_get_us() - start;
+			clean++;
+		}
+
+		if (ret != nerr) {
+			printf("%s: m=%d t=%d sector %d: found %d errors, expected %d\n",
+			       __func__, p->m, p->t, sector, ret, nerr);
+			ret = -EBADMSG;
+			goto out;
+		}
+
+		for (i = 0; i < ret; i++) {
+			if (errloc[i] < 8 * p->len)
+				data[errloc[i] / 8] ^= 1 << (errloc[i] % 8);
+		}
+
+		if (memcmp(data, orig, p->len)) {
+			printf("%s: m=%d t=%d sector %d: data not corrected\n",
+			       __func__, p->m, p->t, sector);
+			ret = -EBADMSG;
+			goto out;
+		}
+	}
+
+	printf("m=%d t=%d %d bytes: %d clean sectors in %lu us, %d sectors with errors in %lu us\n",
+	       p->m, p->t, p->len, clean, clean_us, errors, err_us);
+	ret = 0;
+
+out:
+	free(pos);
+	free(errloc);
+	free(ecc);
+	free(orig);
+	free(data);
+	free_bch(bch);
+
+	return ret;
+}
+
+int do_ut_bch(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret = 0;
+	int i;
+
+	srand(0x1234);
+	for (i = 0; i < ARRAY_SIZE(bch_ut_params); i++)
+		ret |= test_bch_decode(&bch_ut_params[i]);
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
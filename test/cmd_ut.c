@@ -22,6 +22,21 @@ static cmd_tbl_t cmd_ut_sub[] = {
 #ifdef CONFIG_UT_TIME
 	U_BOOT_CMD_MKENT(time, CONFIG_SYS_MAXARGS, 1, do_ut_time, "", ""),
 #endif
+#ifdef CONFIG_UT_BCH
+	U_BOOT_CMD_MKENT(bch, CONFIG_SYS_MAXARGS, 1, do_ut_bch, "", ""),
+#endif
+#ifdef CONFIG_UT_STRING
+	U_BOOT_CMD_MKENT(string, CONFIG_SYS_MAXARGS, 1, do_ut_string, "", ""),
+#endif
+#ifdef CONFIG_UT_RSA
+	U_BOOT_CMD_MKENT(rsa, CONFIG_SYS_MAXARGS, 1, do_ut_rsa, "", ""),
+#endif
+#ifdef CONFIG_UT_HUSH
+	U_BOOT_CMD_MKENT(hush, CONFIG_SYS_MAXARGS, 1, do_ut_hush, "", ""),
+#endif
+#if defined(CONFIG_UT_LCD) && defined(CONFIG_LCD)
+	U_BOOT_CMD_MKENT(lcd, CONFIG_SYS_MAXARGS, 1, do_ut_lcd, "", ""),
+#endif
 };
 
 static int do_ut_all(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -70,6 +85,21 @@ static char ut_help_text[] =
 #endif
 #ifdef CONFIG_UT_TIME
 	"ut time - Very basic test of time functions\n"
+#endif
+#ifdef CONFIG_UT_BCH
+	"ut bch - Test and benchmark BCH decoding\n"
+#endif
+#ifdef CONFIG_UT_STRING
+	"ut string - Test and benchmark memory functions\n"
+#endif
+#ifdef CONFIG_UT_RSA
+	"ut rsa - Test and benchmark RSA signature verification\n"
+#endif
+#ifdef CONFIG_UT_HUSH
+	"ut hush - Test and benchmark running environment scripts\n"
+#endif
+#if defined(CONFIG_UT_LCD) && defined(CONFIG_LCD)
+	"ut lcd - Test and benchmark LCD console scrolling\n"
 #endif
 	;
 #endif
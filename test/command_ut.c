@@ -15,11 +15,47 @@ static const char test_cmd[] = "setenv list 1\n setenv list ${list}2; "
 		"setenv list ${list}3\0"
 		"setenv list ${list}4";
 
+/*
+ * Check that find_cmd() gives the same result as a plain search of the
+ * command table, for each command name, each shorter abbreviation of it
+ * and each with a size suffix
+ */
+static void test_find_cmd(void)
+{
+	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	cmd_tbl_t *cmdtp;
+	char name[40];
+	ulong ticks;
+	int i, len;
+
+	for (cmdtp = start; cmdtp != start + count; cmdtp++) {
+		for (len = strlen(cmdtp->name); len >= 0; len--) {
+			if (len >= sizeof(name) - 2)
+				continue;
+			strncpy(name, cmdtp->name, len);
+			name[len] = '\0';
+			assert(find_cmd(name) == find_cmd_tbl(name, start, count));
+			strcpy(name + len, ".b");
+			assert(find_cmd(name) == find_cmd_tbl(name, start, count));
+		}
+	}
+	assert(!find_cmd("no_such_command"));
+	assert(!find_cmd(NULL));
+
+	ticks = get_timer(0);
+	for (i = 0; i < 100000; i++)
+		find_cmd("setenv");
+	printf("%s: 100000 lookups took %lu ms\n", __func__, get_timer(ticks));
+}
+
 static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	printf("%s: Testing commands\n", __func__);
 	run_command("env default -f -a", 0);
 
+	test_find_cmd();
+
 	/* run a single command */
 	run_command("setenv single 1", 0);
 	assert(!strcmp("1", getenv("single")));
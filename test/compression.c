@@ -371,6 +371,147 @@ out:
 	return ret;
 }
 
+/* Size of the generated data used to check and time gunzip() */
+#define BENCH_SIZE		(4 << 20)
+#define BENCH_LOOPS		8
+/* Output chunk when inflating as a stream, so that the window is used */
+#define BENCH_CHUNK		1000
+
+/*
+ * Fill @buf with data which compresses roughly like a kernel image: runs
+ * of literals from a small alphabet and matches at short, medium and
+ * full-window distances, including the overlapping ones (1..7 bytes back).
+ */
+static void fill_bench_data(u8 *buf, ulong size)
+{
+	static const uint dists[] = {
+		1, 2, 3, 4, 5, 6, 7, 8, 9, 13, 16, 31, 64, 100, 1000, 4096,
+		20000, 32768,
+	};
+	uint seed = 1;
+	ulong pos = 0;
+	uint len, dist;
+
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		len = (seed >> 8) % 40 + 1;
+		if ((seed >> 20) & 1) {
+			while (len-- && pos < size) {
+				seed = seed * 1103515245 + 12345;
+				buf[pos++] = "etaoinshrdlu \n\0\xff"[(seed >> 16) % 16];
+			}
+		} else {
+			dist = dists[(seed >> 24) % ARRAY_SIZE(dists)];
+			len = (seed >> 4) % 256 + 3;
+			if (dist > pos)
+				continue;
+			for (; len && pos < size; len--, pos++)
+				buf[pos] = buf[pos - dist];
+		}
+	}
+}
+
+/* Inflate in small output chunks and check against @orig */
+static int inflate_chunks(void *in, ulong in_size, const u8 *orig,
+			  ulong orig_size, u8 *out)
+{
+	z_stream s;
+	ulong done = 0;
+	int r;
+
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+	r = inflateInit2(&s, 16 + MAX_WBITS);
+	if (r != Z_OK)
+		return r;
+	s.next_in = in;
+	s.avail_in = in_size;
+	do {
+		s.next_out = out;
+		s.avail_out = BENCH_CHUNK;
+		r = inflate(&s, Z_NO_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END)
+			break;
+		if (done + BENCH_CHUNK - s.avail_out > orig_size ||
+		    memcmp(out, orig + done, BENCH_CHUNK - s.avail_out)) {
+			r = Z_DATA_ERROR;
+			break;
+		}
+		done += BENCH_CHUNK - s.avail_out;
+	} while (r == Z_OK);
+	inflateEnd(&s);
+
+	return r == Z_STREAM_END && done == orig_size ? 0 : -1;
+}
+
+static void bench_print(const char *name, ulong size, ulong us)
+{
+	printf("\t%s: %lu us, %lu MiB/s\n", name, us,
+	       us ? size / 1024 * 1000 / 1024 * 1000 / us : 0);
+}
+
+static int run_bench(void)
+{
+	ulong compressed_size, size, start;
+	u8 *orig_buf, *compressed_buf, *uncompressed_buf;
+	int ret, i;
+
+	printf(" benchmarking gzip ...\n");
+	orig_buf = malloc(BENCH_SIZE);
+	compressed_buf = malloc(BENCH_SIZE);
+	uncompressed_buf = malloc(BENCH_SIZE);
+	errcheck(orig_buf && compressed_buf && uncompressed_buf);
+
+	fill_bench_data(orig_buf, BENCH_SIZE);
+	compressed_size = BENCH_SIZE;
+	start = timer_get_us();
+	errcheck(zzip(compressed_buf, &compressed_size, orig_buf, BENCH_SIZE,
+		      1, NULL) == 0);
+	bench_print("zzip", BENCH_SIZE, timer_get_us() - start);
+	printf("\tcompressed_size:%lu\n", compressed_size);
+	errcheck(inflate_chunks(compressed_buf, compressed_size, orig_buf,
+				BENCH_SIZE, uncompressed_buf) == 0);
+
+#ifdef CONFIG_GZIP_PARALLEL
+	compressed_size = BENCH_SIZE;
+	start = timer_get_us();
+	errcheck(gzip_parallel(compressed_buf, &compressed_size, orig_buf,
+			       BENCH_SIZE) == 0);
+	bench_print("gzip_parallel", BENCH_SIZE, timer_get_us() - start);
+	printf("\tcompressed_size:%lu\n", compressed_size);
+	errcheck(inflate_chunks(compressed_buf, compressed_size, orig_buf,
+				BENCH_SIZE, uncompressed_buf) == 0);
+
+	/* Too little space must be reported */
+	size = compressed_size - 1;
+	errcheck(gzip_parallel(uncompressed_buf, &size, orig_buf,
+			       BENCH_SIZE) != 0);
+#endif
+	printf("\tstreamed inflate matches\n");
+
+	memset(uncompressed_buf, '\0', BENCH_SIZE);
+	start = timer_get_us();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		errcheck(uncompress_using_gzip(compressed_buf, compressed_size,
+					       uncompressed_buf, BENCH_SIZE,
+					       &size) == 0);
+	}
+	bench_print("gunzip", BENCH_SIZE * BENCH_LOOPS,
+		    timer_get_us() - start);
+	errcheck(size == BENCH_SIZE);
+	errcheck(memcmp(orig_buf, uncompressed_buf, BENCH_SIZE) == 0);
+	ret = 0;
+
+out:
+	printf(" gzip bench: %s\n", ret == 0 ? "ok" : "FAILED");
+	free(uncompressed_buf);
+	free(compressed_buf);
+	free(orig_buf);
+
+	return ret;
+}
+
 static int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 			     char *const argv[])
 {
@@ -381,6 +522,7 @@ static int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 	err += run_test("lzma", compress_using_lzma, uncompress_using_lzma);
 	err += run_test("lzo", compress_using_lzo, uncompress_using_lzo);
 	err += run_test("lz4", compress_using_lz4, uncompress_using_lz4);
+	err += run_bench();
 
 	printf("ut_compression %s\n", err == 0 ? "ok" : "FAILED");
 
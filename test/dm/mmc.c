@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -25,3 +26,89 @@ static int dm_test_mmc_base(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_base, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Write some blocks and read them back, which needs a working bus */
+static int check_rw(struct unit_test_state *uts, struct mmc *mmc)
+{
+	block_dev_desc_t *bdev = &mmc->block_dev;
+	char wbuf[4 * 512], rbuf[4 * 512];
+	int i;
+
+	for (i = 0; i < sizeof(wbuf); i++)
+		wbuf[i] = i * 7 + 1;
+	ut_asserteq(4, bdev->block_write(bdev->dev, 100, 4, wbuf));
+	ut_asserteq(4, bdev->block_read(bdev->dev, 100, 4, rbuf));
+	ut_assertok(memcmp(wbuf, rbuf, sizeof(wbuf)));
+
+	return 0;
+}
+
+/* An eMMC which supports HS400 must be tuned in HS200 and then moved on */
+static int dm_test_mmc_hs400(struct unit_test_state *uts)
+{
+	struct mmc_uclass_priv *upriv;
+	struct udevice *dev;
+	struct mmc *mmc;
+	uint phase;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	upriv = dev_get_uclass_priv(dev);
+	mmc = upriv->mmc;
+	ut_assertok(mmc_init(mmc));
+
+	ut_assert(!IS_SD(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_MMC_HS400, mmc->timing);
+	ut_asserteq(200000000, mmc->clock);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(1, mmc->ddr_mode);
+	phase = sandbox_mmc_get_phase(dev);
+	ut_assert(phase >= SANDBOX_MMC_EYE_FIRST);
+	ut_assert(phase <= SANDBOX_MMC_EYE_LAST);
+	ut_assertok(check_rw(uts, mmc));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_hs400, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* An SD card must be switched to 1.8V and tuned to run at SDR104 */
+static int dm_test_mmc_sdr104(struct unit_test_state *uts)
+{
+	struct mmc_uclass_priv *upriv;
+	struct udevice *dev;
+	struct mmc *mmc;
+	uint phase;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 1, &dev));
+	upriv = dev_get_uclass_priv(dev);
+	mmc = upriv->mmc;
+	ut_assertok(mmc_init(mmc));
+
+	ut_assert(IS_SD(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+	ut_asserteq(208000000, mmc->clock);
+	ut_asserteq(4, mmc->bus_width);
+	phase = sandbox_mmc_get_phase(dev);
+	ut_assert(phase >= SANDBOX_MMC_EYE_FIRST);
+	ut_assert(phase <= SANDBOX_MMC_EYE_LAST);
+	ut_assertok(check_rw(uts, mmc));
+
+	/* A second init power-cycles the card and starts again from 3.3V */
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+	ut_assertok(check_rw(uts, mmc));
+
+	/* Without a power switch the card stays at 1.8V, and so must we */
+	sandbox_mmc_set_power_switch(dev, false);
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+	ut_assertok(check_rw(uts, mmc));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdr104, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,183 @@
+/*
+ * Unit test and benchmark for running environment scripts with hush
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <cli_hush.h>
+#include <command.h>
+#include <errno.h>
+
+/* Number of runs of the benchmark script */
+#define HUSH_UT_BENCH_LOOPS	20
+
+/* A loop over devices and partitions like the distro boot scripts */
+static const char bench_script[] =
+	"for target in mmc0 mmc1 usb0 pxe dhcp; do "
+		"for part in 1 2 3 4; do "
+			"if test ${target} = none; then "
+				"echo ${target}:${part}; "
+			"elif test ${part} -gt 8; then "
+				"echo too many; "
+			"else "
+				"run hush_ut_try; "
+			"fi; "
+		"done; "
+	"done";
+
+static const char bench_try[] =
+	"setenv devnum 0; setenv devtype ${target}; "
+	"if test -n \"${devplist}\"; then "
+		"for p in ${devplist}; do echo $p; done; "
+	"elif test ${devtype} = pxe -o ${devtype} = dhcp; then "
+		"setenv devnum none; "
+	"else "
+		"setenv devplist; "
+	"fi";
+
+static int check_env(const char *name, const char *expect)
+{
+	const char *val = getenv(name);
+
+	if (!val || strcmp(val, expect)) {
+		printf("%s: %s is '%s', expected '%s'\n", __func__, name,
+		       val ? val : "(null)", expect);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int test_run(void)
+{
+	int ret = 0;
+	int i;
+
+	/* A loop which is run several times and must give the same result */
+	setenv("hush_ut_a", "setenv out; for i in 1 2 3; do "
+	       "setenv out ${out}$i; done");
+	for (i = 0; i < 3; i++) {
+		run_command("run hush_ut_a", 0);
+		ret |= check_env("out", "123");
+	}
+
+	/* Leaving a loop early must not spoil the next run */
+	setenv("hush_ut_a", "setenv out; for i in 1 2 3; do "
+	       "setenv out ${out}$i; if test $i = 2; then exit; fi; done");
+	for (i = 0; i < 3; i++) {
+		run_command("run hush_ut_a", 0);
+		ret |= check_env("out", "12");
+	}
+
+	/* Changing the variable must be noticed */
+	setenv("hush_ut_a", "setenv out first");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "first");
+	setenv("hush_ut_a", "setenv out second");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "second");
+
+	/* ...and the new script must be cached again */
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "second");
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+	if (!hush_script_cached("hush_ut_a")) {
+		printf("%s: changed script is not cached again\n", __func__);
+		ret = -EINVAL;
+	}
+#endif
+
+	/* Also when the script changes itself while it runs */
+	setenv("hush_ut_a", "setenv hush_ut_a setenv out again; "
+	       "setenv out changed");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "changed");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "again");
+
+	/* A script which runs itself */
+	setenv("hush_ut_a", "if test ${out} = x; then setenv out xx; "
+	       "run hush_ut_a; else setenv out ${out}y; fi");
+	setenv("out", "x");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "xxy");
+
+	/* Deleting and setting it again */
+	setenv("hush_ut_a", NULL);
+	if (!run_command("run hush_ut_a", 0)) {
+		printf("%s: run of a deleted variable succeeded\n", __func__);
+		ret = -EINVAL;
+	}
+	setenv("hush_ut_a", "setenv out back");
+	run_command("run hush_ut_a", 0);
+	ret |= check_env("out", "back");
+
+	/* Results and errors are passed on */
+	setenv("hush_ut_a", "false");
+	if (!run_command("run hush_ut_a", 0)) {
+		printf("%s: failing script succeeded\n", __func__);
+		ret = -EINVAL;
+	}
+	setenv("hush_ut_a", "if true; then");
+	if (!run_command("run hush_ut_a", 0)) {
+		printf("%s: script with syntax error succeeded\n", __func__);
+		ret = -EINVAL;
+	}
+
+	setenv("hush_ut_a", NULL);
+	setenv("out", NULL);
+
+	return ret;
+}
+
+static void bench_print(const char *name, ulong us)
+{
+	printf("%-22s %8lu us\n", name, us);
+}
+
+static void bench_run(void)
+{
+	const char *script;
+	ulong start;
+	int i;
+
+	setenv("hush_ut_bench", bench_script);
+	setenv("hush_ut_try", bench_try);
+
+	/* The loop body alone, parsed each time and then through 'run' */
+	start = timer_get_us();
+	for (i = 0; i < HUSH_UT_BENCH_LOOPS * 20; i++) {
+		script = getenv("hush_ut_try");
+		run_command(script, CMD_FLAG_ENV);
+	}
+	bench_print("body, parsed", timer_get_us() - start);
+
+	start = timer_get_us();
+	for (i = 0; i < HUSH_UT_BENCH_LOOPS * 20; i++)
+		run_command("run hush_ut_try", 0);
+	bench_print("body, run", timer_get_us() - start);
+
+	/* The whole loop, which runs the body 20 times */
+	start = timer_get_us();
+	for (i = 0; i < HUSH_UT_BENCH_LOOPS; i++)
+		run_command("run hush_ut_bench", 0);
+	bench_print("loop, run", timer_get_us() - start);
+
+	setenv("hush_ut_bench", NULL);
+	setenv("hush_ut_try", NULL);
+	setenv("devnum", NULL);
+	setenv("devtype", NULL);
+}
+
+int do_ut_hush(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret;
+
+	ret = test_run();
+	if (!ret)
+		bench_run();
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
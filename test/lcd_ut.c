@@ -0,0 +1,124 @@
+/*
+ * Unit test and benchmark for the LCD text console in common/lcd_console.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <lcd.h>
+#include <malloc.h>
+
+/* Screen size used for the test, independent of the panel */
+#define LCD_UT_WIDTH		1920
+#define LCD_UT_HEIGHT		1080
+/* Spare lines for hardware scrolling, so that it wraps a few times */
+#define LCD_UT_SPARE		LCD_UT_HEIGHT
+/* Number of lines of text printed */
+#define LCD_UT_LINES		400
+
+/* First frame buffer line shown, as set by the console */
+static int scroll_line;
+
+static void lcd_ut_set_offset(int line)
+{
+	scroll_line = line;
+}
+
+static void fill_bg(fbptr_t *buf, int lines)
+{
+	int bg_color = lcd_getbgcolor();
+	int i;
+
+	for (i = 0; i < lines * LCD_UT_WIDTH; i++)
+		buf[i] = bg_color;
+}
+
+/* Print lines of varying length and return the number of characters */
+static ulong print_lines(void)
+{
+	char line[120];
+	ulong chars = 0;
+	int i;
+
+	for (i = 0; i < LCD_UT_LINES; i++) {
+		sprintf(line, "%5d: loading block %08x\t%.*s\n", i, i * 0x1234,
+			i % 64, "abcdefghijklmnopqrstuvwxyz0123456789"
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+		lcd_puts(line);
+		chars += strlen(line);
+	}
+
+	return chars;
+}
+
+static void bench_print(const char *name, ulong chars, ulong us)
+{
+	printf("%-22s %8lu us %8lu chars/s\n", name, us,
+	       us ? chars * 1000 / us * 1000 : 0);
+}
+
+int do_ut_lcd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	const ulong line_size = LCD_UT_WIDTH * sizeof(fbptr_t);
+	char was_enabled = lcd_is_enabled;
+	void (*saved_set_offset)(int line);
+	struct console_t saved_cons;
+	fbptr_t *copy, *hw;
+	ulong start, chars, copy_us, hw_us;
+	int saved_spare, ret = -ENOMEM;
+
+	copy = malloc(LCD_UT_HEIGHT * line_size);
+	hw = malloc((LCD_UT_HEIGHT + LCD_UT_SPARE) * line_size);
+	if (!copy || !hw)
+		goto out;
+	fill_bg(copy, LCD_UT_HEIGHT);
+	fill_bg(hw, LCD_UT_HEIGHT + LCD_UT_SPARE);
+	/* Nothing may be printed while the test console is in use */
+	lcd_get_hw_scroll(&saved_spare, &saved_set_offset);
+	lcd_console_save(&saved_cons);
+	lcd_is_enabled = 1;
+
+	/* Scroll by copying the screen */
+	lcd_set_hw_scroll(0, NULL);
+	lcd_init_console(copy, LCD_UT_WIDTH, LCD_UT_HEIGHT, 0);
+	start = timer_get_us();
+	chars = print_lines();
+	copy_us = timer_get_us() - start;
+
+	/* Scroll by moving the displayed area */
+	scroll_line = -1;
+	lcd_set_hw_scroll(LCD_UT_SPARE, lcd_ut_set_offset);
+	lcd_init_console(hw, LCD_UT_WIDTH, LCD_UT_HEIGHT, 0);
+	start = timer_get_us();
+	chars = print_lines();
+	hw_us = timer_get_us() - start;
+
+	ret = 0;
+	if (scroll_line < 0 || scroll_line > LCD_UT_SPARE ||
+	    memcmp(copy, (void *)hw + scroll_line * line_size,
+		   LCD_UT_HEIGHT * line_size))
+		ret = -EINVAL;
+
+	/*
+	 * Put the real console back as it was, so that nothing refers to the
+	 * test buffers. The display was never touched.
+	 */
+	lcd_console_restore(&saved_cons);
+	lcd_set_hw_scroll(saved_spare, saved_set_offset);
+	lcd_is_enabled = was_enabled;
+
+	if (ret)
+		printf("%s: screens differ at scroll offset %d\n", __func__,
+		       scroll_line);
+	bench_print("copy scroll", chars, copy_us);
+	bench_print("hardware scroll", chars, hw_us);
+
+out:
+	free(hw);
+	free(copy);
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
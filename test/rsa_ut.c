@@ -0,0 +1,220 @@
+/*
+ * Unit test and benchmark for RSA modular exponentiation
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <asm/unaligned.h>
+#include <u-boot/rsa.h>
+#include <u-boot/rsa-mod-exp.h>
+
+#define RSA_UT_MAX_WORDS	(RSA_MAX_KEY_BITS / 32)
+#define RSA_UT_BENCH_LOOPS	20
+
+/*
+ * Reference arithmetic, on little endian arrays of @len 32-bit words. It
+ * only adds and doubles modulo n, so it does not share any of the
+ * Montgomery code under test.
+ */
+static int ref_ge(const u32 *a, const u32 *n, int len)
+{
+	int i;
+
+	for (i = len - 1; i >= 0; i--) {
+		if (a[i] != n[i])
+			return a[i] > n[i];
+	}
+
+	return 1;
+}
+
+/* a = a + b mod n, where a and b are both less than n */
+static void ref_add_mod(u32 *a, const u32 *b, const u32 *n, int len)
+{
+	u64 acc = 0;
+	s64 borrow = 0;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		acc += (u64)a[i] + b[i];
+		a[i] = (u32)acc;
+		acc >>= 32;
+	}
+	if (!acc && !ref_ge(a, n, len))
+		return;
+	for (i = 0; i < len; i++) {
+		borrow += (u64)a[i] - n[i];
+		a[i] = (u32)borrow;
+		borrow >>= 32;
+	}
+}
+
+static void ref_mul_mod(u32 *r, const u32 *a, const u32 *b, const u32 *n,
+			int len)
+{
+	int i;
+
+	memset(r, 0, len * sizeof(u32));
+	for (i = len * 32 - 1; i >= 0; i--) {
+		ref_add_mod(r, r, n, len);
+		if (b[i / 32] >> (i % 32) & 1)
+			ref_add_mod(r, a, n, len);
+	}
+}
+
+static void ref_pow_mod(u32 *r, const u32 *m, u64 e, const u32 *n, int len)
+{
+	u32 tmp[len];
+	int i;
+
+	memset(r, 0, len * sizeof(u32));
+	r[0] = 1;
+	for (i = 63; i >= 0; i--) {
+		ref_mul_mod(tmp, r, r, n, len);
+		if (e >> i & 1)
+			ref_mul_mod(r, tmp, m, n, len);
+		else
+			memcpy(r, tmp, len * sizeof(u32));
+	}
+}
+
+static void to_be(u8 *dst, const u32 *src, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		put_unaligned_be32(src[len - 1 - i], dst + i * 4);
+}
+
+/* Key material laid out as mkimage puts it in the device tree */
+struct rsa_ut_key {
+	u8 modulus[RSA_UT_MAX_WORDS * 4];
+	u8 rr[RSA_UT_MAX_WORDS * 4];
+	u64 exponent;
+	struct key_prop prop;
+};
+
+/*
+ * Make up a random odd modulus of @bits bits. It need not be a product of
+ * two primes, since verification only relies on the modulus being odd.
+ */
+static void make_key(struct rsa_ut_key *key, u32 *n, int bits, u64 e)
+{
+	int len = bits / 32;
+	u32 rr[len], inv;
+	int i;
+
+	for (i = 0; i < len; i++)
+		n[i] = rand();
+	n[0] |= 1;
+	n[len - 1] |= 0x80000000;
+
+	/* R^2 mod n, with R = 2^bits */
+	memset(rr, 0, sizeof(rr));
+	rr[0] = 1;
+	for (i = 0; i < 2 * bits; i++)
+		ref_add_mod(rr, rr, n, len);
+
+	to_be(key->modulus, n, len);
+	to_be(key->rr, rr, len);
+	key->exponent = cpu_to_be64(e);
+	key->prop.modulus = key->modulus;
+	key->prop.rr = key->rr;
+	key->prop.public_exponent = &key->exponent;
+	key->prop.exp_len = sizeof(u64);
+	key->prop.num_bits = bits;
+	/* -1 / n[0] mod 2^32, by Newton's method */
+	inv = n[0];
+	for (i = 0; i < 4; i++)
+		inv *= 2 - n[0] * inv;
+	key->prop.n0inv = -inv;
+}
+
+static int test_mod_exp(int bits, u64 e)
+{
+	int len = bits / 32;
+	u32 n[len], m[len], ref[len];
+	u8 sig[len * 4], expect[len * 4], out[len * 4];
+	struct rsa_ut_key key;
+	int i, ret;
+
+	make_key(&key, n, bits, e);
+	for (i = 0; i < len; i++)
+		m[i] = rand();
+	m[len - 1] &= 0x7fffffff;
+	to_be(sig, m, len);
+
+	ref_pow_mod(ref, m, e, n, len);
+	to_be(expect, ref, len);
+
+	/* The second run uses the key as cached by the first */
+	for (i = 0; i < 2; i++) {
+		memset(out, 0, sizeof(out));
+		ret = rsa_mod_exp_sw(sig, sizeof(sig), &key.prop, out);
+		if (ret || memcmp(out, expect, sizeof(out))) {
+			printf("%s: %d-bit key, exponent %llu, run %d failed: %d\n",
+			       __func__, bits, e, i, ret);
+			return ret ? ret : -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int bench_mod_exp(int bits)
+{
+	int len = bits / 32;
+	u32 n[len];
+	u8 sig[len * 4], out[len * 4];
+	struct rsa_ut_key key;
+	ulong start, first;
+	int i, ret;
+
+	make_key(&key, n, bits, 65537);
+	for (i = 0; i < len * 4; i++)
+		sig[i] = rand();
+	sig[0] &= 0x7f;
+
+	start = timer_get_us();
+	ret = rsa_mod_exp_sw(sig, sizeof(sig), &key.prop, out);
+	first = timer_get_us() - start;
+	if (ret)
+		return ret;
+
+	start = timer_get_us();
+	for (i = 0; i < RSA_UT_BENCH_LOOPS; i++) {
+		ret = rsa_mod_exp_sw(sig, sizeof(sig), &key.prop, out);
+		if (ret)
+			return ret;
+	}
+	printf("%d-bit verify: first %lu us, then %lu us each\n", bits,
+	       first, (timer_get_us() - start) / RSA_UT_BENCH_LOOPS);
+
+	return 0;
+}
+
+int do_ut_rsa(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	static const int sizes[] = { 2048, 2080, 3072, 4096 };
+	int ret = 0;
+	int i;
+
+	printf("Limb size %d bits\n", (int)sizeof(rsa_limb_t) * 8);
+	srand(1);
+	for (i = 0; i < ARRAY_SIZE(sizes) && !ret; i++) {
+		ret = test_mod_exp(sizes[i], 65537);
+		if (!ret)
+			ret = test_mod_exp(sizes[i], 3);
+	}
+	if (!ret)
+		ret = bench_mod_exp(2048);
+	if (!ret)
+		ret = bench_mod_exp(4096);
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
@@ -0,0 +1,252 @@
+/*
+ * Unit test and benchmark for the memory functions in lib/string.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+
+/* Largest length checked byte by byte, covering several words */
+#define STRING_UT_LEN		72
+/* Offsets tried for each pointer, covering all word alignments */
+#define STRING_UT_OFFSETS	(2 * sizeof(long))
+/* Area size and number of passes for the benchmark */
+#define STRING_UT_BENCH_SIZE	(1 << 20)
+#define STRING_UT_BENCH_LOOPS	64
+
+/*
+ * Fill @buf with a pattern which differs for each byte and each @seed.
+ * The values stay within 3..249, so that they never wrap when changed
+ * by 2 and are never 0.
+ */
+static void fill_pattern(u8 *buf, int len, int seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = ((i * 7 + seed) % 124) * 2 + 3;
+}
+
+static int test_memcpy_memmove(u8 *buf, u8 *ref)
+{
+	const int size = 2 * STRING_UT_LEN + 2 * STRING_UT_OFFSETS;
+	int doff, soff, len, i;
+
+	for (doff = 0; doff < STRING_UT_OFFSETS; doff++) {
+		for (soff = 0; soff < STRING_UT_OFFSETS; soff++) {
+			for (len = 0; len <= STRING_UT_LEN; len++) {
+				u8 *src = ref + soff;
+				u8 *dst = buf + doff;
+
+				/* memcpy() between separate areas */
+				fill_pattern(ref, size, len);
+				memset(buf, 0, size);
+				memcpy(dst, src, len);
+				for (i = 0; i < size; i++) {
+					u8 exp = i >= doff && i < doff + len ?
+						 src[i - doff] : 0;
+
+					if (buf[i] != exp)
+						goto fail_memcpy;
+				}
+
+				/* memmove() with dst above and below src */
+				fill_pattern(buf, size, len);
+				memcpy(ref, buf, size);
+				dst = buf + STRING_UT_OFFSETS + doff;
+				src = buf + soff;
+				memmove(dst, src, len);
+				for (i = 0; i < size; i++) {
+					int from = i - (dst - buf) + (src - buf);
+					u8 exp = i >= dst - buf &&
+						 i < dst - buf + len ?
+						 ref[from] : ref[i];
+
+					if (buf[i] != exp)
+						goto fail_memmove;
+				}
+
+				fill_pattern(buf, size, len);
+				memcpy(ref, buf, size);
+				memmove(src, dst, len);
+				for (i = 0; i < size; i++) {
+					int from = i - (src - buf) + (dst - buf);
+					u8 exp = i >= src - buf &&
+						 i < src - buf + len ?
+						 ref[from] : ref[i];
+
+					if (buf[i] != exp)
+						goto fail_memmove;
+				}
+			}
+		}
+	}
+
+	return 0;
+
+fail_memcpy:
+	printf("%s: memcpy() failed: dst offset %d, src offset %d, len %d\n",
+	       __func__, doff, soff, len);
+	return -EINVAL;
+fail_memmove:
+	printf("%s: memmove() failed: dst offset %d, src offset %d, len %d\n",
+	       __func__, doff, soff, len);
+	return -EINVAL;
+}
+
+static int test_memset(u8 *buf)
+{
+	const int size = STRING_UT_LEN + 2 * STRING_UT_OFFSETS;
+	int off, len, i;
+
+	for (off = 0; off < STRING_UT_OFFSETS; off++) {
+		for (len = 0; len <= STRING_UT_LEN; len++) {
+			memset(buf, 0, size);
+			memset(buf + off, 0x1a5, len);
+			for (i = 0; i < size; i++) {
+				u8 exp = i >= off && i < off + len ? 0xa5 : 0;
+
+				if (buf[i] != exp) {
+					printf("%s: offset %d, len %d failed\n",
+					       __func__, off, len);
+					return -EINVAL;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int sign(int x)
+{
+	return x < 0 ? -1 : x > 0;
+}
+
+static int test_memcmp_memchr(u8 *buf, u8 *ref)
+{
+	int aoff, boff, len, diff, ret;
+	u8 *a, *b, *p;
+
+	for (aoff = 0; aoff < STRING_UT_OFFSETS; aoff++) {
+		for (boff = 0; boff < STRING_UT_OFFSETS; boff++) {
+			a = buf + aoff;
+			b = ref + boff;
+			for (len = 0; len <= STRING_UT_LEN; len++) {
+				fill_pattern(a, len, 3);
+				fill_pattern(b, len, 3);
+				if (memcmp(a, b, len))
+					goto fail_memcmp;
+
+				/* Change one byte, either way, at each place */
+				for (diff = 0; diff < len; diff++) {
+					b[diff] += 2;
+					ret = memcmp(a, b, len);
+					b[diff] -= 4;
+					ret = sign(ret) * 2 +
+					      sign(memcmp(a, b, len));
+					b[diff] += 2;
+					if (ret != -1)
+						goto fail_memcmp;
+
+					/* fill_pattern() never writes 0 */
+					a[diff] = 0;
+					p = memchr(a, 0, len);
+					a[diff] = b[diff];
+					if (p != a + diff)
+						goto fail_memchr;
+				}
+				if (memchr(a, 0, len))
+					goto fail_memchr;
+			}
+		}
+	}
+
+	return 0;
+
+fail_memcmp:
+	printf("%s: memcmp() failed: offsets %d and %d, len %d\n",
+	       __func__, aoff, boff, len);
+	return -EINVAL;
+fail_memchr:
+	printf("%s: memchr() failed: offset %d, len %d\n",
+	       __func__, aoff, len);
+	return -EINVAL;
+}
+
+static void bench_print(const char *name, ulong us)
+{
+	ulong kib = STRING_UT_BENCH_SIZE / 1024 * STRING_UT_BENCH_LOOPS;
+
+	printf("%-22s %8lu us %8lu MiB/s\n", name, us,
+	       us ? kib * 1000 / 1024 * 1000 / us : 0);
+}
+
+static void bench_string(u8 *dst, u8 *src)
+{
+	const int size = STRING_UT_BENCH_SIZE;
+	ulong start;
+	int i;
+
+	memset(src, 0x5a, size + 8);
+	memset(dst, 0x5a, size + 8);
+
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memcpy(dst, src, size);
+	bench_print("memcpy aligned", timer_get_us() - start);
+
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memcpy(dst, src + 1, size);
+	bench_print("memcpy unaligned", timer_get_us() - start);
+
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memmove(dst + 8, dst, size);
+	bench_print("memmove backwards", timer_get_us() - start);
+
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memset(dst, i, size);
+	bench_print("memset", timer_get_us() - start);
+
+	memset(dst, 0x5a, size);
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memcmp(dst, src, size);
+	bench_print("memcmp", timer_get_us() - start);
+
+	start = timer_get_us();
+	for (i = 0; i < STRING_UT_BENCH_LOOPS; i++)
+		memchr(src, 0, size);
+	bench_print("memchr", timer_get_us() - start);
+}
+
+int do_ut_string(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	const int size = STRING_UT_BENCH_SIZE + 16;
+	u8 *buf, *ref;
+	int ret = -ENOMEM;
+
+	buf = memalign(sizeof(long), size);
+	ref = memalign(sizeof(long), size);
+	if (!buf || !ref)
+		goto out;
+
+	ret = test_memcpy_memmove(buf, ref);
+	ret |= test_memset(buf);
+	ret |= test_memcmp_memchr(buf, ref);
+	if (!ret)
+		bench_string(buf, ref);
+
+out:
+	free(ref);
+	free(buf);
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}